@@ -51,6 +51,7 @@ enum XDMA_IOC_TYPES {
 	XDMA_IOC_INFO,
 	XDMA_IOC_OFFLINE,
 	XDMA_IOC_ONLINE,
+	XDMA_IOC_REG_BATCH,
 	XDMA_IOC_MAX
 };
 
@@ -74,11 +75,33 @@ struct xdma_ioc_info {
 	unsigned char		func;
 };
 
+/*
+ * vectored register access: a list of 32 bit register reads and writes on the
+ * BAR, performed in order in one call. Read values are returned in the list.
+ * user space keeps its own copy of these (sw_projects/common/hwaccess.c):
+ * the sizes are checked at build time on both sides.
+ */
+#define XDMA_REG_BATCH_MAX	32
+
+struct xdma_reg_op {
+	unsigned int addr;		/* byte offset in the BAR, 32 bit aligned */
+	unsigned int value;		/* value to write, or value read */
+	unsigned int write;		/* non zero for a write */
+};
+
+struct xdma_reg_batch {
+	unsigned int count;		/* number of operations */
+	unsigned int pad;
+	unsigned long long ops;		/* user pointer to struct xdma_reg_op[count] */
+};
+
 /* IOCTL codes */
 #define XDMA_IOCINFO		_IOWR(XDMA_IOC_MAGIC, XDMA_IOC_INFO, \
 					struct xdma_ioc_info)
 #define XDMA_IOCOFFLINE		_IO(XDMA_IOC_MAGIC, XDMA_IOC_OFFLINE)
 #define XDMA_IOCONLINE		_IO(XDMA_IOC_MAGIC, XDMA_IOC_ONLINE)
+#define XDMA_IOCREGBATCH	_IOWR(XDMA_IOC_MAGIC, XDMA_IOC_REG_BATCH, \
+					struct xdma_reg_batch)
 
 #define IOCTL_XDMA_ADDRMODE_SET	_IOW('q', 4, int)
 #define IOCTL_XDMA_ADDRMODE_GET	_IOR('q', 5, int)
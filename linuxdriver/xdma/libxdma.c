@@ -567,6 +567,18 @@ static int xdma_engine_stop(struct xdma_engine *engine)
 	return 0;
 }
 
+/*
+ * true while an engine whose streaming ring could not be stopped is still
+ * busy: it may be writing to the leaked ring, so it can't be restarted
+ */
+static bool xdma_engine_stream_stalled(struct xdma_engine *engine)
+{
+	if (engine->stream_stalled &&
+	    !(read_register(&engine->regs->status) & XDMA_STAT_BUSY))
+		engine->stream_stalled = 0;
+	return engine->stream_stalled;
+}
+
 static int engine_start_mode_config(struct xdma_engine *engine)
 {
 	u32 w;
@@ -791,6 +803,48 @@ static int engine_service_shutdown(struct xdma_engine *engine)
 	return 0;
 }
 
+/*
+ * engine_stats_record() - count a finished transfer in the engine statistics
+ */
+static void engine_stats_record(struct xdma_engine *engine,
+				struct xdma_transfer *transfer)
+{
+	struct xdma_engine_stats *stats = &engine->stats;
+	s64 us;
+	int bucket;
+
+	if (transfer->state != TRANSFER_STATE_COMPLETED) {
+		atomic64_inc(&stats->errors);
+		return;
+	}
+
+	us = ktime_us_delta(ktime_get(), transfer->submit_time);
+	bucket = (us > 0) ? fls64(us) : 0;
+	if (bucket >= XDMA_STATS_LAT_BUCKETS)
+		bucket = XDMA_STATS_LAT_BUCKETS - 1;
+
+	atomic64_inc(&stats->transfers);
+	atomic64_add(transfer->len, &stats->bytes);
+	atomic64_add(transfer->desc_num, &stats->descriptors);
+	atomic64_inc(&stats->latency[bucket]);
+}
+
+void xdma_engine_stats_reset(struct xdma_engine *engine)
+{
+	struct xdma_engine_stats *stats = &engine->stats;
+	int i;
+
+	atomic64_set(&stats->transfers, 0);
+	atomic64_set(&stats->bytes, 0);
+	atomic64_set(&stats->descriptors, 0);
+	atomic64_set(&stats->errors, 0);
+	atomic64_set(&stats->timeouts, 0);
+	atomic64_set(&stats->pages_pinned, 0);
+	atomic64_set(&stats->polled, 0);
+	for (i = 0; i < XDMA_STATS_LAT_BUCKETS; i++)
+		atomic64_set(&stats->latency[i], 0);
+}
+
 static struct xdma_transfer *engine_transfer_completion(
 		struct xdma_engine *engine,
 		struct xdma_transfer *transfer)
@@ -805,6 +859,8 @@ static struct xdma_transfer *engine_transfer_completion(
 		return NULL;
 	}
 
+	engine_stats_record(engine, transfer);
+
 	/* synchronous I/O? */
 	/* awake task on transfer's wait queue */
 	xlx_wake_up(&transfer->wq);
@@ -1195,6 +1251,45 @@ done:
 	return err_flag ? -1 : 0;
 }
 
+/*
+ * engine_service_stream_ring() - service a C2H streaming ring interrupt
+ *
+ * the descriptor chain is cyclic, so the completed descriptor count is the
+ * number of blocks filled since the ring started. Publish it as the head and
+ * wake poll() waiters. An overrun is counted when the head laps the tail.
+ * engine->lock must be taken
+ */
+static int engine_service_stream_ring(struct xdma_engine *engine)
+{
+	struct xdma_stream_ring *ring = engine->stream_ring;
+	struct xdma_stream_ctrl *ctrl = ring->ctrl;
+	u32 head, tail;
+	int rv;
+
+	rv = engine_status_read(engine, 1, 0);
+	if (rv < 0)
+		return rv;
+	if (!(engine->status & XDMA_STAT_BUSY)) {
+		pr_err("%s streaming ring stopped, status 0x%x.\n",
+		       engine->name, engine->status);
+		WRITE_ONCE(ctrl->error, engine->status);
+		engine->running = 0;
+	}
+
+	head = read_register(&engine->regs->completed_desc_count);
+	tail = READ_ONCE(ctrl->tail);
+	atomic64_add(head - ctrl->head, &engine->stats.descriptors);
+	atomic64_add((u64)(head - ctrl->head) * ring->block_size,
+		     &engine->stats.bytes);
+	if ((head - tail > ring->block_count) &&
+	    (READ_ONCE(ctrl->head) - tail <= ring->block_count))
+		WRITE_ONCE(ctrl->overruns, ctrl->overruns + 1);
+	WRITE_ONCE(ctrl->head, head);
+
+	wake_up_interruptible(&engine->stream_wq);
+	return 0;
+}
+
 /* engine_service_work */
 static void engine_service_work(struct work_struct *work)
 {
@@ -1213,7 +1308,10 @@ static void engine_service_work(struct work_struct *work)
 	spin_lock_irqsave(&engine->lock, flags);
 
 	dbg_tfr("engine_service() for %s engine %p\n", engine->name, engine);
-	rv = engine_service(engine, 0);
+	if (engine->stream_ring)
+		rv = engine_service_stream_ring(engine);
+	else
+		rv = engine_service(engine, 0);
 	if (rv < 0) {
 		pr_err("Failed to service engine\n");
 		goto unlock;
@@ -2494,6 +2592,7 @@ static int transfer_queue(struct xdma_engine *engine,
 	}
 
 	/* mark the transfer as submitted */
+	transfer->submit_time = ktime_get();
 	transfer->state = TRANSFER_STATE_SUBMITTED;
 	/* add transfer to the tail of the engine transfer queue */
 	list_add_tail(&transfer->entry, &engine->transfer_list);
@@ -3054,9 +3153,65 @@ static void xdma_request_cb_dump(struct xdma_request_cb *req)
 }
 #endif
 
+/*
+ * engine_hybrid_poll() - busy-poll a short transfer before sleeping
+ *
+ * spins on the engine status for up to hybrid_poll_us. If the engine goes
+ * idle, the transfer is serviced here, saving the interrupt and work queue
+ * latency; the interrupt that follows finds the engine already serviced.
+ * Otherwise the caller sleeps and the interrupt completes the transfer.
+ */
+static void engine_hybrid_poll(struct xdma_engine *engine,
+			       struct xdma_transfer *xfer)
+{
+	ktime_t end = ktime_add_us(ktime_get(), engine->hybrid_poll_us);
+	unsigned long flags;
+
+	while (READ_ONCE(xfer->state) == TRANSFER_STATE_SUBMITTED) {
+		if (!(read_register(&engine->regs->status) & XDMA_STAT_BUSY)) {
+			spin_lock_irqsave(&engine->lock, flags);
+			if (xfer->state == TRANSFER_STATE_SUBMITTED) {
+				engine_service(engine, 0);
+				if (xfer->state != TRANSFER_STATE_SUBMITTED)
+					atomic64_inc(&engine->stats.polled);
+			}
+			spin_unlock_irqrestore(&engine->lock, flags);
+			return;
+		}
+		if (ktime_after(ktime_get(), end))
+			return;
+		cpu_relax();
+	}
+}
+
+static struct kmem_cache *req_cache;
+
+int xdma_request_cache_init(void)
+{
+	req_cache = kmem_cache_create("xdma_req_cache",
+				      sizeof(struct xdma_request_cb) +
+				      XDMA_REQ_CACHED_DESC *
+				      sizeof(struct sw_desc),
+				      0, SLAB_HWCACHE_ALIGN, NULL);
+	if (!req_cache) {
+		pr_info("memory allocation for req_cache failed. OOM\n");
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+void xdma_request_cache_cleanup(void)
+{
+	if (req_cache)
+		kmem_cache_destroy(req_cache);
+	req_cache = NULL;
+}
+
 static void xdma_request_free(struct xdma_request_cb *req)
 {
-	if (((unsigned long)req) >= VMALLOC_START &&
+	if (req->cached)
+		kmem_cache_free(req_cache, req);
+	else if (((unsigned long)req) >= VMALLOC_START &&
 	    ((unsigned long)req) < VMALLOC_END)
 		vfree(req);
 	else
@@ -3069,6 +3224,14 @@ static struct xdma_request_cb *xdma_request_alloc(unsigned int sdesc_nr)
 	unsigned int size = sizeof(struct xdma_request_cb) +
 			    sdesc_nr * sizeof(struct sw_desc);
 
+	if (sdesc_nr <= XDMA_REQ_CACHED_DESC && req_cache) {
+		req = kmem_cache_zalloc(req_cache, GFP_KERNEL);
+		if (req) {
+			req->cached = 1;
+			return req;
+		}
+	}
+
 	req = kzalloc(size, GFP_KERNEL);
 	if (!req) {
 		req = vmalloc(size);
@@ -3199,6 +3362,11 @@ ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
 		return -EINVAL;
 	}
 
+	if (engine->stream_ring || xdma_engine_stream_stalled(engine)) {
+		dbg_tfr("%s streaming ring running.\n", engine->name);
+		return -EBUSY;
+	}
+
 	if (!dma_mapped) {
 		nents = dma_map_sg(&xdev->pdev->dev, sg, sgt->orig_nents, dir);
 		if (!nents) {
@@ -3266,6 +3434,10 @@ ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
 		if (engine->cmplthp)
 			xdma_kthread_wakeup(engine->cmplthp);
 
+		if (!poll_mode && engine->hybrid_poll_us &&
+		    xfer->len <= engine->hybrid_poll_bytes)
+			engine_hybrid_poll(engine, xfer);
+
 		if (timeout_ms > 0)
 			xlx_wait_event_interruptible_timeout(xfer->wq,
 				(xfer->state != TRANSFER_STATE_SUBMITTED),
@@ -3315,6 +3487,7 @@ ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
 			/* transfer can still be in-flight */
 			pr_info("xfer 0x%p,%u, s 0x%x timed out, ep 0x%llx.\n",
 				xfer, xfer->len, xfer->state, req->ep_addr);
+			atomic64_inc(&engine->stats.timeouts);
 			rv = engine_status_read(engine, 0, 1);
 			if (rv < 0) {
 				pr_err("Failed to read engine status\n");
@@ -3452,6 +3625,7 @@ ssize_t xdma_xfer_completion(void *cb_hndl, void *dev_hndl, int channel,
 			/* transfer can still be in-flight */
 			pr_info("xfer 0x%p,%u, s 0x%x timed out, ep 0x%llx.\n",
 				xfer, xfer->len, xfer->state, req->ep_addr);
+			atomic64_inc(&engine->stats.timeouts);
 			engine_status_read(engine, 0, 1);
 			engine_status_dump(engine);
 			transfer_abort(engine, xfer);
@@ -3550,6 +3724,11 @@ ssize_t xdma_xfer_submit_nowait(void *cb_hndl, void *dev_hndl, int channel,
 		return -EINVAL;
 	}
 
+	if (engine->stream_ring || xdma_engine_stream_stalled(engine)) {
+		dbg_tfr("%s streaming ring running.\n", engine->name);
+		return -EBUSY;
+	}
+
 	if (!dma_mapped) {
 		nents = dma_map_sg(&xdev->pdev->dev, sg, sgt->orig_nents, dir);
 		if (!nents) {
@@ -3781,6 +3960,226 @@ err_engine_transfer:
 	return rv;
 }
 
+static void xdma_stream_ring_release(struct kref *ref)
+{
+	struct xdma_stream_ring *ring =
+		container_of(ref, struct xdma_stream_ring, ref);
+
+	dma_free_coherent(ring->dev,
+			  ring->block_count * sizeof(struct xdma_desc),
+			  ring->desc_virt, ring->desc_bus);
+	dma_free_coherent(ring->dev, ring->size, ring->virt, ring->bus);
+	kfree(ring);
+}
+
+/**
+ * xdma_stream_ring_start() - start a C2H streaming ring on an idle engine
+ *
+ * every block is read from ep_addr by its own descriptor, and every
+ * descriptor raises a completion interrupt. The last descriptor links back
+ * to the first, so the engine keeps filling the ring until stopped; it is
+ * up to user space to keep up (overruns are counted, not prevented).
+ */
+int xdma_stream_ring_start(struct xdma_engine *engine, void *owner,
+			   u64 ep_addr, unsigned int block_size,
+			   unsigned int block_count)
+{
+	struct xdma_dev *xdev = engine->xdev;
+	struct xdma_stream_ring *ring;
+	struct xdma_desc *desc;
+	dma_addr_t next_bus;
+	unsigned long flags;
+	unsigned int i;
+	u32 w;
+	int rv;
+
+	if (engine->dir != DMA_FROM_DEVICE || engine->streaming || poll_mode)
+		return -EOPNOTSUPP;
+	if (!block_size || (block_size & 3) || block_size > desc_blen_max ||
+	    block_count < 2 || block_count > XDMA_STREAM_BLOCKS_MAX ||
+	    (u64)block_size * block_count > XDMA_STREAM_RING_LEN_MAX)
+		return -EINVAL;
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+	kref_init(&ring->ref);
+	ring->dev = &xdev->pdev->dev;
+	ring->owner = owner;
+	ring->block_size = block_size;
+	ring->block_count = block_count;
+	ring->size = PAGE_SIZE + PAGE_ALIGN(block_size * block_count);
+	ring->virt = dma_alloc_coherent(ring->dev, ring->size, &ring->bus,
+					GFP_KERNEL);
+	if (!ring->virt) {
+		rv = -ENOMEM;
+		goto err_free;
+	}
+	ring->desc_virt = dma_alloc_coherent(ring->dev,
+				block_count * sizeof(struct xdma_desc),
+				&ring->desc_bus, GFP_KERNEL);
+	if (!ring->desc_virt) {
+		rv = -ENOMEM;
+		goto err_free_buf;
+	}
+	memset(ring->virt, 0, ring->size);
+	memset(ring->desc_virt, 0, block_count * sizeof(struct xdma_desc));
+
+	ring->ctrl = ring->virt;
+	ring->ctrl->block_size = block_size;
+	ring->ctrl->block_count = block_count;
+	ring->ctrl->data_offset = PAGE_SIZE;
+
+	for (i = 0; i < block_count; i++) {
+		desc = ring->desc_virt + i;
+		next_bus = ring->desc_bus + ((i + 1) % block_count) *
+					    sizeof(struct xdma_desc);
+		xdma_desc_set(desc, ring->bus + PAGE_SIZE + i * block_size,
+			      ep_addr, block_size, DMA_FROM_DEVICE);
+		xdma_desc_link(desc,
+			       ring->desc_virt + (i + 1) % block_count,
+			       next_bus);
+		xdma_desc_control_set(desc, XDMA_DESC_COMPLETED);
+	}
+
+	spin_lock_irqsave(&engine->lock, flags);
+	if (engine->running || engine->stream_ring || engine->xdma_perf ||
+	    xdma_engine_stream_stalled(engine) ||
+	    !list_empty(&engine->transfer_list)) {
+		spin_unlock_irqrestore(&engine->lock, flags);
+		rv = -EBUSY;
+		goto err_free_desc;
+	}
+	engine->stream_ring = ring;
+	engine->shutdown = ENGINE_SHUTDOWN_NONE;
+	engine->desc_dequeued = 0;
+
+	w = cpu_to_le32(PCI_DMA_L(ring->desc_bus));
+	write_register(w, &engine->sgdma_regs->first_desc_lo,
+		       (unsigned long)(&engine->sgdma_regs->first_desc_lo) -
+			       (unsigned long)(&engine->sgdma_regs));
+	w = cpu_to_le32(PCI_DMA_H(ring->desc_bus));
+	write_register(w, &engine->sgdma_regs->first_desc_hi,
+		       (unsigned long)(&engine->sgdma_regs->first_desc_hi) -
+			       (unsigned long)(&engine->sgdma_regs));
+	write_register(0, &engine->sgdma_regs->first_desc_adjacent,
+		       (unsigned long)(&engine->sgdma_regs->first_desc_adjacent) -
+			       (unsigned long)(&engine->sgdma_regs));
+#if HAS_MMIOWB
+	mmiowb();
+#endif
+	rv = engine_start_mode_config(engine);
+	if (rv < 0) {
+		engine->stream_ring = NULL;
+		spin_unlock_irqrestore(&engine->lock, flags);
+		goto err_free_desc;
+	}
+	engine->running = 1;
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	dbg_tfr("%s streaming ring: %u blocks of %u bytes from 0x%llx.\n",
+		engine->name, block_count, block_size, ep_addr);
+	return 0;
+
+err_free_desc:
+	dma_free_coherent(ring->dev, block_count * sizeof(struct xdma_desc),
+			  ring->desc_virt, ring->desc_bus);
+err_free_buf:
+	dma_free_coherent(ring->dev, ring->size, ring->virt, ring->bus);
+err_free:
+	kfree(ring);
+	return rv;
+}
+
+/* wait up to ~100ms for an engine to go idle; returns true if it did */
+static bool xdma_engine_wait_idle(struct xdma_engine *engine)
+{
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		if (!(read_register(&engine->regs->status) & XDMA_STAT_BUSY))
+			return true;
+		usleep_range(1000, 2000);
+	}
+	return false;
+}
+
+/**
+ * xdma_stream_ring_stop() - stop the streaming ring started by owner
+ *
+ * the engine is stopped and given time to go idle before the engine's
+ * reference is dropped; the memory is freed once user space unmaps it.
+ * a C2H stream engine only stops at the end of a block, so with no data
+ * flowing it stays busy with a descriptor pointing into the ring. If it
+ * can't be seen to go idle the ring is deliberately leaked, never freed
+ * while the engine may still write to it.
+ */
+int xdma_stream_ring_stop(struct xdma_engine *engine, void *owner)
+{
+	struct xdma_stream_ring *ring;
+	unsigned long flags;
+	unsigned int i;
+	bool idle;
+
+	spin_lock_irqsave(&engine->lock, flags);
+	ring = engine->stream_ring;
+	if (!ring || ring->owner != owner) {
+		spin_unlock_irqrestore(&engine->lock, flags);
+		return -EINVAL;
+	}
+	xdma_engine_stop(engine);
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	idle = xdma_engine_wait_idle(engine);
+	if (!idle) {
+		/*
+		 * abort: make every descriptor the last one, so the engine
+		 * halts at the end of the block it is on instead of going on
+		 * round the ring, then give it one more chance.
+		 */
+		for (i = 0; i < ring->block_count; i++)
+			xdma_desc_control_set(ring->desc_virt + i,
+				XDMA_DESC_STOPPED | XDMA_DESC_COMPLETED);
+		wmb();
+		idle = xdma_engine_wait_idle(engine);
+	}
+
+	spin_lock_irqsave(&engine->lock, flags);
+	engine_status_read(engine, 1, 0);
+	engine->stream_ring = NULL;
+	if (!idle)
+		engine->stream_stalled = 1;
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	wake_up_interruptible(&engine->stream_wq);
+	if (!idle) {
+		pr_err("%s streaming ring did not stop: ring memory leaked.\n",
+		       engine->name);
+		return -EBUSY;		/* the engine's reference is kept */
+	}
+	xdma_stream_ring_put(ring);
+	return 0;
+}
+
+/* take a reference to the running ring, or NULL if none */
+struct xdma_stream_ring *xdma_stream_ring_get(struct xdma_engine *engine)
+{
+	struct xdma_stream_ring *ring;
+	unsigned long flags;
+
+	spin_lock_irqsave(&engine->lock, flags);
+	ring = engine->stream_ring;
+	if (ring)
+		kref_get(&ring->ref);
+	spin_unlock_irqrestore(&engine->lock, flags);
+	return ring;
+}
+
+void xdma_stream_ring_put(struct xdma_stream_ring *ring)
+{
+	kref_put(&ring->ref, xdma_stream_ring_release);
+}
+
 static struct xdma_dev *alloc_dev_instance(struct pci_dev *pdev)
 {
 	int i;
@@ -3838,6 +4237,7 @@ static struct xdma_dev *alloc_dev_instance(struct pci_dev *pdev)
 		spin_lock_init(&engine->lock);
 		mutex_init(&engine->desc_lock);
 		INIT_LIST_HEAD(&engine->transfer_list);
+		init_waitqueue_head(&engine->stream_wq);
 #if HAS_SWAKE_UP
 		init_swait_queue_head(&engine->shutdown_wq);
 		init_swait_queue_head(&engine->xdma_perf_wq);
@@ -48,6 +48,7 @@
 
 #include "libxdma.h"
 #include "xdma_thread.h"
+#include "cdev_sgdma.h"
 
 #define MAGIC_ENGINE	0xEEEEEEEEUL
 #define MAGIC_DEVICE	0xDDDDDDDDUL
@@ -58,6 +59,9 @@ extern unsigned int desc_blen_max;
 extern unsigned int h2c_timeout;
 extern unsigned int c2h_timeout;
 
+struct xdma_pinned_buf;		/* pinned user buffer, see cdev_sgdma.c */
+struct xdma_wb_ring;		/* write-behind ring, see cdev_sgdma.c */
+
 struct xdma_cdev {
 	unsigned long magic;		/* structure ID for sanity checks */
 	struct xdma_pci_dev *xpdev;
@@ -70,6 +74,11 @@ struct xdma_cdev {
 	struct xdma_user_irq *user_irq;	/* IRQ value, if needed */
 	struct device *sys_device;	/* sysfs device */
 	spinlock_t lock;
+	struct mutex pinned_lock;	/* protects pinned[] (sgdma cdev only) */
+	struct xdma_pinned_buf *pinned[XDMA_PINNED_BUF_MAX];
+	struct mutex wb_lock;		/* protects wb; held by write(); poll() uses RCU */
+	struct xdma_wb_ring *wb;	/* write-behind ring (sgdma h2c only) */
+	wait_queue_head_t wb_wq;	/* woken as the write-behind ring drains */
 };
 
 /* XDMA PCIe device specific book-keeping */
@@ -100,6 +109,17 @@ struct xdma_pci_dev {
 	void *data;
 };
 
+/*
+ * page array and scatterlist for a read/write of up to XDMA_IO_CB_CACHED_PAGES
+ * pages (32KB, not page aligned), allocated together from io_cb_cache
+ */
+#define XDMA_IO_CB_CACHED_PAGES	9
+
+struct xdma_io_cb_mem {
+	struct page *pages[XDMA_IO_CB_CACHED_PAGES];
+	struct scatterlist sgl[XDMA_IO_CB_CACHED_PAGES];
+};
+
 struct cdev_async_io {
 	struct kiocb *iocb;
 	struct xdma_io_cb *cb;
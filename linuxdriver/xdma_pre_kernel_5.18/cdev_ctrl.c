@@ -124,6 +124,48 @@ static long version_ioctl(struct xdma_cdev *xcdev, void __user *arg)
 	return 0;
 }
 
+/*
+ * run a list of register reads and writes in one call, in list order
+ */
+static long reg_batch_ioctl(struct xdma_cdev *xcdev, void __user *arg)
+{
+	struct xdma_dev *xdev = xcdev->xdev;
+	struct xdma_reg_batch batch;
+	struct xdma_reg_op ops[XDMA_REG_BATCH_MAX];
+	struct xdma_reg_op __user *uops;
+	resource_size_t bar_len;
+	void __iomem *reg;
+	unsigned int i;
+
+	BUILD_BUG_ON(sizeof(struct xdma_reg_op) != 12);
+	BUILD_BUG_ON(sizeof(struct xdma_reg_batch) != 16);
+	if (copy_from_user(&batch, arg, sizeof(struct xdma_reg_batch)))
+		return -EFAULT;
+	if (batch.count > XDMA_REG_BATCH_MAX)
+		return -EINVAL;
+	uops = (struct xdma_reg_op __user *)(uintptr_t)batch.ops;
+	if (copy_from_user(ops, uops, batch.count * sizeof(struct xdma_reg_op)))
+		return -EFAULT;
+
+	bar_len = pci_resource_len(xdev->pdev, xcdev->bar);
+	for (i = 0; i < batch.count; i++) {
+		if ((ops[i].addr & 3) || (ops[i].addr > bar_len - 4))
+			return -EINVAL;
+	}
+
+	for (i = 0; i < batch.count; i++) {
+		reg = xdev->bar[xcdev->bar] + ops[i].addr;
+		if (ops[i].write)
+			iowrite32(ops[i].value, reg);
+		else
+			ops[i].value = ioread32(reg);
+	}
+
+	if (copy_to_user(uops, ops, batch.count * sizeof(struct xdma_reg_op)))
+		return -EFAULT;
+	return 0;
+}
+
 long char_ctrl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	struct xdma_cdev *xcdev = (struct xdma_cdev *)filp->private_data;
@@ -141,7 +183,7 @@ long char_ctrl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		pr_info("cmd %u, xdev NULL.\n", cmd);
 		return -EINVAL;
 	}
-	pr_info("cmd 0x%x, xdev 0x%p, pdev 0x%p.\n", cmd, xdev, xdev->pdev);
+	dbg_sg("cmd 0x%x, xdev 0x%p, pdev 0x%p.\n", cmd, xdev, xdev->pdev);
 
 	if (_IOC_TYPE(cmd) != XDMA_IOC_MAGIC) {
 		pr_err("cmd %u, bad magic 0x%x/0x%x.\n",
@@ -181,6 +223,8 @@ long char_ctrl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case XDMA_IOCONLINE:
 		xdma_device_online(xdev->pdev, xdev);
 		break;
+	case XDMA_IOCREGBATCH:
+		return reg_batch_ioctl(xcdev, (void __user *)arg);
 	default:
 		pr_err("UNKNOWN ioctl cmd 0x%x.\n", cmd);
 		return -ENOTTY;
@@ -20,6 +20,7 @@
 #define pr_fmt(fmt)     KBUILD_MODNAME ":%s: " fmt, __func__
 
 #include "xdma_cdev.h"
+#include "libxdma_api.h"
 
 /*
  * character device file operations for events
@@ -102,13 +103,74 @@ static unsigned int char_events_poll(struct file *file, poll_table *wait)
 	return mask;
 }
 
+/*
+ * the user interrupt is only enabled while its events node is open, so
+ * an application can block in read() or poll() instead of polling
+ * registers; it is disabled again when the last user closes the node
+ */
+static int char_events_open(struct inode *inode, struct file *file)
+{
+	struct xdma_cdev *xcdev;
+	struct xdma_user_irq *user_irq;
+	unsigned long flags;
+	bool first;
+	int rv;
+
+	rv = char_open(inode, file);
+	if (rv < 0)
+		return rv;
+
+	xcdev = (struct xdma_cdev *)file->private_data;
+	user_irq = xcdev->user_irq;
+	if (!user_irq)
+		return 0;
+
+	spin_lock_irqsave(&user_irq->events_lock, flags);
+	first = (user_irq->events_users++ == 0);
+	if (first)
+		user_irq->events_irq = 0;
+	spin_unlock_irqrestore(&user_irq->events_lock, flags);
+
+	if (first)
+		xdma_user_isr_enable(xcdev->xdev, 1 << user_irq->user_idx);
+
+	return 0;
+}
+
+static int char_events_close(struct inode *inode, struct file *file)
+{
+	struct xdma_cdev *xcdev = (struct xdma_cdev *)file->private_data;
+	struct xdma_user_irq *user_irq;
+	unsigned long flags;
+	bool last = false;
+	int rv;
+
+	rv = xcdev_check(__func__, xcdev, 0);
+	if (rv < 0)
+		return rv;
+
+	user_irq = xcdev->user_irq;
+	if (user_irq) {
+		spin_lock_irqsave(&user_irq->events_lock, flags);
+		if (user_irq->events_users > 0)
+			last = (--user_irq->events_users == 0);
+		spin_unlock_irqrestore(&user_irq->events_lock, flags);
+
+		if (last)
+			xdma_user_isr_disable(xcdev->xdev,
+					      1 << user_irq->user_idx);
+	}
+
+	return char_close(inode, file);
+}
+
 /*
  * character device file operations for the irq events
  */
 static const struct file_operations events_fops = {
 	.owner = THIS_MODULE,
-	.open = char_open,
-	.release = char_close,
+	.open = char_events_open,
+	.release = char_events_close,
 	.read = char_events_read,
 	.poll = char_events_poll,
 };
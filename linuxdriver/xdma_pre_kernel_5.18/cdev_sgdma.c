@@ -29,6 +29,9 @@
 #include <linux/version.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 16, 0)
 #include <linux/uio.h>
+#include <linux/log2.h>
+#include <linux/rcupdate.h>
+#include <linux/workqueue.h>
 #endif
 #include "libxdma_api.h"
 #include "xdma_cdev.h"
@@ -45,6 +48,7 @@ module_param(c2h_timeout, uint, 0644);
 MODULE_PARM_DESC(c2h_timeout, "C2H sgdma timeout in seconds, default is 10 sec.");
 
 extern struct kmem_cache *cdev_cache;
+extern struct kmem_cache *io_cb_cache;
 static void char_sgdma_unmap_user_buf(struct xdma_io_cb *cb, bool write);
 
 
@@ -231,6 +235,23 @@ static int check_transfer_align(struct xdma_engine *engine,
  * inspired by vhost_scsi_map_to_sgl()
  * Returns the number of scatterlist entries used or -errno on error.
  */
+/*
+ * free the page array and scatterlist: from io_cb_cache for transfers of
+ * up to XDMA_IO_CB_CACHED_PAGES pages, so the common case stays off kmalloc
+ */
+static void xdma_io_cb_free_mem(struct xdma_io_cb *cb)
+{
+	if (cb->mem) {
+		kmem_cache_free(io_cb_cache, cb->mem);
+		cb->mem = NULL;
+		cb->sgt.sgl = NULL;
+	} else {
+		sg_free_table(&cb->sgt);
+		kfree(cb->pages);
+	}
+	cb->pages = NULL;
+}
+
 static inline void xdma_io_cb_release(struct xdma_io_cb *cb)
 {
 	int i;
@@ -238,8 +259,7 @@ static inline void xdma_io_cb_release(struct xdma_io_cb *cb)
 	for (i = 0; i < cb->pages_nr; i++)
 		put_page(cb->pages[i]);
 
-	sg_free_table(&cb->sgt);
-	kfree(cb->pages);
+	xdma_io_cb_free_mem(cb);
 
 	memset(cb, 0, sizeof(*cb));
 }
@@ -248,10 +268,10 @@ static void char_sgdma_unmap_user_buf(struct xdma_io_cb *cb, bool write)
 {
 	int i;
 
-	sg_free_table(&cb->sgt);
-
-	if (!cb->pages || !cb->pages_nr)
+	if (!cb->pages || !cb->pages_nr) {
+		xdma_io_cb_free_mem(cb);
 		return;
+	}
 
 	for (i = 0; i < cb->pages_nr; i++) {
 		if (cb->pages[i]) {
@@ -265,8 +285,7 @@ static void char_sgdma_unmap_user_buf(struct xdma_io_cb *cb, bool write)
 	if (i != cb->pages_nr)
 		pr_info("sgl pages %d/%u.\n", i, cb->pages_nr);
 
-	kfree(cb->pages);
-	cb->pages = NULL;
+	xdma_io_cb_free_mem(cb);
 }
 
 static int char_sgdma_map_user_buf_to_sgl(struct xdma_io_cb *cb, bool write)
@@ -284,16 +303,30 @@ static int char_sgdma_map_user_buf_to_sgl(struct xdma_io_cb *cb, bool write)
 	if (pages_nr == 0)
 		return -EINVAL;
 
-	if (sg_alloc_table(sgt, pages_nr, GFP_KERNEL)) {
-		pr_err("sgl OOM.\n");
-		return -ENOMEM;
-	}
+	if (pages_nr <= XDMA_IO_CB_CACHED_PAGES)
+		cb->mem = kmem_cache_alloc(io_cb_cache, GFP_KERNEL);
+	if (cb->mem) {
+		struct xdma_io_cb_mem *mem = cb->mem;
+
+		memset(mem->pages, 0, pages_nr * sizeof(struct page *));
+		sg_init_table(mem->sgl, pages_nr);
+		sgt->sgl = mem->sgl;
+		sgt->nents = pages_nr;
+		sgt->orig_nents = pages_nr;
+		cb->pages = mem->pages;
+	} else {
+		if (sg_alloc_table(sgt, pages_nr, GFP_KERNEL)) {
+			pr_err("sgl OOM.\n");
+			return -ENOMEM;
+		}
 
-	cb->pages = kcalloc(pages_nr, sizeof(struct page *), GFP_KERNEL);
-	if (!cb->pages) {
-		pr_err("pages OOM.\n");
-		rv = -ENOMEM;
-		goto err_out;
+		cb->pages = kcalloc(pages_nr, sizeof(struct page *),
+				    GFP_KERNEL);
+		if (!cb->pages) {
+			pr_err("pages OOM.\n");
+			rv = -ENOMEM;
+			goto err_out;
+		}
 	}
 
 	rv = get_user_pages_fast((unsigned long)buf, pages_nr, 1/* write */,
@@ -390,6 +423,7 @@ static ssize_t char_sgdma_read_write(struct file *file, const char __user *buf,
 	rv = char_sgdma_map_user_buf_to_sgl(&cb, write);
 	if (rv < 0)
 		return rv;
+	atomic64_add(cb.pages_nr, &engine->stats.pages_pinned);
 
 	res = xdma_xfer_submit(xdev, engine->channel, write, *pos, &cb.sgt,
 				0, write ? h2c_timeout * 1000 :
@@ -401,9 +435,213 @@ static ssize_t char_sgdma_read_write(struct file *file, const char __user *buf,
 }
 
 
+/*
+ * write-behind ring: head and tail are free running byte counts, so the
+ * bytes queued are head - tail and an offset is the count mod size
+ */
+struct xdma_wb_ring {
+	struct xdma_cdev *xcdev;
+	struct file *owner;		/* file that started the ring */
+	u8 *virt;			/* ring memory (coherent) */
+	dma_addr_t bus;
+	u32 size;			/* ring size: power of 2 */
+	u32 max_xfer;			/* largest transfer to the FPGA */
+	u64 ep_addr;			/* FPGA address written */
+	u32 head;			/* bytes written by user space */
+	u32 tail;			/* bytes sent to the FPGA */
+	int error;			/* transfer error, for the next write */
+	struct workqueue_struct *wq;	/* own worker: a drain can block */
+	struct work_struct work;	/* drains the ring */
+	struct scatterlist sgl[2];	/* a transfer may wrap the ring */
+	struct sg_table sgt;
+};
+
+static inline u32 wb_ring_space(struct xdma_wb_ring *wb)
+{
+	return wb->size - (READ_ONCE(wb->head) - smp_load_acquire(&wb->tail));
+}
+
+/*
+ * send everything queued, max_xfer at a time. If the FPGA FIFO is full the
+ * transfer stalls on the AXI bus, holding up this worker and not the writer;
+ * the worker is the ring's own, so no shared kworker is held up either.
+ * data that fails to transfer is dropped, so the writer never waits on a
+ * failed engine; the error is returned by its next write.
+ */
+static void wb_ring_drain(struct work_struct *work)
+{
+	struct xdma_wb_ring *wb = container_of(work, struct xdma_wb_ring,
+					       work);
+	struct xdma_cdev *xcdev = wb->xcdev;
+	u32 head, len, off, first;
+	ssize_t res;
+
+	while ((head = smp_load_acquire(&wb->head)) != wb->tail) {
+		len = min(head - wb->tail, wb->max_xfer);
+		off = wb->tail & (wb->size - 1);
+		first = min(len, wb->size - off);
+
+		sg_init_table(wb->sgl, (first < len) ? 2 : 1);
+		sg_dma_address(&wb->sgl[0]) = wb->bus + off;
+		sg_dma_len(&wb->sgl[0]) = first;
+		if (first < len) {
+			sg_dma_address(&wb->sgl[1]) = wb->bus;
+			sg_dma_len(&wb->sgl[1]) = len - first;
+		}
+		wb->sgt.sgl = wb->sgl;
+		wb->sgt.nents = (first < len) ? 2 : 1;
+		wb->sgt.orig_nents = wb->sgt.nents;
+
+		res = xdma_xfer_submit(xcdev->xdev, xcdev->engine->channel,
+				       true, wb->ep_addr, &wb->sgt, true,
+				       h2c_timeout * 1000);
+		if (res != len && !READ_ONCE(wb->error)) {
+			pr_info("%s write-behind xfer %u failed, %ld.\n",
+				xcdev->engine->name, len, (long)res);
+			WRITE_ONCE(wb->error, (res < 0) ? (int)res : -EIO);
+		}
+
+		smp_store_release(&wb->tail, wb->tail + len);
+		wake_up_interruptible(&xcdev->wb_wq);
+	}
+}
+
+/* copy into the ring; xcdev->wb_lock held */
+static ssize_t wb_ring_write(struct xdma_wb_ring *wb, struct file *file,
+			     const char __user *buf, size_t count)
+{
+	struct xdma_cdev *xcdev = wb->xcdev;
+	u32 off, first;
+	long rv;
+
+	if (file != wb->owner)
+		return -EBUSY;
+	if (count == 0)
+		return 0;
+	if (count > wb->size)
+		return -EINVAL;
+	rv = xchg(&wb->error, 0);
+	if (rv)
+		return rv;
+
+	if (wb_ring_space(wb) < count) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		rv = wait_event_interruptible_timeout(xcdev->wb_wq,
+				wb_ring_space(wb) >= count,
+				msecs_to_jiffies(h2c_timeout * 1000));
+		if (rv == 0)
+			return -ETIMEDOUT;
+		if (rv < 0)
+			return rv;
+	}
+
+	off = wb->head & (wb->size - 1);
+	first = min_t(u32, count, wb->size - off);
+	if (copy_from_user(wb->virt + off, buf, first) ||
+	    copy_from_user(wb->virt, buf + first, count - first))
+		return -EFAULT;
+
+	smp_store_release(&wb->head, wb->head + (u32)count);
+	queue_work(wb->wq, &wb->work);
+	return count;
+}
+
+static int ioctl_do_wb_start(struct xdma_cdev *xcdev, struct file *file,
+			     unsigned long arg)
+{
+	struct xdma_dev *xdev = xcdev->xdev;
+	struct xdma_wb_ioctl req;
+	struct xdma_wb_ring *wb;
+	int rv = 0;
+
+	if (xcdev->engine->dir != DMA_TO_DEVICE)
+		return -EINVAL;
+	if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+		return -EFAULT;
+	if (!is_power_of_2(req.ring_len) || req.ring_len < PAGE_SIZE ||
+	    req.ring_len > XDMA_WB_RING_LEN_MAX || req.max_xfer == 0 ||
+	    req.max_xfer > req.ring_len)
+		return -EINVAL;
+
+	wb = kzalloc(sizeof(*wb), GFP_KERNEL);
+	if (!wb)
+		return -ENOMEM;
+	wb->virt = dma_alloc_coherent(&xdev->pdev->dev, req.ring_len,
+				      &wb->bus, GFP_KERNEL);
+	if (!wb->virt) {
+		kfree(wb);
+		return -ENOMEM;
+	}
+	wb->xcdev = xcdev;
+	wb->owner = file;
+	wb->size = req.ring_len;
+	wb->max_xfer = req.max_xfer;
+	wb->ep_addr = req.ep_addr;
+	INIT_WORK(&wb->work, wb_ring_drain);
+	wb->wq = alloc_workqueue("xdma_wb_%s", WQ_HIGHPRI | WQ_UNBOUND, 1,
+				 xcdev->engine->name);
+	if (!wb->wq)
+		rv = -ENOMEM;
+
+	mutex_lock(&xcdev->wb_lock);
+	if (!rv && xcdev->wb)
+		rv = -EBUSY;
+	else if (!rv)
+		rcu_assign_pointer(xcdev->wb, wb);
+	mutex_unlock(&xcdev->wb_lock);
+
+	if (rv) {
+		if (wb->wq)
+			destroy_workqueue(wb->wq);
+		dma_free_coherent(&xdev->pdev->dev, wb->size, wb->virt,
+				  wb->bus);
+		kfree(wb);
+	}
+	return rv;
+}
+
+/* send what is queued, then free the ring; returns any transfer error */
+static int wb_ring_stop(struct xdma_cdev *xcdev, struct file *file)
+{
+	struct xdma_wb_ring *wb;
+	int rv;
+
+	mutex_lock(&xcdev->wb_lock);
+	wb = xcdev->wb;
+	if (!wb || wb->owner != file) {
+		mutex_unlock(&xcdev->wb_lock);
+		return -EINVAL;
+	}
+	rcu_assign_pointer(xcdev->wb, NULL);
+	mutex_unlock(&xcdev->wb_lock);
+	synchronize_rcu();		/* no poll() still looking at it */
+
+	flush_work(&wb->work);
+	destroy_workqueue(wb->wq);
+	rv = wb->error;
+	dma_free_coherent(&xcdev->xdev->pdev->dev, wb->size, wb->virt,
+			  wb->bus);
+	kfree(wb);
+	wake_up_interruptible(&xcdev->wb_wq);
+	return rv;
+}
+
 static ssize_t char_sgdma_write(struct file *file, const char __user *buf,
 		size_t count, loff_t *pos)
 {
+	struct xdma_cdev *xcdev = (struct xdma_cdev *)file->private_data;
+	ssize_t res;
+
+	if (READ_ONCE(xcdev->wb)) {
+		mutex_lock(&xcdev->wb_lock);
+		if (xcdev->wb) {
+			res = wb_ring_write(xcdev->wb, file, buf, count);
+			mutex_unlock(&xcdev->wb_lock);
+			return res;
+		}
+		mutex_unlock(&xcdev->wb_lock);
+	}
 	return char_sgdma_read_write(file, buf, count, pos, 1);
 }
 
@@ -472,6 +710,8 @@ static ssize_t cdev_aio_write(struct kiocb *iocb, const struct iovec *io,
 		rv = char_sgdma_map_user_buf_to_sgl(&caio->cb[i], true);
 		if (rv < 0)
 			return rv;
+		atomic64_add(caio->cb[i].pages_nr,
+			     &engine->stats.pages_pinned);
 
 		rv = xdma_xfer_submit_nowait((void *)&caio->cb[i], xdev,
 					engine->channel, caio->cb[i].write,
@@ -546,6 +786,8 @@ static ssize_t cdev_aio_read(struct kiocb *iocb, const struct iovec *io,
 		rv = char_sgdma_map_user_buf_to_sgl(&caio->cb[i], true);
 		if (rv < 0)
 			return rv;
+		atomic64_add(caio->cb[i].pages_nr,
+			     &engine->stats.pages_pinned);
 
 		rv = xdma_xfer_submit_nowait((void *)&caio->cb[i], xdev,
 					engine->channel, caio->cb[i].write,
@@ -560,16 +802,424 @@ static ssize_t cdev_aio_read(struct kiocb *iocb, const struct iovec *io,
 }
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 16, 0)
+/* the device address comes from the file position, not the iov_iter offset */
 static ssize_t cdev_write_iter(struct kiocb *iocb, struct iov_iter *io)
 {
-	return cdev_aio_write(iocb, io->iov, io->nr_segs, io->iov_offset);
+	return cdev_aio_write(iocb, io->iov, io->nr_segs, iocb->ki_pos);
 }
 
 static ssize_t cdev_read_iter(struct kiocb *iocb, struct iov_iter *io)
 {
-	return cdev_aio_read(iocb, io->iov, io->nr_segs, io->iov_offset);
+	return cdev_aio_read(iocb, io->iov, io->nr_segs, iocb->ki_pos);
+}
+#endif
+
+/*
+ * user buffers registered with IOCTL_XDMA_BUF_PIN. The pages stay pinned and
+ * DMA mapped until unpinned or the file is closed, so a transfer on one makes
+ * no page pinning, scatterlist allocation or mapping calls; only the cache
+ * maintenance for the part of the buffer transferred.
+ */
+struct xdma_pinned_buf {
+	struct file *owner;		/* file that registered the buffer */
+	unsigned long addr;		/* user address of the buffer */
+	size_t len;
+	unsigned int pages_nr;
+	struct page **pages;
+	struct sg_table sgt;		/* whole buffer, DMA mapped */
+	struct sg_table xfer_sgt;	/* part of sgt used by the current transfer */
+	enum dma_data_direction dir;
+};
+
+static void pinned_buf_unpin_pages(struct page **pages, unsigned int pages_nr,
+				   bool dirty)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+	unpin_user_pages_dirty_lock(pages, pages_nr, dirty);
+#else
+	unsigned int i;
+
+	for (i = 0; i < pages_nr; i++) {
+		if (dirty)
+			set_page_dirty_lock(pages[i]);
+		put_page(pages[i]);
+	}
+#endif
+}
+
+static void pinned_buf_free(struct xdma_dev *xdev, struct xdma_pinned_buf *pb)
+{
+	dma_unmap_sg(&xdev->pdev->dev, pb->sgt.sgl, pb->sgt.orig_nents,
+		     pb->dir);
+	sg_free_table(&pb->xfer_sgt);
+	sg_free_table(&pb->sgt);
+	pinned_buf_unpin_pages(pb->pages, pb->pages_nr,
+			       pb->dir == DMA_FROM_DEVICE);
+	kfree(pb->pages);
+	kfree(pb);
+}
+
+/* release the buffers registered through a file, or all of them if NULL */
+static void pinned_buf_release(struct xdma_cdev *xcdev, struct file *file)
+{
+	struct xdma_pinned_buf *pb;
+	int i;
+
+	mutex_lock(&xcdev->pinned_lock);
+	for (i = 0; i < XDMA_PINNED_BUF_MAX; i++) {
+		pb = xcdev->pinned[i];
+		if (pb && (!file || pb->owner == file)) {
+			xcdev->pinned[i] = NULL;
+			pinned_buf_free(xcdev->xdev, pb);
+		}
+	}
+	mutex_unlock(&xcdev->pinned_lock);
+}
+
+/*
+ * point xfer_sgt at len bytes from offset in the mapped buffer.
+ * the DMA addresses are copied from the existing mapping, so nothing is
+ * allocated or mapped here.
+ */
+static void pinned_buf_select(struct xdma_pinned_buf *pb, size_t offset,
+			      size_t len)
+{
+	struct scatterlist *sg;
+	struct scatterlist *xsg = pb->xfer_sgt.sgl;
+	unsigned int nents = 0;
+	unsigned int slen;
+	unsigned int nbytes;
+	int i;
+
+	for_each_sg(pb->sgt.sgl, sg, pb->sgt.nents, i) {
+		slen = sg_dma_len(sg);
+		if (offset >= slen) {
+			offset -= slen;
+			continue;
+		}
+		nbytes = min_t(size_t, slen - offset, len);
+		sg_dma_address(xsg) = sg_dma_address(sg) + offset;
+		sg_dma_len(xsg) = nbytes;
+		nents++;
+		len -= nbytes;
+		offset = 0;
+		if (!len)
+			break;
+		xsg = sg_next(xsg);
+	}
+	pb->xfer_sgt.nents = nents;
 }
+
+static int ioctl_do_buf_pin(struct xdma_cdev *xcdev, struct file *file,
+			    unsigned long arg)
+{
+	struct xdma_dev *xdev = xcdev->xdev;
+	struct xdma_engine *engine = xcdev->engine;
+	struct xdma_pin_ioctl pin;
+	struct xdma_pinned_buf *pb;
+	unsigned long addr;
+	int nents;
+	int slot;
+	int rv;
+
+	if (copy_from_user(&pin, (void __user *)arg, sizeof(pin)))
+		return -EFAULT;
+	addr = (unsigned long)pin.addr;
+	if (!pin.len || pin.len > XDMA_PINNED_BUF_LEN_MAX)
+		return -EINVAL;
+
+	pb = kzalloc(sizeof(*pb), GFP_KERNEL);
+	if (!pb)
+		return -ENOMEM;
+	pb->owner = file;
+	pb->addr = addr;
+	pb->len = pin.len;
+	pb->dir = engine->dir;
+	pb->pages_nr = ((addr + pb->len + PAGE_SIZE - 1) >> PAGE_SHIFT) -
+		       (addr >> PAGE_SHIFT);
+	pb->pages = kcalloc(pb->pages_nr, sizeof(struct page *), GFP_KERNEL);
+	if (!pb->pages) {
+		rv = -ENOMEM;
+		goto err_free;
+	}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+	rv = pin_user_pages_fast(addr & PAGE_MASK, pb->pages_nr,
+				 FOLL_WRITE | FOLL_LONGTERM, pb->pages);
+#else
+	rv = get_user_pages_fast(addr & PAGE_MASK, pb->pages_nr, 1/* write */,
+				 pb->pages);
 #endif
+	if (rv < 0) {
+		pr_err("unable to pin down %u user pages, %d.\n",
+			pb->pages_nr, rv);
+		goto err_free_pages;
+	}
+	if (rv != pb->pages_nr) {
+		pr_err("unable to pin down all %u user pages, %d.\n",
+			pb->pages_nr, rv);
+		pinned_buf_unpin_pages(pb->pages, rv, false);
+		rv = -EFAULT;
+		goto err_free_pages;
+	}
+	atomic64_add(pb->pages_nr, &engine->stats.pages_pinned);
+
+	rv = sg_alloc_table_from_pages(&pb->sgt, pb->pages, pb->pages_nr,
+				       offset_in_page(addr), pb->len,
+				       GFP_KERNEL);
+	if (rv)
+		goto err_unpin;
+	rv = sg_alloc_table(&pb->xfer_sgt, pb->sgt.orig_nents, GFP_KERNEL);
+	if (rv)
+		goto err_free_sgt;
+
+	nents = dma_map_sg(&xdev->pdev->dev, pb->sgt.sgl, pb->sgt.orig_nents,
+			   pb->dir);
+	if (!nents) {
+		pr_err("map sgl failed, sgt 0x%p.\n", &pb->sgt);
+		rv = -EIO;
+		goto err_free_xfer_sgt;
+	}
+	pb->sgt.nents = nents;
+
+	mutex_lock(&xcdev->pinned_lock);
+	for (slot = 0; slot < XDMA_PINNED_BUF_MAX; slot++)
+		if (!xcdev->pinned[slot])
+			break;
+	if (slot == XDMA_PINNED_BUF_MAX) {
+		mutex_unlock(&xcdev->pinned_lock);
+		pinned_buf_free(xdev, pb);
+		return -ENOSPC;
+	}
+	xcdev->pinned[slot] = pb;
+	mutex_unlock(&xcdev->pinned_lock);
+
+	dbg_tfr("%s: pinned %u pages @ 0x%lx, handle %d.\n", engine->name,
+		pb->pages_nr, addr, slot + 1);
+	pin.handle = slot + 1;
+	if (copy_to_user((void __user *)arg, &pin, sizeof(pin))) {
+		mutex_lock(&xcdev->pinned_lock);
+		xcdev->pinned[slot] = NULL;
+		mutex_unlock(&xcdev->pinned_lock);
+		pinned_buf_free(xdev, pb);
+		return -EFAULT;
+	}
+	return 0;
+
+err_free_xfer_sgt:
+	sg_free_table(&pb->xfer_sgt);
+err_free_sgt:
+	sg_free_table(&pb->sgt);
+err_unpin:
+	pinned_buf_unpin_pages(pb->pages, pb->pages_nr, false);
+err_free_pages:
+	kfree(pb->pages);
+err_free:
+	kfree(pb);
+	return rv;
+}
+
+static int ioctl_do_buf_unpin(struct xdma_cdev *xcdev, struct file *file,
+			      unsigned long arg)
+{
+	struct xdma_pinned_buf *pb;
+
+	if (arg == 0 || arg > XDMA_PINNED_BUF_MAX)
+		return -EINVAL;
+
+	mutex_lock(&xcdev->pinned_lock);
+	pb = xcdev->pinned[arg - 1];
+	if (!pb || pb->owner != file) {
+		mutex_unlock(&xcdev->pinned_lock);
+		return -EINVAL;
+	}
+	xcdev->pinned[arg - 1] = NULL;
+	mutex_unlock(&xcdev->pinned_lock);
+
+	pinned_buf_free(xcdev->xdev, pb);
+	return 0;
+}
+
+/*
+ * transfer part of a pinned buffer; returns the number of bytes transferred
+ * the lock is held for the transfer, so the buffer can't be unpinned under it
+ */
+static long ioctl_do_pinned_xfer(struct xdma_cdev *xcdev, struct file *file,
+				 unsigned long arg)
+{
+	struct xdma_dev *xdev = xcdev->xdev;
+	struct xdma_engine *engine = xcdev->engine;
+	struct xdma_pinned_xfer_ioctl xfer;
+	struct xdma_pinned_buf *pb;
+	struct scatterlist *sg;
+	bool write = (engine->dir == DMA_TO_DEVICE);
+	ssize_t res;
+	int i;
+
+	if (copy_from_user(&xfer, (void __user *)arg, sizeof(xfer)))
+		return -EFAULT;
+	if (xfer.handle == 0 || xfer.handle > XDMA_PINNED_BUF_MAX)
+		return -EINVAL;
+
+	mutex_lock(&xcdev->pinned_lock);
+	pb = xcdev->pinned[xfer.handle - 1];
+	if (!pb || pb->owner != file || xfer.len == 0 ||
+	    xfer.offset > pb->len || xfer.len > pb->len - xfer.offset) {
+		res = -EINVAL;
+		goto out;
+	}
+	if (READ_ONCE(xcdev->wb)) {
+		res = -EBUSY;		/* writes go through the ring */
+		goto out;
+	}
+
+	res = check_transfer_align(engine,
+			(const char __user *)(pb->addr + xfer.offset),
+			xfer.len, xfer.ep_addr, 1);
+	if (res) {
+		pr_info("Invalid transfer alignment detected\n");
+		goto out;
+	}
+
+	/*
+	 * hand the buffer to the device in both directions: for a read this
+	 * invalidates the CPU cache, so no dirty line is written back over the
+	 * data the engine is about to DMA in (pb->dir is DMA_FROM_DEVICE then).
+	 */
+	pinned_buf_select(pb, xfer.offset, xfer.len);
+	for_each_sg(pb->xfer_sgt.sgl, sg, pb->xfer_sgt.nents, i)
+		dma_sync_single_for_device(&xdev->pdev->dev,
+			sg_dma_address(sg), sg_dma_len(sg), pb->dir);
+
+	res = xdma_xfer_submit(xdev, engine->channel, write, xfer.ep_addr,
+				&pb->xfer_sgt, 1, write ? h2c_timeout * 1000 :
+							 c2h_timeout * 1000);
+
+	if (!write && res > 0) {
+		for_each_sg(pb->xfer_sgt.sgl, sg, pb->xfer_sgt.nents, i)
+			dma_sync_single_for_cpu(&xdev->pdev->dev,
+				sg_dma_address(sg), sg_dma_len(sg), pb->dir);
+	}
+out:
+	mutex_unlock(&xcdev->pinned_lock);
+	return res;
+}
+
+static int ioctl_do_stream_start(struct xdma_cdev *xcdev, struct file *file,
+				 unsigned long arg)
+{
+	struct xdma_stream_ioctl stream;
+	int rv;
+
+	if (copy_from_user(&stream, (void __user *)arg, sizeof(stream)))
+		return -EFAULT;
+	rv = xdma_stream_ring_start(xcdev->engine, file, stream.ep_addr,
+				    stream.block_size, stream.block_count);
+	if (rv < 0)
+		return rv;
+
+	stream.map_len = PAGE_SIZE +
+			 PAGE_ALIGN(stream.block_size * stream.block_count);
+	if (copy_to_user((void __user *)arg, &stream, sizeof(stream))) {
+		xdma_stream_ring_stop(xcdev->engine, file);
+		return -EFAULT;
+	}
+	return 0;
+}
+
+/*
+ * each mapping of the streaming ring holds a reference to it, so the memory
+ * outlives IOCTL_XDMA_STREAM_STOP until it is unmapped
+ */
+static void stream_vma_open(struct vm_area_struct *vma)
+{
+	struct xdma_stream_ring *ring = vma->vm_private_data;
+
+	kref_get(&ring->ref);
+}
+
+static void stream_vma_close(struct vm_area_struct *vma)
+{
+	xdma_stream_ring_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct stream_vm_ops = {
+	.open = stream_vma_open,
+	.close = stream_vma_close,
+};
+
+static int char_sgdma_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct xdma_cdev *xcdev = (struct xdma_cdev *)file->private_data;
+	struct xdma_stream_ring *ring;
+	unsigned long len = vma->vm_end - vma->vm_start;
+	int rv;
+
+	rv = xcdev_check(__func__, xcdev, 1);
+	if (rv < 0)
+		return rv;
+
+	ring = xdma_stream_ring_get(xcdev->engine);
+	if (!ring)
+		return -ENODEV;
+	/* the data blocks may be mapped on their own, at data_offset */
+	if ((vma->vm_pgoff << PAGE_SHIFT) + len > ring->size) {
+		xdma_stream_ring_put(ring);
+		return -EINVAL;
+	}
+
+	rv = dma_mmap_coherent(ring->dev, vma, ring->virt, ring->bus,
+			       ring->size);
+	if (rv < 0) {
+		xdma_stream_ring_put(ring);
+		return rv;
+	}
+	vma->vm_private_data = ring;
+	vma->vm_ops = &stream_vm_ops;
+	return 0;
+}
+
+static unsigned int char_sgdma_poll(struct file *file, poll_table *wait)
+{
+	struct xdma_cdev *xcdev = (struct xdma_cdev *)file->private_data;
+	struct xdma_engine *engine;
+	struct xdma_stream_ring *ring;
+	unsigned int mask = 0;
+
+	if (xcdev_check(__func__, xcdev, 1) < 0)
+		return POLLERR;
+	engine = xcdev->engine;
+
+	/*
+	 * H2C: writable while the write-behind ring has a page free.
+	 * lockless, so poll() isn't held up behind a writer waiting for space;
+	 * RCU keeps the ring from being freed under us.
+	 */
+	if (engine->dir == DMA_TO_DEVICE) {
+		struct xdma_wb_ring *wb;
+
+		poll_wait(file, &xcdev->wb_wq, wait);
+		rcu_read_lock();
+		wb = rcu_dereference(xcdev->wb);
+		if (!wb || wb_ring_space(wb) >= min_t(u32, PAGE_SIZE, wb->size))
+			mask |= POLLOUT | POLLWRNORM;
+		if (wb && READ_ONCE(wb->error))
+			mask |= POLLERR;
+		rcu_read_unlock();
+		return mask;
+	}
+
+	poll_wait(file, &engine->stream_wq, wait);
+	ring = xdma_stream_ring_get(engine);
+	if (!ring)
+		return POLLERR;
+	if (READ_ONCE(ring->ctrl->head) != READ_ONCE(ring->ctrl->tail))
+		mask |= POLLIN | POLLRDNORM;	/* readable */
+	if (READ_ONCE(ring->ctrl->error))
+		mask |= POLLERR;
+	xdma_stream_ring_put(ring);
+	return mask;
+}
 
 static int ioctl_do_perf_start(struct xdma_engine *engine, unsigned long arg)
 {
@@ -766,6 +1416,26 @@ static long char_sgdma_ioctl(struct file *file, unsigned int cmd,
 	case IOCTL_XDMA_ALIGN_GET:
 		rv = ioctl_do_align_get(engine, arg);
 		break;
+	case IOCTL_XDMA_BUF_PIN:
+		rv = ioctl_do_buf_pin(xcdev, file, arg);
+		break;
+	case IOCTL_XDMA_BUF_UNPIN:
+		rv = ioctl_do_buf_unpin(xcdev, file, arg);
+		break;
+	case IOCTL_XDMA_PINNED_XFER:
+		return ioctl_do_pinned_xfer(xcdev, file, arg);
+	case IOCTL_XDMA_STREAM_START:
+		rv = ioctl_do_stream_start(xcdev, file, arg);
+		break;
+	case IOCTL_XDMA_STREAM_STOP:
+		rv = xdma_stream_ring_stop(engine, file);
+		break;
+	case IOCTL_XDMA_WB_START:
+		rv = ioctl_do_wb_start(xcdev, file, arg);
+		break;
+	case IOCTL_XDMA_WB_STOP:
+		rv = wb_ring_stop(xcdev, file);
+		break;
 	default:
 		dbg_perf("Unsupported operation\n");
 		rv = -EINVAL;
@@ -811,6 +1481,12 @@ static int char_sgdma_close(struct inode *inode, struct file *file)
 	if (engine->streaming && engine->dir == DMA_FROM_DEVICE)
 		engine->device_open = 0;
 
+	pinned_buf_release(xcdev, file);
+	if (engine->stream_ring)
+		xdma_stream_ring_stop(engine, file);
+	if (xcdev->wb)
+		wb_ring_stop(xcdev, file);
+
 	return 0;
 }
 static const struct file_operations sgdma_fops = {
@@ -831,6 +1507,8 @@ static const struct file_operations sgdma_fops = {
 #endif
 	.unlocked_ioctl = char_sgdma_ioctl,
 	.llseek = char_sgdma_llseek,
+	.mmap = char_sgdma_mmap,
+	.poll = char_sgdma_poll,
 };
 
 void cdev_sgdma_init(struct xdma_cdev *xcdev)
@@ -60,6 +60,80 @@ struct xdma_performance_ioctl {
 
 
 
+/*
+ * pinned buffers: a user buffer is registered once with IOCTL_XDMA_BUF_PIN and
+ * stays pinned and DMA mapped until IOCTL_XDMA_BUF_UNPIN or the file is closed.
+ * IOCTL_XDMA_PINNED_XFER then transfers part of it, in the direction of the
+ * engine the file belongs to, and returns the number of bytes transferred.
+ */
+#define XDMA_PINNED_BUF_MAX	8			/* buffers per engine */
+#define XDMA_PINNED_BUF_LEN_MAX	(16 * 1024 * 1024)	/* bytes per buffer */
+
+struct xdma_pin_ioctl {
+	uint64_t addr;		/* user buffer address */
+	uint64_t len;		/* buffer length in bytes */
+	uint32_t handle;	/* returned: handle for the buffer (non zero) */
+	uint32_t pad;
+};
+
+struct xdma_pinned_xfer_ioctl {
+	uint32_t handle;	/* from IOCTL_XDMA_BUF_PIN */
+	uint32_t pad;
+	uint64_t offset;	/* byte offset in the pinned buffer */
+	uint64_t len;		/* number of bytes to transfer */
+	uint64_t ep_addr;	/* FPGA address, as the file position for read/write */
+};
+
+/*
+ * streaming ring: IOCTL_XDMA_STREAM_START makes the driver allocate a ring of
+ * block_count blocks and keep the C2H engine filling it from ep_addr until
+ * IOCTL_XDMA_STREAM_STOP or the file is closed. The ring is read in place
+ * through mmap(): offset 0 holds struct xdma_stream_ctrl, and block n (counted
+ * from the start) is at data_offset + (n % block_count) * block_size.
+ * the driver advances head as blocks fill; user space advances tail as it
+ * consumes them. poll() reports POLLIN while head != tail.
+ * read() and write() on the engine return EBUSY while the ring runs.
+ */
+#define XDMA_STREAM_BLOCKS_MAX		1024
+#define XDMA_STREAM_RING_LEN_MAX	(16 * 1024 * 1024)
+
+struct xdma_stream_ctrl {
+	uint32_t head;		/* driver: blocks filled since the start */
+	uint32_t tail;		/* user: blocks consumed since the start */
+	uint32_t block_size;	/* bytes per block */
+	uint32_t block_count;	/* blocks in the ring */
+	uint32_t data_offset;	/* mmap offset of block 0 */
+	uint32_t overruns;	/* times the head lapped the tail */
+	uint32_t error;		/* engine status if the engine stopped */
+};
+
+struct xdma_stream_ioctl {
+	uint64_t ep_addr;	/* FPGA address each block is read from */
+	uint32_t block_size;	/* bytes per block (multiple of 4) */
+	uint32_t block_count;	/* blocks in the ring */
+	uint32_t map_len;	/* returned: length to mmap */
+	uint32_t pad;
+};
+
+/*
+ * write-behind ring (H2C): after IOCTL_XDMA_WB_START, write() on the file
+ * copies into a kernel ring and returns at once; the driver sends the ring
+ * to ep_addr in transfers of up to max_xfer bytes, so packets written close
+ * together go in one descriptor chain. write() blocks only if the ring is
+ * full (EAGAIN with O_NONBLOCK), and the file position is ignored.
+ * a failed transfer is reported by the next write(). IOCTL_XDMA_WB_STOP,
+ * or closing the file, sends what is queued and frees the ring.
+ * ring_len must be a power of 2, at least one page.
+ */
+#define XDMA_WB_RING_LEN_MAX	(4 * 1024 * 1024)
+
+struct xdma_wb_ioctl {
+	uint64_t ep_addr;	/* FPGA address written */
+	uint32_t ring_len;	/* ring size in bytes */
+	uint32_t max_xfer;	/* largest transfer to the FPGA */
+};
+
+
 /* IOCTL codes */
 
 #define IOCTL_XDMA_PERF_START   _IOW('q', 1, struct xdma_performance_ioctl *)
@@ -68,5 +142,12 @@ struct xdma_performance_ioctl {
 #define IOCTL_XDMA_ADDRMODE_SET _IOW('q', 4, int)
 #define IOCTL_XDMA_ADDRMODE_GET _IOR('q', 5, int)
 #define IOCTL_XDMA_ALIGN_GET    _IOR('q', 6, int)
+#define IOCTL_XDMA_BUF_PIN      _IOWR('q', 7, struct xdma_pin_ioctl)
+#define IOCTL_XDMA_BUF_UNPIN    _IOW('q', 8, int)
+#define IOCTL_XDMA_PINNED_XFER  _IOW('q', 9, struct xdma_pinned_xfer_ioctl)
+#define IOCTL_XDMA_STREAM_START _IOWR('q', 10, struct xdma_stream_ioctl)
+#define IOCTL_XDMA_STREAM_STOP  _IO('q', 11)
+#define IOCTL_XDMA_WB_START     _IOW('q', 12, struct xdma_wb_ioctl)
+#define IOCTL_XDMA_WB_STOP      _IO('q', 13)
 
 #endif /* _XDMA_IOCALLS_POSIX_H_ */
@@ -29,6 +29,8 @@
 #include <linux/interrupt.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/pci.h>
 #include <linux/workqueue.h>
 
@@ -280,6 +282,8 @@ struct xdma_io_cb {
 	unsigned int pages_nr;
 	struct sg_table sgt;
 	struct page **pages;
+	/** from io_cb_cache: holds pages and the sgl, else NULL */
+	void *mem;
 	/** total data size */
 	unsigned int count;
 	/** MM only, DDR/BRAM memory addr */
@@ -459,6 +463,7 @@ struct xdma_transfer {
 	unsigned int len;
 	struct sg_table *sgt;
 	struct xdma_io_cb *cb;
+	ktime_t submit_time;		/* when queued, for latency stats */
 };
 
 struct xdma_request_cb {
@@ -473,9 +478,37 @@ struct xdma_request_cb {
 
 	unsigned int sw_desc_idx;
 	unsigned int sw_desc_cnt;
+	u8 cached:1;		/* allocated from the request cache */
 	struct sw_desc sdesc[0];
 };
 
+/*
+ * requests with up to XDMA_REQ_CACHED_DESC descriptors come from a slab cache,
+ * which covers the 32KB and smaller transfers of a typical application
+ */
+#define XDMA_REQ_CACHED_DESC	16
+
+/*
+ * always-on engine statistics, exported through sysfs by xdma_cdev.c.
+ * latency bucket i counts transfers that completed less than 2^i us after
+ * they were queued; the last bucket also counts any slower ones.
+ * a streaming ring adds its blocks to bytes and descriptors only.
+ */
+#define XDMA_STATS_LAT_BUCKETS	16
+
+#define XDMA_HYBRID_POLL_US_MAX	1000	/* longest busy-poll allowed */
+
+struct xdma_engine_stats {
+	atomic64_t transfers;		/* transfers completed */
+	atomic64_t bytes;		/* bytes transferred */
+	atomic64_t descriptors;		/* descriptors completed */
+	atomic64_t errors;		/* transfers failed by the engine */
+	atomic64_t timeouts;		/* transfers that timed out */
+	atomic64_t pages_pinned;	/* user pages pinned for transfers */
+	atomic64_t polled;		/* transfers completed by hybrid polling */
+	atomic64_t latency[XDMA_STATS_LAT_BUCKETS];
+};
+
 struct xdma_engine {
 	unsigned long magic;	/* structure ID for sanity checks */
 	struct xdma_dev *xdev;	/* parent device */
@@ -516,6 +549,11 @@ struct xdma_engine {
 	u8 *perf_buf_virt;
 	dma_addr_t perf_buf_bus; /* bus address */
 
+	/* kernel streaming ring (C2H MM), replaces transfers while running */
+	struct xdma_stream_ring *stream_ring;
+	int stream_stalled;		/* ring stop timed out: engine may be busy */
+	wait_queue_head_t stream_wq;	/* woken as ring blocks complete */
+
 	/* Members associated with polled mode support */
 	u8 *poll_mode_addr_virt;	/* virt addr for descriptor writeback */
 	dma_addr_t poll_mode_bus;	/* bus addr for descriptor writeback */
@@ -538,6 +576,16 @@ struct xdma_engine {
 	int desc_idx;			/* current descriptor index */
 	int desc_used;			/* total descriptors used */
 
+	struct xdma_engine_stats stats;	/* always-on counters */
+
+	/*
+	 * hybrid completion (interrupt mode only): a transfer of up to
+	 * hybrid_poll_bytes busy-polls the engine for up to hybrid_poll_us
+	 * before sleeping until the interrupt. Set per engine through sysfs.
+	 */
+	u32 hybrid_poll_us;		/* 0 = off */
+	u32 hybrid_poll_bytes;
+
 	/* for performance test support */
 	struct xdma_performance_ioctl *xdma_perf;	/* perf test control */
 #if	HAS_SWAKE_UP
@@ -558,6 +606,7 @@ struct xdma_user_irq {
 	struct xdma_dev *xdev;		/* parent device */
 	u8 user_idx;			/* 0 ~ 15 */
 	u8 events_irq;			/* accumulated IRQs */
+	int events_users;		/* opens of the events node */
 	spinlock_t events_lock;		/* lock to safely update events_irq */
 	wait_queue_head_t events_wq;	/* wait queue to sync waiting threads */
 	irq_handler_t handler;
@@ -672,6 +721,35 @@ void xdma_device_online(struct pci_dev *pdev, void *dev_handle);
 
 int xdma_performance_submit(struct xdma_dev *xdev, struct xdma_engine *engine);
 struct xdma_transfer *engine_cyclic_stop(struct xdma_engine *engine);
+
+/*
+ * kernel allocated C2H streaming ring: one coherent buffer holding a control
+ * page then block_count blocks, filled by a cyclic descriptor chain that runs
+ * until stopped. Mapped to user space by the sgdma cdev.
+ */
+struct xdma_stream_ring {
+	struct kref ref;		/* engine while running, plus each mapping */
+	struct device *dev;
+	void *virt;			/* control page, then the data blocks */
+	dma_addr_t bus;
+	size_t size;			/* bytes allocated */
+	struct xdma_stream_ctrl *ctrl;	/* at the start of virt */
+	struct xdma_desc *desc_virt;	/* one descriptor per block */
+	dma_addr_t desc_bus;
+	unsigned int block_size;
+	unsigned int block_count;
+	void *owner;			/* file that started the ring */
+};
+
+int xdma_stream_ring_start(struct xdma_engine *engine, void *owner,
+			   u64 ep_addr, unsigned int block_size,
+			   unsigned int block_count);
+void xdma_engine_stats_reset(struct xdma_engine *engine);
+int xdma_request_cache_init(void);
+void xdma_request_cache_cleanup(void);
+int xdma_stream_ring_stop(struct xdma_engine *engine, void *owner);
+struct xdma_stream_ring *xdma_stream_ring_get(struct xdma_engine *engine);
+void xdma_stream_ring_put(struct xdma_stream_ring *ring);
 void enable_perf(struct xdma_engine *engine);
 void get_perf_stats(struct xdma_engine *engine);
 
@@ -24,6 +24,7 @@
 static struct class *g_xdma_class;
 
 struct kmem_cache *cdev_cache;
+struct kmem_cache *io_cb_cache;
 
 enum cdev_type {
 	CHAR_USER,
@@ -91,6 +92,148 @@ ssize_t xdma_dev_instance_show(struct device *dev,
 static DEVICE_ATTR_RO(xdma_dev_instance);
 #endif
 
+/*
+ * per engine statistics, always present:
+ * /sys/class/xdma/xdma<N>_<h2c|c2h>_<C>/stats/
+ * latency_us has one line per bucket: upper limit (us), count.
+ * writing anything to stats/reset clears the counters.
+ */
+#define XDMA_STATS_ATTR(_name)						\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct xdma_cdev *xcdev = dev_get_drvdata(dev);			\
+									\
+	return snprintf(buf, PAGE_SIZE, "%lld\n",			\
+		(long long)atomic64_read(&xcdev->engine->stats._name));	\
+}									\
+static DEVICE_ATTR_RO(_name)
+
+XDMA_STATS_ATTR(transfers);
+XDMA_STATS_ATTR(bytes);
+XDMA_STATS_ATTR(descriptors);
+XDMA_STATS_ATTR(errors);
+XDMA_STATS_ATTR(timeouts);
+XDMA_STATS_ATTR(pages_pinned);
+XDMA_STATS_ATTR(polled);
+
+static ssize_t latency_us_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct xdma_cdev *xcdev = dev_get_drvdata(dev);
+	struct xdma_engine_stats *stats = &xcdev->engine->stats;
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < XDMA_STATS_LAT_BUCKETS; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%u\t%lld\n",
+				 1U << i,
+				 (long long)atomic64_read(&stats->latency[i]));
+	return len;
+}
+static DEVICE_ATTR_RO(latency_us);
+
+static ssize_t reset_store(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	struct xdma_cdev *xcdev = dev_get_drvdata(dev);
+
+	xdma_engine_stats_reset(xcdev->engine);
+	return count;
+}
+static DEVICE_ATTR_WO(reset);
+
+static struct attribute *xdma_engine_stats_attrs[] = {
+	&dev_attr_transfers.attr,
+	&dev_attr_bytes.attr,
+	&dev_attr_descriptors.attr,
+	&dev_attr_errors.attr,
+	&dev_attr_timeouts.attr,
+	&dev_attr_pages_pinned.attr,
+	&dev_attr_polled.attr,
+	&dev_attr_latency_us.attr,
+	&dev_attr_reset.attr,
+	NULL,
+};
+
+static const struct attribute_group xdma_engine_stats_group = {
+	.name = "stats",
+	.attrs = xdma_engine_stats_attrs,
+};
+
+/*
+ * per engine hybrid completion policy:
+ * /sys/class/xdma/xdma<N>_<h2c|c2h>_<C>/completion/
+ * poll_us: busy-poll time before waiting for the interrupt, 0 = off
+ * poll_max_bytes: largest transfer that is polled
+ */
+static ssize_t poll_us_show(struct device *dev, struct device_attribute *attr,
+			    char *buf)
+{
+	struct xdma_cdev *xcdev = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", xcdev->engine->hybrid_poll_us);
+}
+
+static ssize_t poll_us_store(struct device *dev, struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct xdma_cdev *xcdev = dev_get_drvdata(dev);
+	unsigned int val;
+	int rv;
+
+	rv = kstrtouint(buf, 0, &val);
+	if (rv)
+		return rv;
+	if (val > XDMA_HYBRID_POLL_US_MAX)
+		return -EINVAL;
+	WRITE_ONCE(xcdev->engine->hybrid_poll_us, val);
+	return count;
+}
+static DEVICE_ATTR_RW(poll_us);
+
+static ssize_t poll_max_bytes_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct xdma_cdev *xcdev = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			xcdev->engine->hybrid_poll_bytes);
+}
+
+static ssize_t poll_max_bytes_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct xdma_cdev *xcdev = dev_get_drvdata(dev);
+	unsigned int val;
+	int rv;
+
+	rv = kstrtouint(buf, 0, &val);
+	if (rv)
+		return rv;
+	WRITE_ONCE(xcdev->engine->hybrid_poll_bytes, val);
+	return count;
+}
+static DEVICE_ATTR_RW(poll_max_bytes);
+
+static struct attribute *xdma_engine_completion_attrs[] = {
+	&dev_attr_poll_us.attr,
+	&dev_attr_poll_max_bytes.attr,
+	NULL,
+};
+
+static const struct attribute_group xdma_engine_completion_group = {
+	.name = "completion",
+	.attrs = xdma_engine_completion_attrs,
+};
+
+static const struct attribute_group *xdma_engine_groups[] = {
+	&xdma_engine_stats_group,
+	&xdma_engine_completion_group,
+	NULL,
+};
+
 static int config_kobject(struct xdma_cdev *xcdev, enum cdev_type type)
 {
 	int rv = -EINVAL;
@@ -224,6 +367,7 @@ static int create_sys_device(struct xdma_cdev *xcdev, enum cdev_type type)
 {
 	struct xdma_dev *xdev = xcdev->xdev;
 	struct xdma_engine *engine = xcdev->engine;
+	const struct attribute_group **groups = NULL;
 	int last_param;
 
 	if (type == CHAR_EVENTS)
@@ -231,9 +375,13 @@ static int create_sys_device(struct xdma_cdev *xcdev, enum cdev_type type)
 	else
 		last_param = engine ? engine->channel : 0;
 
-	xcdev->sys_device = device_create(g_xdma_class, &xdev->pdev->dev,
-		xcdev->cdevno, NULL, devnode_names[type], xdev->idx,
-		last_param);
+	/* SG DMA engine nodes carry the engine statistics and policy */
+	if (type == CHAR_XDMA_H2C || type == CHAR_XDMA_C2H)
+		groups = xdma_engine_groups;
+
+	xcdev->sys_device = device_create_with_groups(g_xdma_class,
+		&xdev->pdev->dev, xcdev->cdevno, xcdev, groups,
+		devnode_names[type], xdev->idx, last_param);
 
 	if (!xcdev->sys_device) {
 		pr_err("device_create(%s) failed\n", devnode_names[type]);
@@ -287,6 +435,9 @@ static int create_xcdev(struct xdma_pci_dev *xpdev, struct xdma_cdev *xcdev,
 	dev_t dev;
 
 	spin_lock_init(&xcdev->lock);
+	mutex_init(&xcdev->pinned_lock);
+	mutex_init(&xcdev->wb_lock);
+	init_waitqueue_head(&xcdev->wb_wq);
 	/* new instance? */
 	if (!xpdev->major) {
 		/* allocate a dynamically allocated char device node */
@@ -619,11 +770,24 @@ int xdma_cdev_init(void)
 		return -ENOMEM;
 	}
 
+	/* per read/write page arrays and scatterlists */
+	io_cb_cache = kmem_cache_create("io_cb_cache",
+					sizeof(struct xdma_io_cb_mem), 0,
+					SLAB_HWCACHE_ALIGN, NULL);
+
+	if (!io_cb_cache) {
+		pr_info("memory allocation for io_cb_cache failed. OOM\n");
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
 void xdma_cdev_cleanup(void)
 {
+	if (io_cb_cache)
+		kmem_cache_destroy(io_cb_cache);
+
 	if (cdev_cache)
 		kmem_cache_destroy(cdev_cache);
 
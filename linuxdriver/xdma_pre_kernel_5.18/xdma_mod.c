@@ -362,10 +362,16 @@ static int xdma_mod_init(void)
 	pr_info("desc_blen_max: 0x%x/%u, timeout: h2c %u c2h %u sec.\n",
 		desc_blen_max, desc_blen_max, h2c_timeout, c2h_timeout);
 
-	rv = xdma_cdev_init();
+	rv = xdma_request_cache_init();
 	if (rv < 0)
 		return rv;
 
+	rv = xdma_cdev_init();
+	if (rv < 0) {
+		xdma_request_cache_cleanup();
+		return rv;
+	}
+
 	return pci_register_driver(&pci_driver);
 }
 
@@ -375,6 +381,7 @@ static void xdma_mod_exit(void)
 	dbg_init("pci_unregister_driver.\n");
 	pci_unregister_driver(&pci_driver);
 	xdma_cdev_cleanup();
+	xdma_request_cache_cleanup();
 }
 
 module_init(xdma_mod_init);
@@ -42,6 +42,7 @@
 #include "../common/saturnregisters.h"              // register I/O for Saturn
 #include "../common/codecwrite.h"                   // codec register I/O for Saturn
 #include "../common/version.h"                      // version I/O for Saturn
+#include "../common/ringbuffer.h"                   // mirrored ring buffer for DMA data
 
 
 int receivers = 1;                          // number of requested DDC (1-8)
@@ -466,9 +467,7 @@ void process_incoming_CandC(uint8_t *frame)
 uint32_t OutgoingCandCStep;                         // 0-1-2-3-4 sequence for C&C data
 #define VDMABUFFERSIZE 32768									      // memory buffer to reserve
 #define VALIGNMENT 4096                             // buffer alignment
-#define VBASE 0x1000									              // DMA start at 4K into buffer
 #define VMETISFRAMESIZE 1032
-#define VBASE 0x1000                                // offset into I/Q buffer for DMA to start
 #define VUSBSAMPLESIZE 504                          // useful data per USB Frame
 #define VDMATRANSFERSIZE 4096                       // read 4K at a time
 #define AXIBaseAddress 0x18000									    // address of StreamRead/Writer IP (Litefury only!)
@@ -531,15 +530,11 @@ void *SendOutgoingPacketData(void *arg)
 //
 // memory buffers
 //
-  uint8_t* IQReadBuffer = NULL;											// data for DMA read from DDC
-	uint32_t IQBufferSize = VDMABUFFERSIZE;
+  struct RingBuffer IQRing;                       // data for DMA read from DDC
   uint8_t* MicBuffer = NULL;											    // data for DMA read from Mic
 	uint32_t MicBufferSize = VDMABUFFERSIZE;
   bool InitError = false;                         // becomes true if we get an initialisation error
 	unsigned char* IQReadPtr;								        // pointer for reading out an I or Q sample
-	unsigned char* IQHeadPtr;								        // ptr to 1st free location in I/Q memory
-	unsigned char* IQBasePtr;								        // ptr to DMA location in I/Q memory
-	uint32_t ResidueBytes;
 	uint32_t Depth = 0;
 	int DMAReadfile_fd = -1;											// DMA read file device
 	uint32_t RegisterValue;
@@ -561,16 +556,11 @@ void *SendOutgoingPacketData(void *arg)
 //
   OutgoingCandCStep = 0;                                  // initialise C&C output
   printf("starting up outgoing thread\n");
-	posix_memalign((void **)&IQReadBuffer, VALIGNMENT, IQBufferSize);
-	if(!IQReadBuffer)
+	if(!RingBufferCreate(&IQRing, VDMABUFFERSIZE))
 	{
 		printf("I/Q read buffer allocation failed\n");
 		InitError = true;
 	}
-	IQReadPtr = IQReadBuffer + VBASE;							// offset 4096 bytes into buffer
-	IQHeadPtr = IQReadBuffer + VBASE;
-	IQBasePtr = IQReadBuffer + VBASE;
-  memset(IQReadBuffer, 0, IQBufferSize);
 
 
 	posix_memalign((void **)&MicBuffer, VALIGNMENT, MicBufferSize);
@@ -635,8 +625,9 @@ void *SendOutgoingPacketData(void *arg)
     //
     // while there is enough I/Q data, make Metis frames
     //
-    while((IQHeadPtr - IQReadPtr)>VIQBYTESPERMETISFRAME)
+    while(IQRing.Fill > VIQBYTESPERMETISFRAME)
     {
+      IQReadPtr = RingBufferReadPtr(&IQRing);
       *(uint32_t *)(UDPBuffer  + 4) = htonl(SequenceCounter++);     // add sequence count
       for(USBFrame=0; USBFrame < 2; USBFrame++)
       {
@@ -664,24 +655,16 @@ void *SendOutgoingPacketData(void *arg)
         memset(USBFramePtr, 0, 10);                                 // add 10 padding bytes
         USBFramePtr += 10;
       }
+      RingBufferConsume(&IQRing, IQReadPtr - RingBufferReadPtr(&IQRing));
       //
       // send outgoing packet
       //
       sendmsg(sock_ep2, &datagram, 0);
     }
     //
-    // now bring in more data via DMA
-    // first copy any residue to the start of the buffer (before the DMA point)
-//
-		ResidueBytes = IQHeadPtr- IQReadPtr;
-		printf("Residue = %d bytes\n",ResidueBytes);
-		if(ResidueBytes != 0)					// if there is residue
-		{
-			memcpy(IQBasePtr-ResidueBytes, IQReadPtr, ResidueBytes);
-			IQReadPtr = IQBasePtr-ResidueBytes;
-		}
-		else
-			IQReadPtr = IQBasePtr;
+    // now bring in more data via DMA. Any residue stays in the ring: the ring is
+    // mirrored, so the next frame is contiguous even if it crosses the end of the ring
+    //
 //
 // now wait until there is data, then DMA it
 //
@@ -694,9 +677,9 @@ void *SendOutgoingPacketData(void *arg)
 			printf("read: depth = %d\n", Depth);
 		}
 
-		printf("DMA read %d bytes from destination to base\n", VDMATRANSFERSIZE);
-		DMAReadFromFPGA(DMAReadfile_fd, IQBasePtr, VDMATRANSFERSIZE, AXIBaseAddress);
-		IQHeadPtr = IQBasePtr + VDMATRANSFERSIZE;
+		printf("DMA read %d bytes from destination to ring\n", VDMATRANSFERSIZE);
+		DMAReadFromFPGA(DMAReadfile_fd, RingBufferWritePtr(&IQRing), VDMATRANSFERSIZE, AXIBaseAddress);
+		RingBufferCommit(&IQRing, VDMATRANSFERSIZE);
   }     // end of while(!InitError) loop
 
 //
@@ -704,7 +687,7 @@ void *SendOutgoingPacketData(void *arg)
 //
   active_thread = 0;        // signal that thread has closed
 	close(DMAReadfile_fd);
-  free(IQReadBuffer);
+  RingBufferDestroy(&IQRing);
   free(MicBuffer);
   return NULL;
 }
@@ -39,12 +39,12 @@
 #include "serialport.h"
 #include "GanymedePAControl.h"
 #include "../common/version.h"
+#include "../common/capabilities.h"
 
 
 bool GanymedeActive;                                // true if Ganymede is operating
 bool GanymedeDetected;                              // true if Ganymede detected from CAT message
 bool GanymedeCATDetected = false;                   // true if Ganymede ZZZS ID message has been sent
-ESoftwareID FirmwareID;
 
 uint8_t GanymedeSWID;
 uint8_t GanymedeHWVersion;
@@ -140,7 +140,7 @@ void InitialiseGanymedeHandler(void)
             perror("pthread_create Ganymede tick");
         pthread_detach(GanymedeTickThread);
         MakeProductVersionCAT(P2APPVERSIONID, 1, GetP2appVersion(), GanymedeData.DeviceHandle);
-        MakeProductVersionCAT(G2FIRMWAREVERSIONID, GetPCBVersionNumber(), GetFirmwareVersion(&FirmwareID), GanymedeData.DeviceHandle);
+        MakeProductVersionCAT(G2FIRMWAREVERSIONID, GetCapabilities()->PCBVersion, GetCapabilities()->FirmwareVersion, GanymedeData.DeviceHandle);
 
     }
     else
@@ -14,6 +14,7 @@
 //////////////////////////////////////////////////////////////
 
 #include "threaddata.h"
+#include "udpreceive.h"
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "InDUCIQ.h"
@@ -27,6 +28,7 @@
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
 #include "../common/hwaccess.h"
+#include "../common/byteio.h"
 #include <pthread.h>
 #include <syscall.h>
 
@@ -36,46 +38,228 @@
 #define VIQSAMPLESPERFRAME 240                      // samples per UDP frame
 #define VMEMWORDSPERFRAME 180                       // memory writes per UDP frame
 #define VBYTESPERSAMPLE 6							// 24 bit + 24 bit samples
-#define VDMABUFFERSIZE 32768						// memory buffer to reserve
 #define VALIGNMENT 4096                             // buffer alignment
 #define VBASE 0x1000								// DMA start at 4K into buffer
-#define VDMATRANSFERSIZE 1440                       // write 1 message at a time
+#define VDMATRANSFERSIZE 1440                       // DMA bytes per message
+#define VJITTERSLOTS 64                             // jitter buffer messages (power of 2): 80ms
+#define VDMABUFFERSIZE (VBASE + VJITTERSLOTS*VDMATRANSFERSIZE)   // memory buffer to reserve
+#define VFRAMEUS 1250                               // duration of 1 message at 192KHz (us)
+#define VMAXDUCBATCH 16                             // max messages in 1 DMA write
+#define VMINREORDERFRAMES 4                         // reorder wait if no target depth set
+#define VCONCEALFIFOFRAMES 2                        // conceal a missing message if FIFO holds less than this
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
+#define VWRITEBEHINDSIZE 65536                      // driver write-behind ring: ~55ms of TX I/Q
+#define VWRITEBEHINDMAXDMA 8192                     // largest write-behind DMA
+
+
+//
+// TX jitter buffer.
+// each message is written, I/Q swapped, into slot (sequence number % VJITTERSLOTS) of the DMA
+// buffer, so messages arriving out of order are put back in order. The slots from NextSeq
+// on are DMA written to the FIFO, several at a time straight from the buffer, as FIFO space allows.
+// a missing message is waited for until the FIFO is nearly empty or the reorder depth is
+// reached, then replaced by a repeat of the message before it (or by silence if there is
+// no message before it in this run). The message before it is kept in DUCJitterLastSent
+// because its slot is also the slot for the message VJITTERSLOTS-1 later, which may have arrived.
+// with a target depth set, the FIFO is only filled up to that depth (rather than completely)
+// so TX latency is about the target; after an underflow, output restarts once the target
+// depth has been received again.
+//
+uint32_t DUCJitterTarget = 0;                           // target depth in ms; 0 = FIFO kept full
+uint32_t DUCJitterNextSeq;                              // sequence number of next message to DMA
+uint32_t DUCJitterHighestSeq;                           // highest sequence number received
+bool DUCJitterValid[VJITTERSLOTS];                      // true if slot holds a message not yet sent
+bool DUCJitterPrimed;                                   // true once target depth reached
+bool DUCJitterHavePrevious;                             // true if DUCJitterLastSent holds a message of this run
+uint8_t DUCJitterLastSent[VDMATRANSFERSIZE];            // copy of the message before NextSeq
+uint32_t DUCLateMessages;                               // messages arrived after their slot was sent
+uint32_t DUCConcealedMessages;                          // missing messages replaced
+uint32_t DUCTrimmedMessages;                            // messages dropped because the buffer was full
+
+
+//
+// empty the jitter buffer, ready for messages starting at sequence number Seq
+//
+static void DUCJitterReset(uint32_t Seq)
+{
+    memset(DUCJitterValid, 0, sizeof(DUCJitterValid));
+    DUCJitterNextSeq = Seq;
+    DUCJitterHighestSeq = Seq - 1;
+    DUCJitterPrimed = false;
+    DUCJitterHavePrevious = false;
+}
+
+
+//
+// number of slots from the next to send to the highest received (some may be missing)
+//
+static uint32_t DUCJitterSpan(void)
+{
+    int32_t Span;
+
+    Span = (int32_t)(DUCJitterHighestSeq - DUCJitterNextSeq) + 1;
+    return (Span > 0) ? (uint32_t)Span : 0;
+}
+
+
+//
+// add a received message to the jitter buffer
+// IQBasePtr: slot 0 of the DMA buffer
+//
+static void DUCJitterInsert(uint8_t* UDPInBuffer, uint8_t* IQBasePtr)
+{
+    uint32_t Seq;
+    int32_t Offset;                                         // slots after the next to send
+    uint32_t Slot;
+    uint32_t Cntr;
+    uint8_t* SrcPtr;                                        // pointer to data from Thetis
+    uint8_t* DestPtr;                                       // pointer to DMA buffer data
+
+    Seq = rd_be_u32(UDPInBuffer);
+    Offset = (int32_t)(Seq - DUCJitterNextSeq);
+    if((Offset < -VJITTERSLOTS) || (Offset >= 2 * VJITTERSLOTS))      // sequence restarted
+    {
+        DUCJitterReset(Seq);
+        Offset = 0;
+    }
+    else if(Offset < 0)                                     // too late: slot already sent
+    {
+        DUCLateMessages++;
+        return;
+    }
+    while(Offset >= VJITTERSLOTS)                           // no free slot: drop the oldest
+    {
+        Slot = DUCJitterNextSeq & (VJITTERSLOTS - 1);
+        if(DUCJitterValid[Slot])
+        {
+            DUCTrimmedMessages++;
+            memcpy(DUCJitterLastSent, IQBasePtr + Slot * VDMATRANSFERSIZE, VDMATRANSFERSIZE);
+        }
+        DUCJitterHavePrevious = DUCJitterValid[Slot];
+        DUCJitterValid[Slot] = false;
+        DUCJitterNextSeq++;
+        Offset--;
+    }
+    Slot = Seq & (VJITTERSLOTS - 1);
+    if(DUCJitterValid[Slot])                                // duplicate
+        return;
+    if((int32_t)(Seq - DUCJitterHighestSeq) > 0)
+        DUCJitterHighestSeq = Seq;
+
+    // need to swap I & Q samples on replay
+    SrcPtr = (uint8_t *) (UDPInBuffer + 4);
+    DestPtr = IQBasePtr + Slot * VDMATRANSFERSIZE;
+    for (Cntr=0; Cntr < VIQSAMPLESPERFRAME; Cntr++)         // samplecounter
+    {
+        *DestPtr++ = *(SrcPtr+3);                           // get I sample (3 bytes)
+        *DestPtr++ = *(SrcPtr+4);
+        *DestPtr++ = *(SrcPtr+5);
+        *DestPtr++ = *(SrcPtr+0);                           // get Q sample (3 bytes)
+        *DestPtr++ = *(SrcPtr+1);
+        *DestPtr++ = *(SrcPtr+2);
+        SrcPtr += 6;                                        // point at next source sample
+    }
+    DUCJitterValid[Slot] = true;
+}
+
+
+//
+// DMA write up to MaxMessages in-order messages from the jitter buffer
+// consecutive slots go in one DMA write; the buffer wrap splits it in two.
+// a missing message is replaced by the one before it (or silence) if Conceal, else output stops there.
+// returns the number of messages written
+//
+static uint32_t DUCJitterDrain(int fd, uint8_t* IQBasePtr, uint32_t MaxMessages, bool Conceal)
+{
+    uint32_t Written = 0;
+    uint32_t Slot, StartSlot;
+    uint32_t Count = 0;                                     // messages in current DMA
+
+    StartSlot = DUCJitterNextSeq & (VJITTERSLOTS - 1);
+    while((Written + Count < MaxMessages) && (DUCJitterSpan() != 0))
+    {
+        Slot = DUCJitterNextSeq & (VJITTERSLOTS - 1);
+        if(!DUCJitterValid[Slot])
+        {
+            if(!Conceal)
+                break;
+            if(Written + Count != 0)                        // previous slot sent in this call: still holds it
+                memcpy(IQBasePtr + Slot * VDMATRANSFERSIZE,
+                       IQBasePtr + ((Slot - 1) & (VJITTERSLOTS - 1)) * VDMATRANSFERSIZE, VDMATRANSFERSIZE);
+            else if(DUCJitterHavePrevious)
+                memcpy(IQBasePtr + Slot * VDMATRANSFERSIZE, DUCJitterLastSent, VDMATRANSFERSIZE);
+            else
+                memset(IQBasePtr + Slot * VDMATRANSFERSIZE, 0, VDMATRANSFERSIZE);
+            DUCConcealedMessages++;
+        }
+        DUCJitterHavePrevious = true;
+        DUCJitterValid[Slot] = false;
+        DUCJitterNextSeq++;
+        Count++;
+        if(Slot == VJITTERSLOTS - 1)                        // end of buffer: write what we have
+        {
+            DMAWriteToFPGA(fd, IQBasePtr + StartSlot * VDMATRANSFERSIZE, Count * VDMATRANSFERSIZE, VADDRDUCSTREAMWRITE);
+            Written += Count;
+            Count = 0;
+            StartSlot = 0;
+        }
+    }
+    if(Count != 0)
+    {
+        DMAWriteToFPGA(fd, IQBasePtr + StartSlot * VDMATRANSFERSIZE, Count * VDMATRANSFERSIZE, VADDRDUCSTREAMWRITE);
+        Written += Count;
+    }
+    if(Written != 0)                                        // keep the last message sent, before its slot is reused
+        memcpy(DUCJitterLastSent, IQBasePtr + ((DUCJitterNextSeq - 1) & (VJITTERSLOTS - 1)) * VDMATRANSFERSIZE, VDMATRANSFERSIZE);
+    return Written;
+}
+
 
 //
 // listener thread for incoming DUC I/Q packets
-// planned strategy: just DMA spkr data when available; don't copy and DMA a larger amount.
-// if sufficient FIFO data available: DMA that data and transfer it out. 
-// if it turns out to be too inefficient, we'll have to try larger DMA.
+// each burst of messages goes into the jitter buffer in one receive call; then as many as
+// the FIFO has space for are DMA written to it. While messages are waiting for FIFO space
+// the receive wait is limited to 1ms so the FIFO is checked again; otherwise it is unlimited.
 //
 void *IncomingDUCIQ(void *arg)                          // listener thread
 {
     struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-    struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-    uint8_t UDPInBuffer[VDUCIQSIZE];                      // incoming buffer
-    struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-    struct msghdr datagram;                               // multiple incoming message header
-    int size;                                             // UDP datagram length
+    struct UDPReceiveBatch Batch;                         // received messages
+    int Count;                                            // messages received
+    int Msg;                                              // message counter
 
                                                           //
 // variables for DMA buffer 
 //
     uint8_t* IQWriteBuffer = NULL;							// data for DMA to write to DUC
     uint32_t IQBufferSize = VDMABUFFERSIZE;
-    unsigned char* IQBasePtr;								// ptr to DMA location in I/Q memory
+    unsigned char* IQBasePtr;								// ptr to jitter buffer slot 0 in I/Q memory
     uint32_t Depth = 0;
+    uint32_t TargetMessages;                                // target depth in messages; 0 = none
+    uint32_t ReorderMessages;                               // slots a missing message is waited for
+    uint32_t FIFOMessages;                                  // messages held in the FIFO
+    uint32_t MaxMessages;                                   // messages that can be written now
+    bool Conceal;
+    bool Started = false;                                   // true once 1st message of a run received
     int DMAWritefile_fd = -1;								// DMA read file device
+    bool WriteBehind = false;                               // true if DMA writes are queued in the driver
     bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
-    uint32_t Cntr;                                          // sample counter
-    uint8_t* SrcPtr;                                        // pointer to data from Thetis
-    uint8_t* DestPtr;                                       // pointer to DMA buffer data
     unsigned int Current;                                   // current occupied locations in FIFO
     unsigned int StartupCount;                              // used to delay reporting of under & overflows
-    bool PrevSDRActive = false;                             // used to detect change of state
+    uint32_t RunCount = 0;                                  // SDRRunCount when last checked: detects a new run
 
     ThreadData = (struct ThreadSocketData *)arg;
     ThreadData->Active = true;
     printf("spinning up DUC I/Q thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
+    if(!UDPBatchCreate(&Batch, VDUCIQSIZE, VMAXUDPBATCH))
+    {
+        printf("TX I/Q receive buffer allocation failed\n");
+        return NULL;
+    }
+    TargetMessages = (DUCJitterTarget * 1000 + VFRAMEUS - 1) / VFRAMEUS;
+    ReorderMessages = (TargetMessages != 0) ? TargetMessages : VMINREORDERFRAMES;
+    if(TargetMessages != 0)
+        printf("TX jitter buffer target depth = %d messages\n", TargetMessages);
   
     //
     // setup DMA buffer
@@ -93,6 +277,20 @@ void *IncomingDUCIQ(void *arg)                          // listener thread
     DMAWritefile_fd = open(VDUCDMADEVICE, O_WRONLY);
     if (DMAWritefile_fd < 0)
         printf("XDMA write device open failed for TX I/Q data\n");
+    //
+    // write-behind data queued in the driver doesn't show in the FIFO depth,
+    // so it can't be used with a jitter buffer target depth
+    //
+    else if (UseWriteBehind && (TargetMessages == 0) && (DMAWriteBehindStart(DMAWritefile_fd, VADDRDUCSTREAMWRITE, VWRITEBEHINDSIZE, VWRITEBEHINDMAXDMA) == 0))
+        WriteBehind = true;
+    else
+    {
+        if (UseWriteBehind && (TargetMessages != 0))
+            printf("TX jitter buffer target set; TX DMA writes not queued\n");
+        else if (UseWriteBehind)
+            printf("XDMA driver write-behind not available; TX DMA writes not queued\n");
+        DMARegisterBuffer(DMAWritefile_fd, IQWriteBuffer, IQBufferSize);     // pin once, not per write
+    }
         
 //
 // setup hardware
@@ -109,78 +307,99 @@ void *IncomingDUCIQ(void *arg)                          // listener thread
   //
     while(1)
     {
-        if(SDRActive & !PrevSDRActive)                      // detect SDRActive has been asserted
-            StartupCount = VSTARTUPDELAY;
-        PrevSDRActive = SDRActive;
-
-        memset(&iovecinst, 0, sizeof(struct iovec));
-        memset(&datagram, 0, sizeof(datagram));
-        iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-        iovecinst.iov_len = VDUCIQSIZE;
-        datagram.msg_iov = &iovecinst;
-        datagram.msg_iovlen = 1;
-        datagram.msg_name = &addr_from;
-        datagram.msg_namelen = sizeof(addr_from);
-        size = recvmsg(ThreadData->Socketid, &datagram, 0);         // get one message. If it times out, ges size=-1
-        if(size < 0 && errno != EAGAIN)
+        Count = UDPBatchReceive(&Batch, ThreadData->Socketid, (Started && ((DUCJitterSpan() != 0) || DUCJitterPrimed)) ? 1 : -1);
+        if(Count < 0)
         {
             perror("recvfrom fail, TX I/Q data");
-            return NULL;
+            break;
+        }
+        //
+        // the wait may have no timeout, so a new run is found from the run count, not by seeing SDRActive change
+        //
+        if(__atomic_load_n(&SDRRunCount, __ATOMIC_ACQUIRE) != RunCount)     // a new run has started
+        {
+            StartupCount = VSTARTUPDELAY;
+            Started = false;                                // sequence restarts at 0
+            RunCount = __atomic_load_n(&SDRRunCount, __ATOMIC_ACQUIRE);
         }
-        if(size == VDUCIQSIZE)
+
+        for(Msg = 0; Msg < Count; Msg++)
         {
+            if(UDPBatchLength(&Batch, Msg) != VDUCIQSIZE)
+                continue;
             if(StartupCount != 0)                                   // decrement startup message count
                 StartupCount--;
             NewMessageReceived = true;
-            Depth = ReadFIFOMonitorChannel(eTXDUCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);           // read the FIFO free locations
-            if((StartupCount == 0) && FIFOOverThreshold && UseDebug)
-                printf("TX DUC FIFO Overthreshold, depth now = %d\n", Current);
-
-            if((StartupCount == 0) && FIFOUnderflow)
+            if(!Started)
             {
-                pthread_mutex_lock(&g_fifo_overflow_mutex);
-                GlobalFIFOOverflows |= 0b00000100;
-                pthread_mutex_unlock(&g_fifo_overflow_mutex);
-                if(UseDebug)
-                    printf("TX DUC FIFO Underflowed, depth now = %d\n", Current);
+                DUCJitterReset(rd_be_u32(UDPBatchData(&Batch, Msg)));
+                Started = true;
             }
+            DUCJitterInsert(UDPBatchData(&Batch, Msg), IQBasePtr);
+        }
 
-            while (Depth < VMEMWORDSPERFRAME)       // loop till space available
-            {
-                usleep(500);								                    // 0.5ms wait
-                Depth = ReadFIFOMonitorChannel(eTXDUCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);       // read the FIFO free locations
-                if((StartupCount == 0) && FIFOOverThreshold && UseDebug)
-                    printf("TX DUC FIFO Overthreshold, depth now = %d\n", Current);
-                if((StartupCount == 0) && FIFOUnderflow)
-                {
-                    pthread_mutex_lock(&g_fifo_overflow_mutex);
-                    GlobalFIFOOverflows |= 0b00000100;
-                    pthread_mutex_unlock(&g_fifo_overflow_mutex);
-                    if(UseDebug)
-                        printf("TX DUC FIFO Underflowed, depth now = %d\n", Current);
-                }
-            }
-            // copy data from UDP Buffer & DMA write it
-//            memcpy(IQBasePtr, UDPInBuffer + 4, VDMATRANSFERSIZE);                // copy out I/Q samples
-            // need to swap I & Q samples on replay
-            SrcPtr = (uint8_t *) (UDPInBuffer + 4);
-            DestPtr = (uint8_t *) IQBasePtr;
-            for (Cntr=0; Cntr < VIQSAMPLESPERFRAME; Cntr++)                     // samplecounter
+        //
+        // nothing to do unless messages are waiting, or output is running and may have underflowed
+        //
+        if(!Started || ((DUCJitterSpan() == 0) && !DUCJitterPrimed))
+            continue;
+        Depth = ReadFIFOMonitorChannel(eTXDUCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);           // read the FIFO free locations
+        if((StartupCount == 0) && FIFOOverThreshold && UseDebug)
+            printf("TX DUC FIFO Overthreshold, depth now = %d\n", Current);
+
+        if((StartupCount == 0) && FIFOUnderflow)
+        {
+            pthread_mutex_lock(&g_fifo_overflow_mutex);
+            GlobalFIFOOverflows |= 0b00000100;
+            pthread_mutex_unlock(&g_fifo_overflow_mutex);
+            if(UseDebug)
+                printf("TX DUC FIFO Underflowed, depth now = %d\n", Current);
+        }
+        FIFOMessages = Current / VMEMWORDSPERFRAME;
+        if(DUCJitterSpan() == 0)                            // nothing to send
+        {
+            if(FIFOMessages == 0)                           // and FIFO ran dry: rebuild target depth
             {
-                *DestPtr++ = *(SrcPtr+3);                           // get I sample (3 bytes)
-                *DestPtr++ = *(SrcPtr+4);
-                *DestPtr++ = *(SrcPtr+5);
-                *DestPtr++ = *(SrcPtr+0);                           // get Q sample (3 bytes)
-                *DestPtr++ = *(SrcPtr+1);
-                *DestPtr++ = *(SrcPtr+2);
-                SrcPtr += 6;                                        // point at next source sample
+                DUCJitterPrimed = false;
+                if(UseDebug && (TargetMessages != 0))
+                    printf("TX jitter buffer empty: late=%d, concealed=%d, trimmed=%d\n",
+                           DUCLateMessages, DUCConcealedMessages, DUCTrimmedMessages);
             }
-            DMAWriteToFPGA(DMAWritefile_fd, IQBasePtr, VDMATRANSFERSIZE, VADDRDUCSTREAMWRITE);
+            continue;
+        }
+        if(!DUCJitterPrimed)
+        {
+            if(DUCJitterSpan() < TargetMessages)
+                continue;
+            DUCJitterPrimed = true;
+        }
+
+        //
+        // write as many as fit in the FIFO (and, with a target depth, keep the FIFO to that depth).
+        // with write-behind, the driver waits for FIFO space, not this thread; the FIFO depth
+        // then leaves out data queued in the driver, so isn't used to decide on concealment
+        //
+        MaxMessages = WriteBehind ? VMAXDUCBATCH : (Depth / VMEMWORDSPERFRAME);
+        if(TargetMessages != 0)
+        {
+            if(FIFOMessages >= TargetMessages)
+                MaxMessages = 0;
+            else if(MaxMessages > TargetMessages - FIFOMessages)
+                MaxMessages = TargetMessages - FIFOMessages;
         }
+        if(MaxMessages > VMAXDUCBATCH)
+            MaxMessages = VMAXDUCBATCH;
+        Conceal = (!WriteBehind && (FIFOMessages < VCONCEALFIFOFRAMES)) || (DUCJitterSpan() > ReorderMessages);
+        if(MaxMessages != 0)
+            DUCJitterDrain(DMAWritefile_fd, IQBasePtr, MaxMessages, Conceal);
     }
 //
 // close down thread
 //
+    if(WriteBehind)
+        DMAWriteBehindStop(DMAWritefile_fd);
+    else
+        DMAUnregisterBuffer(DMAWritefile_fd, IQWriteBuffer);
     close(ThreadData->Socketid);                  // close incoming data socket
     ThreadData->Socketid = 0;
     ThreadData->Active = false;                   // indicate it is closed
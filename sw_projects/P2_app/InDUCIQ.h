@@ -25,6 +25,9 @@
 #define VDUCIQSIZE 1444                 // TX DUC I/Q data packet
 
 
+extern uint32_t DUCJitterTarget;        // TX jitter buffer target depth in ms, 0 = FIFO kept full (-j option)
+
+
 //
 // protocol 2 handler for incoming DUC I/Q data Packet to SDR
 //
@@ -14,6 +14,7 @@
 //////////////////////////////////////////////////////////////
 
 #include "threaddata.h"
+#include "udpreceive.h"
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "InHighPriority.h"
@@ -24,6 +25,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "../common/saturnregisters.h"
+#include "../common/regshadow.h"
+#include "../common/capabilities.h"
 #include "../common/hwaccess.h"                   // low level access
 #include "../common/version.h"
 #include "../common/byteio.h"
@@ -39,56 +42,45 @@ extern bool InterleavedDDCDebugMode;                    // true if interleaved D
 
 
 //
-// listener thread for incoming high priority packets
+// control reactor handler for incoming high priority packets
+// called when the socket is readable: processes every message queued on it
 //
-void *IncomingHighPriority(void *arg)                   // listener thread
+void IncomingHighPriority(int Socketid, __attribute__((unused)) uint32_t Events, __attribute__((unused)) void *arg)
 {
-  struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-  struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-  uint8_t UDPInBuffer[VHIGHPRIOTIYTOSDRSIZE];           // incoming buffer
-  struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-  struct msghdr datagram;                               // multiple incoming message header
+  uint8_t* UDPInBuffer;                                 // incoming message, in Batch
+  static struct UDPReceiveBatch Batch;                  // received messages
   int size;                                             // UDP datagram length
   bool RunBit;                                          // true if "run" bit set
   uint8_t Byte, Byte2;                                  // received dat being decoded
   uint32_t LongWord;
   uint16_t Word;
   int i;                                                // counter
-  ESoftwareID FPGASWID;                                 // preprod/release etc
-  unsigned int FPGAVersion;                             // firmware version
+  bool HasAlexTXAntRegister;                            // true if FPGA has separate Alex TX ant register
 
 
-  ThreadData = (struct ThreadSocketData *)arg;
-  ThreadData->Active = true;
-  printf("spinning up high priority incoming thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
-  FPGAVersion = GetFirmwareVersion(&FPGASWID);          // get version of FPGA code
+  if((Batch.Buffer == NULL) && !UDPBatchCreate(&Batch, VHIGHPRIOTIYTOSDRSIZE, 8))
+  {
+    printf("high priority receive buffer allocation failed\n");
+    return;
+  }
+  HasAlexTXAntRegister = GetCapabilities()->HasAlexTXAntRegister;
 
   //
-  // main processing loop
+  // process each message waiting
   //
-  while(1)
+  while((size = UDPBatchNext(&Batch, Socketid, 0, &UDPInBuffer)) >= 0)
   {
-    memset(&iovecinst, 0, sizeof(struct iovec));
-    memset(&datagram, 0, sizeof(datagram));
-    iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-    iovecinst.iov_len = VHIGHPRIOTIYTOSDRSIZE;
-    datagram.msg_iov = &iovecinst;
-    datagram.msg_iovlen = 1;
-    datagram.msg_name = &addr_from;
-    datagram.msg_namelen = sizeof(addr_from);
-    size = recvmsg(ThreadData->Socketid, &datagram, 0);         // get one message. If it times out, ges size=-1
-    if(size < 0 && errno != EAGAIN)
-    {
-      perror("recvfrom, high priority");
-      printf("error number = %d\n", errno);
-      EXIT_FAILURE;
-    }
 
     //
     // if correct packet, process it
     //
     if(size == VHIGHPRIOTIYTOSDRSIZE)
     {
+      //
+      // the setters below only update the register shadow; the registers
+      // that have actually changed are written together at the end of the packet
+      //
+      ShadowBeginUpdate();
       NewMessageReceived = true;
       LongWord = rd_be_u32(UDPInBuffer);
       printf("high priority packet received\n");
@@ -99,6 +91,8 @@ void *IncomingHighPriority(void *arg)                   // listener thread
         StartBitReceived = true;
         if(ReplyAddressSet && StartBitReceived)
         {
+          if(!SDRActive)                                          // a new run
+              __atomic_add_fetch(&SDRRunCount, 1, __ATOMIC_RELEASE);
           SDRActive = true;                                       // only set active if we have replay address too
           SetTXEnable(true);
         }
@@ -171,7 +165,7 @@ void *IncomingHighPriority(void *arg)                   // listener thread
       //printf("Alex 1 TX word = 0x%x\n", Word);
       Word = (Word >> 8) & 0x0007;                          // new data TX ant bits. if not set, must be legacy client app
       
-      if((FPGAVersion >= 12) && (Word != 0))                // if new firmware && client app supports it
+      if(HasAlexTXAntRegister && (Word != 0))               // if new firmware && client app supports it
       {
         //printf("new FPGA code, new client data\n");
         Word = rd_be_u16(UDPInBuffer+1428);                 // copy word with TX ant settings to filt/TXant register
@@ -186,7 +180,7 @@ void *IncomingHighPriority(void *arg)                   // listener thread
           Word = (Word & 0xF8FF) | 0x0100;
         AlexManualTXFilters(Word, false);
       }
-      else if(FPGAVersion >= 12)                            // new hardware but no client app support
+      else if(HasAlexTXAntRegister)                         // new hardware but no client app support
       {
         //printf("new FPGA code, new client data\n");
         Word = rd_be_u16(UDPInBuffer+1432);                 // copy word with TX/RX ant settings to both registers
@@ -220,15 +214,11 @@ void *IncomingHighPriority(void *arg)                   // listener thread
       //
       Byte = (uint8_t)(UDPInBuffer[5]);      // CWX
       SetCWXBits((bool)(Byte & 1), (bool)((Byte>>2) & 1), (bool)((Byte>>1) & 1));    // enabled, dash, dot
+      ShadowEndUpdate();                                  // write changed registers
     }
   }
-//
-// close down thread
-//
-  close(ThreadData->Socketid);                  // close incoming data socket
-  ThreadData->Socketid = 0;
-  ThreadData->Active = false;                   // indicate it is closed
-  return NULL;
+  if(errno != EAGAIN)
+    perror("recvfrom, high priority");
 }
 
 
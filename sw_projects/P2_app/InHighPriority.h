@@ -29,7 +29,7 @@
 //
 // protocol 2 handler for incoming high priority Packet to SDR
 //
-void *IncomingHighPriority(void *arg);          // listener thread
+void IncomingHighPriority(int Socketid, uint32_t Events, void *arg);     // control reactor handler: socket readable
 
 
 #endif
\ No newline at end of file
@@ -14,6 +14,7 @@
 //////////////////////////////////////////////////////////////
 
 #include "threaddata.h"
+#include "udpreceive.h"
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "InSpkrAudio.h"
@@ -39,6 +40,8 @@
 #define VBASE 0x1000								// DMA start at 4K into buffer
 #define VDMATRANSFERSIZE 256                        // write 1 message at a time
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
+#define VWRITEBEHINDSIZE 16384                      // driver write-behind ring: ~85ms of speaker audio
+#define VWRITEBEHINDMAXDMA 2048                     // largest write-behind DMA
 
 
 //
@@ -50,10 +53,8 @@
 void *IncomingSpkrAudio(void *arg)                      // listener thread
 {
     struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-    struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-    uint8_t UDPInBuffer[VSPEAKERAUDIOSIZE];               // incoming buffer
-    struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-    struct msghdr datagram;                               // multiple incoming message header
+    uint8_t* UDPInBuffer;                                 // incoming message, in Batch
+    struct UDPReceiveBatch Batch;                         // received messages
     int size;                                             // UDP datagram length
 
 //
@@ -64,16 +65,22 @@ void *IncomingSpkrAudio(void *arg)                      // listener thread
     unsigned char* SpkBasePtr;								// ptr to DMA location in spk memory
     uint32_t Depth = 0;
     int DMAWritefile_fd = -1;								// DMA read file device
+    bool WriteBehind = false;                               // true if DMA writes are queued in the driver
     bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
     uint32_t RegVal;
     unsigned int Current;                                   // current occupied locations in FIFO
     unsigned int StartupCount;                              // used to delay reporting of under & overflows
-    bool PrevSDRActive = false;                             // used to detect change of state
+    uint32_t RunCount = 0;                                  // SDRRunCount when last checked: detects a new run
 
 
     ThreadData = (struct ThreadSocketData *)arg;
     ThreadData->Active = true;
     printf("spinning up speaker audio thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
+    if(!UDPBatchCreate(&Batch, VSPEAKERAUDIOSIZE, 16))
+    {
+        printf("speaker audio receive buffer allocation failed\n");
+        return NULL;
+    }
 
     //
     // setup DMA buffer
@@ -91,6 +98,10 @@ void *IncomingSpkrAudio(void *arg)                      // listener thread
     DMAWritefile_fd = open(VSPKDMADEVICE, O_WRONLY);
     if (DMAWritefile_fd < 0)
         printf("XDMA write device open failed for spk data\n");
+    else if (UseWriteBehind && (DMAWriteBehindStart(DMAWritefile_fd, VADDRSPKRSTREAMWRITE, VWRITEBEHINDSIZE, VWRITEBEHINDMAXDMA) == 0))
+        WriteBehind = true;
+    else
+        DMARegisterBuffer(DMAWritefile_fd, SpkWriteBuffer, SpkBufferSize);   // pin once, not per write
     ResetDMAStreamFIFO(eSpkCodecDMA);
     SetupFIFOMonitorChannel(eSpkCodecDMA, false);
 
@@ -103,27 +114,22 @@ void *IncomingSpkrAudio(void *arg)                      // listener thread
         //
         // now released to start processing. Setup buffers.
         //
-        if(SDRActive & !PrevSDRActive)                      // detect SDRActive has been asserted
-            StartupCount = VSTARTUPDELAY;
-        PrevSDRActive = SDRActive;
-
-        memset(&iovecinst, 0, sizeof(struct iovec));            // clear buffers
-        memset(&datagram, 0, sizeof(datagram));
-        iovecinst.iov_base = &UDPInBuffer;                      // set buffer for incoming message number i
-        iovecinst.iov_len = VSPEAKERAUDIOSIZE;
-        datagram.msg_iov = &iovecinst;
-        datagram.msg_iovlen = 1;
-        datagram.msg_name = &addr_from;
-        datagram.msg_namelen = sizeof(addr_from);
-        //
-        // receive operation thread
-        //
-        size = recvmsg(ThreadData->Socketid, &datagram, 0);     // get one message. If it times out, sets size=-1
+        size = UDPBatchNext(&Batch, ThreadData->Socketid, -1, &UDPInBuffer);     // get next message; waits for one to arrive
         if(size < 0 && errno != EAGAIN)
         {
             perror("recvfrom fail, Speaker data");
-            return NULL;
+            break;
         }
+        //
+        // checked after the receive, as the wait may have spanned the start of a run.
+        // the wait has no timeout, so a new run is found from the run count, not by seeing SDRActive change
+        //
+        if(__atomic_load_n(&SDRRunCount, __ATOMIC_ACQUIRE) != RunCount)     // a new run has started
+        {
+            StartupCount = VSTARTUPDELAY;
+            RunCount = __atomic_load_n(&SDRRunCount, __ATOMIC_ACQUIRE);
+        }
+
         if(size == VSPEAKERAUDIOSIZE)                           // we have received a packet!
         {
             if(StartupCount != 0)                                   // decrement startup message count
@@ -142,7 +148,7 @@ void *IncomingSpkrAudio(void *arg)                      // listener thread
                     printf("Codec speaker FIFO Underflowed, depth now = %d\n", Current);
             }
     //            printf("speaker packet received; depth = %d\n", Depth);
-            while (Depth < VMEMWORDSPERFRAME)       // loop till space available
+            while (!WriteBehind && (Depth < VMEMWORDSPERFRAME))       // loop till space available; else the driver waits
             {
                 usleep(1000);								                    // 1ms wait
                 Depth = ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);    // read the FIFO free locations
@@ -167,6 +173,10 @@ void *IncomingSpkrAudio(void *arg)                      // listener thread
 //
 // close down thread
 //
+    if(WriteBehind)
+        DMAWriteBehindStop(DMAWritefile_fd);
+    else
+        DMAUnregisterBuffer(DMAWritefile_fd, SpkWriteBuffer);
     close(ThreadData->Socketid);                  // close incoming data socket
     ThreadData->Socketid = 0;
     ThreadData->Active = false;                   // indicate it is closed
@@ -15,6 +15,7 @@
 
 
 #include "threaddata.h"
+#include "udpreceive.h"
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "IncomingDDCSpecific.h"
@@ -34,15 +35,13 @@
 
 
 //
-// listener thread for incoming DDC specific packets
+// control reactor handler for incoming DDC specific packets
+// called when the socket is readable: processes every message queued on it
 //
-void *IncomingDDCSpecific(void *arg)                    // listener thread
+void IncomingDDCSpecific(int Socketid, __attribute__((unused)) uint32_t Events, __attribute__((unused)) void *arg)
 {
-  struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-  struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-  uint8_t UDPInBuffer[VDDCSPECIFICSIZE];                // incoming buffer
-  struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-  struct msghdr datagram;                               // multiple incoming message header
+  uint8_t* UDPInBuffer;                                 // incoming message, in Batch
+  static struct UDPReceiveBatch Batch;                  // received messages
   int size;                                             // UDP datagram length
   uint8_t Byte1, Byte2;                                 // received data
   bool Dither, Random;                                  // ADC bits
@@ -51,28 +50,16 @@ void *IncomingDDCSpecific(void *arg)                    // listener thread
   int i;                                                // counter
   EADCSelect ADC = eADC1;                               // ADC to use for a DDC
 
-  ThreadData = (struct ThreadSocketData *)arg;
-  ThreadData->Active = true;
-  printf("spinning up DDC specific thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
+  if((Batch.Buffer == NULL) && !UDPBatchCreate(&Batch, VDDCSPECIFICSIZE, 8))
+  {
+    printf("DDC specific receive buffer allocation failed\n");
+    return;
+  }
   //
-  // main processing loop
+  // process each message waiting
   //
-  while(1)
+  while((size = UDPBatchNext(&Batch, Socketid, 0, &UDPInBuffer)) >= 0)
   {
-    memset(&iovecinst, 0, sizeof(struct iovec));
-    memset(&datagram, 0, sizeof(datagram));
-    iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-    iovecinst.iov_len = VDDCSPECIFICSIZE;
-    datagram.msg_iov = &iovecinst;
-    datagram.msg_iovlen = 1;
-    datagram.msg_name = &addr_from;
-    datagram.msg_namelen = sizeof(addr_from);
-    size = recvmsg(ThreadData->Socketid, &datagram, 0);         // get one message. If it times out, ges size=-1
-    if(size < 0 && errno != EAGAIN)
-    {
-      perror("recvfrom, DDC Specific");
-      return NULL;
-    }
     if(size == VDDCSPECIFICSIZE)
     {
       NewMessageReceived = true;
@@ -184,13 +171,8 @@ void *IncomingDDCSpecific(void *arg)                    // listener thread
         HandlerCheckDDCSettings();
     }
   }
-//
-// close down thread
-//
-  close(ThreadData->Socketid);                  // close incoming data socket
-  ThreadData->Socketid = 0;
-  ThreadData->Active = false;                   // indicate it is closed
-  return NULL;
+  if(errno != EAGAIN)
+    perror("recvfrom, DDC Specific");
 }
 
 
@@ -28,7 +28,7 @@
 //
 // protocol 2 handler for incoming DDC specific Packet to SDR
 //
-void *IncomingDDCSpecific(void *arg);           // listener thread
+void IncomingDDCSpecific(int Socketid, uint32_t Events, void *arg);     // control reactor handler: socket readable
 
 
 #endif
\ No newline at end of file
@@ -16,6 +16,7 @@
 
 
 #include "threaddata.h"
+#include "udpreceive.h"
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "IncomingDUCSpecific.h"
@@ -33,15 +34,13 @@
 
 
 //
-// listener thread for incoming DUC specific packets
+// control reactor handler for incoming DUC specific packets
+// called when the socket is readable: processes every message queued on it
 //
-void *IncomingDUCSpecific(void *arg)                    // listener thread
+void IncomingDUCSpecific(int Socketid, __attribute__((unused)) uint32_t Events, __attribute__((unused)) void *arg)
 { 
-    struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-    struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-    uint8_t UDPInBuffer[VDUCSPECIFICSIZE];                // incoming buffer
-    struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-    struct msghdr datagram;                               // multiple incoming message header
+    uint8_t* UDPInBuffer;                                 // incoming message, in Batch
+    static struct UDPReceiveBatch Batch;                  // received messages
     int size;                                             // UDP datagram length
     uint8_t Byte;
     uint16_t SidetoneFreq;                                // freq for audio sidetone
@@ -53,28 +52,16 @@ void *IncomingDUCSpecific(void *arg)                    // listener thread
     uint8_t CWRampTime;
     uint32_t CWRampTime_us;
 
-    ThreadData = (struct ThreadSocketData *)arg;
-    ThreadData->Active = true;
-    printf("spinning up DUC specific thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
+    if((Batch.Buffer == NULL) && !UDPBatchCreate(&Batch, VDUCSPECIFICSIZE, 8))
+    {
+        printf("DUC specific receive buffer allocation failed\n");
+        return;
+    }
     //
-    // main processing loop
+    // process each message waiting
     //
-    while(1)
+    while((size = UDPBatchNext(&Batch, Socketid, 0, &UDPInBuffer)) >= 0)
     {
-      memset(&iovecinst, 0, sizeof(struct iovec));
-      memset(&datagram, 0, sizeof(datagram));
-      iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-      iovecinst.iov_len = VDUCSPECIFICSIZE;
-      datagram.msg_iov = &iovecinst;
-      datagram.msg_iovlen = 1;
-      datagram.msg_name = &addr_from;
-      datagram.msg_namelen = sizeof(addr_from);
-      size = recvmsg(ThreadData->Socketid, &datagram, 0);         // get one message. If it times out, ges size=-1
-      if(size < 0 && errno != EAGAIN)
-      {
-          perror("recvfrom, DUC specific");
-          return NULL;
-      }
       if(size == VDUCSPECIFICSIZE)
       {
           NewMessageReceived = true;
@@ -118,13 +105,8 @@ void *IncomingDUCSpecific(void *arg)                    // listener thread
           SetADCAttenuator(eADC1, Byte, false, true);
       }
     }
-//
-// close down thread
-//
-    close(ThreadData->Socketid);                  // close incoming data socket
-    ThreadData->Socketid = 0;
-    ThreadData->Active = false;                   // indicate it is closed
-    return NULL;
+    if(errno != EAGAIN)
+      perror("recvfrom, DUC specific");
 }
 
 
@@ -28,7 +28,7 @@
 //
 // protocol 2 handler for incoming DUC specific Packet to SDR
 //
-void *IncomingDUCSpecific(void *arg);           // listener thread
+void IncomingDUCSpecific(int Socketid, uint32_t Events, void *arg);     // control reactor handler: socket readable
 
 
 #endif
\ No newline at end of file
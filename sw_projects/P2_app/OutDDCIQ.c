@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "OutMicAudio.h"
+#include "OutDDCIQ.h"
 #include <errno.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -26,9 +27,17 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <syscall.h>
+#include <semaphore.h>
+#include <time.h>
+#include <sched.h>
+#include <endian.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
 #include "../common/hwaccess.h"
+#include "../common/ringbuffer.h"
 #include "../common/debugaids.h"
 
 
@@ -37,197 +46,172 @@
 //
 // global holding the current step of C&C data. Each new USB frame updates this.
 //
-#define VDMABUFFERSIZE 131072						// memory buffer to reserve (4x DDC FIFO so OK)
-#define VALIGNMENT 4096                             // buffer alignment
-#define VBASE 0x1000									              // DMA start at 4K into buffer
-#define VBASE 0x1000                                // offset into I/Q buffer for DMA to start
+#define VDMABUFFERSIZE 131072						// DMA ring buffer size (4x DDC FIFO so OK)
 #define VDMATRANSFERSIZE 4096                       // read 4K at a time  initially
 
-#define VDDCPACKETSIZE 1444
 #define VIQSAMPLESPERFRAME 238                      // total I/Q samples in one DDC packet
 #define VIQBYTESPERFRAME 6*VIQSAMPLESPERFRAME       // total bytes in one outgoing frame
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
+#define VFIFOEVENTTIMEOUT 2                         // max wait (ms) for a FIFO interrupt before re-reading depth
+#define VFIFOEVENTFALLBACK 500                      // timeouts with no interrupt ever seen before reverting to polling
+#define VSENDERWAKEUP 10                            // max wait (ms) by a sender thread if no packets signalled
+#define VASYNCDMASIZE 16384                         // largest DMA for overlapped DMA
+#define VASYNCRINGSPARE 2                           // overlapped DMA: ring space beyond the DMAs in flight (VASYNCDMASIZE units)
+#define VDMASIZESTEP 4096                           // DMA sizes are whole pages, so ring writes stay page aligned
+#define VMAXDMASIZE 32768                           // largest DDC DMA
+#define VSTREAMBLOCKSIZE 4096                       // kernel streaming ring: bytes per block
+#define VSTREAMBLOCKS 64                            // kernel streaming ring: blocks (256KB)
+#define VDDCFRAMERATE 48000                         // DDC frames per second: one per 48KHz sample
+#define VMINWAKEUPUS 100                            // shortest poll interval for DMA size controller
+#define VMAXWAKEUPUS 2000                           // longest poll interval for DMA size controller
 
-//
-// strategy:
-// 1. We have one DMA buffer, big enough for the largest DMA
-// 2. When a DMA occurs, trafer data to separate circular buffers for each DDC
-// 3. retain separate pointers into those buffers for each DDC
-// 4. copy ALL DMA'd data out to the separate buffers
-// 5. then loop through all DDC IQ buffers and send as many messages as possible
-//
-
-
-// use of IQ memory buffers as a "nearly circular" buffer:
-
-//
-// initially: data is added starting at Base pointer
-// 
-//               higher address
-//
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | <- IQHeadPtr: 1st free location above occupied data
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | <- IQBasePtr, IQReadPtr
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | <- start of memory buffer
-//                 low address
-//
-// when there is enough data for a P2 packet, it is copied out from the bottom:
-
-
-//
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | <- IQHeadPtr: 1st free location above occupied data
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | <- IQReadPtr: 1st occupied location, ready to read
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |               offset +0x1000    | <- IQBasePtr: data initially transferred here
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | <- start of memory buffer
-//                 low address
-//
-// then the "residue" is copied just BELOW the IQBasePtr, ready for a 
-// linear DMA to be able to read the next P2 packet without a "wrap" in the middle
-//
-//
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | 
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | 
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |<- IQBasePtr, IQHeadPtr: 1st free location above occupied data
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | <- IQReadPtr: 1st occupied location, ready to read
-//       |                                 | <- start of memory buffer
-//                 low address
-
-
-//
-// then more data gets added at the headptr:
-// 
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | 
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |<- IQHeadPtr: 1st free location above occupied data
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | 
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |<- IQBasePtr
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | <- IQReadPtr: 1st occupied location, ready to read
-//       |                                 | <- start of memory buffer
-//                 low address
-// 
-
+#define VTICKSPERFRAME 64                           // timestamp ticks per DDC frame: 3.072MHz, so every rate is whole ticks
+#define VTICKRATE (VTICKSPERFRAME * 48000ULL)       // timestamp ticks per second
+#define VLATENCYBUCKETS 16                          // DMA to wire latency histogram: log2(us) buckets
 
+#define VDDCSLOTS 32                                // P2 packet slots per DDC (more than a 32KB DMA can fill)
+#define VSLOTSAMPLEOFFSET 16                        // I/Q samples start 16 bytes into a P2 packet
 
+//
+// strategy:
+// 1. We have one DMA ring buffer, several times bigger than the largest DMA. It is a
+//    mirrored ring (see ringbuffer.h) so a frame that crosses the end of the ring is still
+//    contiguous: DMA data is decoded in place, and the part frame left over after a decode
+//    stays where it is, to be completed by the next DMA.
+// 2. each DDC has a ring of preformatted P2 packet "slots", each a complete outgoing UDP payload
+// 3. When a DMA occurs, demultiplex the samples straight into the current slot for each DDC,
+//    starting at offset +16 (after the P2 header) and moving to the next slot when it is full
+// 4. copy ALL DMA'd data out to the slots
+// 5. then signal the sender thread(s) that serve the DDCs that have new full slots
+// 6. each sender thread sends every full slot for its DDCs. The header is filled in place, and
+//    the slot is the sendmmsg() payload: no further copy of the sample data.
+//    Each slot has its own mmsghdr, so a run of full slots for a DDC goes in one sendmmsg() call,
+//    up to DDCSendBatchLimit packets at a time. (One call per DDC: each DDC has its own socket).
+//    A part filled slot is left where it is, to be completed by the next DMA.
+//
+// threads:
+// the OutgoingDDCIQ thread owns the DMA device and decodes frames; it is the only writer of
+// SlotWriteIdx[] and SlotFillBytes[]. Each DDC is served by exactly one sender thread, which is
+// the only writer of SlotReadIdx[] and of the DDC's sequence count. So each slot ring is a
+// single producer/single consumer ring and needs no lock: just acquire/release ordering on the
+// two indices. The DDC to sender thread mapping, and CPU affinity, are set by the command line.
+//
 
 
 //
 // code to allocate and free dynamic allocated memory
 // first the memory buffers:
 //
-uint8_t* DMAReadBuffer = NULL;								// data for DMA read from DDC
-uint32_t DMABufferSize = VDMABUFFERSIZE;
+struct RingBuffer DMARing;                                  // data for DMA read from DDC
 unsigned char* DMAReadPtr;							        // pointer for 1st available location in DMA memory
 unsigned char* DMAHeadPtr;							        // ptr to 1st free location in DMA memory
-unsigned char* DMABasePtr;							        // ptr to target DMA location in DMA memory
 
-uint8_t* UDPBuffer[VNUMDDC];                                // DDC frame buffer
-uint8_t* DDCSampleBuffer[VNUMDDC];                          // buffer per DDC
-unsigned char* IQReadPtr[VNUMDDC];							// pointer for reading out an I or Q sample
-unsigned char* IQHeadPtr[VNUMDDC];							// ptr to 1st free location in I/Q memory
-unsigned char* IQBasePtr[VNUMDDC];							// ptr to DMA location in I/Q memory
+uint8_t* DDCSlotBuffer[VNUMDDC];                            // VDDCSLOTS packet slots per DDC
+uint32_t SlotReadIdx[VNUMDDC];                              // oldest full slot, next to send
+uint32_t SlotWriteIdx[VNUMDDC];                             // slot currently being filled
+uint32_t SlotFillBytes[VNUMDDC];                            // sample bytes written to current slot
+struct iovec SlotIovec[VNUMDDC][VDDCSLOTS];                 // one iovec per packet slot
+struct mmsghdr SlotMsg[VNUMDDC][VDDCSLOTS];                 // one message header per packet slot
+
+uint32_t SlotStartIdx[VNUMDDC];                             // 1st slot written in the current run
+uint32_t SequenceCounter[VNUMDDC];                          // UDP sequence count
+struct sockaddr_in DDCDestAddr[VNUMDDC];                    // destination address for outgoing data
+
+//
+// packet timestamps and DMA to wire latency
+// the timestamp is the time of the 1st sample in a packet, counted in 3.072MHz ticks from the
+// start of the run, or from the epoch if the PC enabled timestamps (see below).
+// SlotDMATime is the time the DMA that completed a packet finished;
+// the sender subtracts that from the time sendmmsg() returns.
+//
+uint64_t DDCFrameCount;                                     // DDC frames decoded this run
+uint64_t DDCTimeBase;                                       // timestamp of the 1st frame of the run
+uint64_t DDCDMACompleteNs;                                  // completion time of latest DMA
+uint64_t SlotDMATime[VNUMDDC][VDDCSLOTS];                   // DMA completion time of each full slot
+uint32_t DDCLatencyHistogram[VNUMDDC][VLATENCYBUCKETS];     // packets sent, indexed by log2(latency in us)
+
+uint32_t DDCResyncCount;                                    // DDC stream framing errors recovered
+
+uint32_t DDCSendBatchLimit = VDEFAULTDDCBATCH;              // max packets per sendmmsg() call
+uint32_t DDCLatencyTarget = 0;                              // DMA size controller latency target (us); 0 = fixed size ladder
+uint32_t DDCAsyncDMABuffers = 0;                            // overlapped DMA buffer count; 0 = DMA not overlapped
+struct AsyncDMAReader DDCAsyncReader;                       // overlapped DMA reader
+bool DDCStreamRing = false;                                 // true to read from a kernel streaming ring
+struct DMAStreamRing DDCStream;                             // kernel streaming ring, while a run is active
+
+//
+// packet sender threads
+//
+struct DDCSenderData
+{
+    pthread_t Thread;
+    sem_t PacketsReady;                                     // posted by DMA thread when it fills slots
+    uint16_t DDCMask;                                       // bit set for each DDC served
+    int CPU;                                                // CPU to run on; -1 if any
+    struct ThreadSocketData* ThreadData;                    // socket data for DDC0
+    uint32_t BatchHistogram[VDDCSLOTS + 1];                 // number of batches sent, indexed by packets in batch
+    uint32_t AckGeneration;                                 // generation this thread has reset its DDCs for
+};
+
+struct DDCSenderData DDCSenders[VMAXDDCSENDERS] = {{.DDCMask = (1 << VNUMDDC) - 1, .CPU = -1}};
+uint32_t NumDDCSenders = 1;
+int DDCDMAThreadCPU = -1;                                   // CPU for the DMA thread; -1 if any
+uint32_t DDCStreamGeneration = 0;                           // incremented by DMA thread at each start
+uint32_t DDCSlotsFilled = 0;                                // bit set for DDCs with slots filled this pass
+uint32_t DDCPacketsMade = 0;                                // packets completed this pass
+bool DDCSendersExit = false;                                // set to request sender threads to exit
+bool DDCSendError = false;                                  // set by a sender thread if a send fails
 
 
 bool CreateDynamicMemory(void)                              // return true if error
 {
     uint32_t DDC;
+    uint32_t Slot;
+    uint32_t DMABufferSize = VDMABUFFERSIZE;
     bool Result = false;
 //
-// first create the buffer for DMA, and initialise its pointers
+// first create the ring buffer for DMA
+// for overlapped DMA, the ring holds a full size DMA per buffer, plus space for the
+// DMA being decoded and a part frame left from the one before, so every buffer can be in flight
 //
-    posix_memalign((void**)&DMAReadBuffer, VALIGNMENT, DMABufferSize);
-    DMAReadPtr = DMAReadBuffer + VBASE;		                    // offset 4096 bytes into buffer
-    DMAHeadPtr = DMAReadBuffer + VBASE;
-    DMABasePtr = DMAReadBuffer + VBASE;
-    if (!DMAReadBuffer)
+    if(DDCAsyncDMABuffers > VMAXASYNCDMABUFFERS)
+        DDCAsyncDMABuffers = VMAXASYNCDMABUFFERS;
+    if(DDCAsyncDMABuffers != 0)
+        DMABufferSize = (DDCAsyncDMABuffers + VASYNCRINGSPARE) * VASYNCDMASIZE;
+    if (!RingBufferCreate(&DMARing, DMABufferSize))
     {
         printf("I/Q read buffer allocation failed\n");
         Result = true;
     }
-    memset(DMAReadBuffer, 0, DMABufferSize);
 
     //
-    // set up per-DDC data structures
+    // set up per-DDC packet slots
     //
     for (DDC = 0; DDC < VNUMDDC; DDC++)
     {
-        UDPBuffer[DDC] = malloc(VDDCPACKETSIZE);
-        DDCSampleBuffer[DDC] = malloc(DMABufferSize);
-        IQReadPtr[DDC] = DDCSampleBuffer[DDC] + VBASE;		// offset 4096 bytes into buffer
-        IQHeadPtr[DDC] = DDCSampleBuffer[DDC] + VBASE;
-        IQBasePtr[DDC] = DDCSampleBuffer[DDC] + VBASE;
+        DDCSlotBuffer[DDC] = malloc(VDDCSLOTS * VDDCPACKETSIZE);
+        if (!DDCSlotBuffer[DDC])
+        {
+            printf("DDC packet buffer allocation failed\n");
+            Result = true;
+        }
+        SlotReadIdx[DDC] = 0;
+        SlotWriteIdx[DDC] = 0;
+        SlotFillBytes[DDC] = 0;
+        SlotStartIdx[DDC] = 0;
+        //
+        // one message header per slot, pointing at the slot
+        //
+        for (Slot = 0; Slot < VDDCSLOTS; Slot++)
+        {
+            memset(&SlotMsg[DDC][Slot], 0, sizeof(struct mmsghdr));
+            SlotIovec[DDC][Slot].iov_base = DDCSlotBuffer[DDC] + Slot * VDDCPACKETSIZE;
+            SlotIovec[DDC][Slot].iov_len = VDDCPACKETSIZE;
+            SlotMsg[DDC][Slot].msg_hdr.msg_iov = &SlotIovec[DDC][Slot];
+            SlotMsg[DDC][Slot].msg_hdr.msg_iovlen = 1;
+            SlotMsg[DDC][Slot].msg_hdr.msg_name = &DDCDestAddr[DDC];       // MAC addr & port to send to
+            SlotMsg[DDC][Slot].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
     }
     return Result;
 }
@@ -237,18 +221,506 @@ void FreeDynamicMemory(void)
 {
     uint32_t DDC;
 
-    free(DMAReadBuffer);
+    RingBufferDestroy(&DMARing);
     //
     // free the per-DDC buffers
     //
     for (DDC = 0; DDC < VNUMDDC; DDC++)
+        free(DDCSlotBuffer[DDC]);
+}
+
+
+//
+// unpack Count 64 bit DMA words into packed 6 byte I/Q samples
+// each 64 bit word holds 48 bits of sample data in its low 6 bytes and 16 unused bits.
+// The NEON version loads 8 words as 4 de-interleaved halfword vectors and stores back
+// only the 3 that hold sample data: 64 bytes in, 48 bytes out per iteration.
+// Dest need only be 2 byte aligned, which every sample position in a packet slot is.
+//
+static void UnpackDDCSamples(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+{
+#if defined(__ARM_NEON)
+    uint16x8x4_t Words;
+    uint16x8x3_t Samples;
+
+    while (Count >= 8)
+    {
+        Words = vld4q_u16((const uint16_t*)Src);
+        Samples.val[0] = Words.val[0];
+        Samples.val[1] = Words.val[1];
+        Samples.val[2] = Words.val[2];
+        vst3q_u16((uint16_t*)Dest, Samples);
+        Src += 64;
+        Dest += 48;
+        Count -= 8;
+    }
+#endif
+    //
+    // scalar version, or the last few words for NEON:
+    // 64 bit load, then a 6 byte store (little endian so the sample is the low 6 bytes)
+    //
+    while (Count != 0)
     {
-        free(UDPBuffer[DDC]);
-        free(DDCSampleBuffer[DDC]);
+        uint64_t Word;
+        memcpy(&Word, Src, 8);
+        memcpy(Dest, &Word, 6);
+        Src += 8;
+        Dest += 6;
+        Count--;
     }
 }
 
 
+//
+// demultiplex Count 64 bit DMA words for one DDC into its packet slots
+// Count is as given by AnalyseDDCHeader(), so it is already doubled for an interleaved pair;
+// the samples for both DDCs go into this DDC's slots in their interleaved order.
+// returns pointer to the 1st DMA word not used
+//
+static uint8_t* DemuxDDCSamples(uint32_t DDC, uint8_t* SrcPtr, uint32_t Count)
+{
+    uint8_t* DestPtr;
+    uint32_t Samples;                                           // samples to write to this slot
+    uint32_t Next;                                              // next slot index
+    uint32_t FrameCount = Count;                                // samples in the whole frame for this DDC
+    uint64_t TimeStamp;
+
+    while (Count != 0)
+    {
+        if (SlotFillBytes[DDC] == 0)                            // new packet: stamp with time of its 1st sample
+        {
+            TimeStamp = DDCTimeBase + DDCFrameCount * VTICKSPERFRAME
+                        + (FrameCount - Count) * (VTICKSPERFRAME / FrameCount);
+            TimeStamp = htobe64(TimeStamp);
+            memcpy(DDCSlotBuffer[DDC] + SlotWriteIdx[DDC] * VDDCPACKETSIZE + 4, &TimeStamp, 8);
+        }
+        Samples = (VIQBYTESPERFRAME - SlotFillBytes[DDC]) / 6;
+        if (Samples > Count)
+            Samples = Count;
+        DestPtr = DDCSlotBuffer[DDC] + SlotWriteIdx[DDC] * VDDCPACKETSIZE
+                  + VSLOTSAMPLEOFFSET + SlotFillBytes[DDC];
+        UnpackDDCSamples(DestPtr, SrcPtr, Samples);
+        SrcPtr += 8 * Samples;                                  // 8 bytes per DMA word
+        Count -= Samples;
+        SlotFillBytes[DDC] += 6 * Samples;
+        if (SlotFillBytes[DDC] == VIQBYTESPERFRAME)             // slot full: move on to next
+        {
+            SlotFillBytes[DDC] = 0;
+            Next = (SlotWriteIdx[DDC] + 1) % VDDCSLOTS;
+            if (Next == __atomic_load_n(&SlotReadIdx[DDC], __ATOMIC_ACQUIRE))
+            {
+                //
+                // ring full: the sender hasn't kept up. The slot is overwritten
+                // so this packet is dropped
+                //
+                if (UseDebug)
+                    printf("DDC%d packet slots overrun\n", DDC);
+            }
+            else
+            {
+                SlotDMATime[DDC][SlotWriteIdx[DDC]] = DDCDMACompleteNs;
+                __atomic_store_n(&SlotWriteIdx[DDC], Next, __ATOMIC_RELEASE);
+                DDCSlotsFilled |= (1 << DDC);
+                DDCPacketsMade++;
+            }
+        }
+    }
+    return SrcPtr;
+}
+
+
+//
+// search the DMA data for a DDC rate word, starting Start bytes past *ReadPtr.
+// a rate word has 0x80 in its top byte. If there is enough data to reach the frame after it,
+// the candidate is only accepted if a rate word is found there too (at the frame length
+// given by AnalyseDDCHeader()) so that a sample word that happens to look like a header
+// is passed over.
+// on success *ReadPtr points to the rate word and returns true.
+// if none found, all the data is dropped: *ReadPtr is set to HeadPtr and returns false.
+//
+static bool FindDDCHeader(uint8_t** ReadPtr, uint8_t* HeadPtr, uint32_t Start)
+{
+    uint8_t* Ptr;
+    uint8_t* NextPtr;
+    uint32_t Counts[VNUMDDC];
+
+    for (Ptr = *ReadPtr + Start; Ptr + 8 <= HeadPtr; Ptr += 8)
+    {
+        if (*(Ptr + 7) != 0x80)
+            continue;
+        NextPtr = Ptr + (AnalyseDDCHeader(*(uint32_t*)Ptr, Counts) + 1) * 8;
+        if ((NextPtr + 8 <= HeadPtr) && (*(NextPtr + 7) != 0x80))
+            continue;
+        *ReadPtr = Ptr;
+        return true;
+    }
+    *ReadPtr = HeadPtr;
+    return false;
+}
+
+
+//
+// set the CPU affinity of the calling thread. CPU = -1 leaves it free to run on any
+//
+static void SetThreadCPU(int CPU)
+{
+    cpu_set_t CPUSet;
+
+    if (CPU < 0)
+        return;
+    CPU_ZERO(&CPUSet);
+    CPU_SET(CPU, &CPUSet);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &CPUSet) != 0)
+        printf("could not set thread affinity to CPU %d\n", CPU);
+}
+
+
+//
+// send every full packet slot for one DDC, in batches of up to DDCSendBatchLimit.
+// the samples are already in place, so just fill in the headers and send the slots themselves.
+// a batch is a contiguous run of full slots, so it stops at the end of the ring
+//
+static void SendDDCPackets(struct DDCSenderData* Sender, uint32_t DDC)
+{
+    uint32_t ReadIdx, WriteIdx;
+    uint32_t Slot;                                              // packet slot iterator
+    uint32_t BatchSize;                                         // packets for one sendmmsg() call
+    uint8_t* SlotPtr;                                           // P2 packet slot to send
+    int Sent;                                                   // packets sent by sendmmsg()
+    struct timespec Now;
+    uint64_t LatencyUs;
+    uint32_t Bucket;
+
+    ReadIdx = SlotReadIdx[DDC];
+    WriteIdx = __atomic_load_n(&SlotWriteIdx[DDC], __ATOMIC_ACQUIRE);
+    while (ReadIdx != WriteIdx)
+    {
+        if (WriteIdx > ReadIdx)
+            BatchSize = WriteIdx - ReadIdx;
+        else
+            BatchSize = VDDCSLOTS - ReadIdx;
+        if (BatchSize > DDCSendBatchLimit)
+            BatchSize = DDCSendBatchLimit;
+
+        for (Slot = ReadIdx; Slot < ReadIdx + BatchSize; Slot++)
+        {
+            SlotPtr = DDCSlotBuffer[DDC] + Slot * VDDCPACKETSIZE;
+            *(uint32_t*)SlotPtr = htonl(SequenceCounter[DDC]++);        // add sequence count
+                                                                        // timestamp already added by DMA thread
+            *(uint16_t*)(SlotPtr + 12) = htons(24);                     // bits per sample
+            *(uint16_t*)(SlotPtr + 14) = htons(VIQSAMPLESPERFRAME);     // I/Q samples for ths frame
+        }
+
+        Sent = sendmmsg((Sender->ThreadData+DDC)->Socketid, &SlotMsg[DDC][ReadIdx], BatchSize, 0);
+        if (Sent == -1)
+        {
+            printf("Send Error, DDC=%d, errno=%d, socket id = %d\n", DDC, errno, (Sender->ThreadData+DDC)->Socketid);
+            __atomic_store_n(&DDCSendError, true, __ATOMIC_RELEASE);
+            break;
+        }
+        //
+        // a short send leaves the remaining slots full;
+        // they are renumbered and sent in the next batch
+        //
+        SequenceCounter[DDC] -= BatchSize - (uint32_t)Sent;
+        clock_gettime(CLOCK_MONOTONIC, &Now);
+        for (Slot = ReadIdx; Slot < ReadIdx + Sent; Slot++)
+        {
+            LatencyUs = ((uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec - SlotDMATime[DDC][Slot]) / 1000;
+            for (Bucket = 0; (LatencyUs > 1) && (Bucket < VLATENCYBUCKETS - 1); Bucket++)
+                LatencyUs >>= 1;
+            DDCLatencyHistogram[DDC][Bucket]++;
+        }
+        ReadIdx = (ReadIdx + Sent) % VDDCSLOTS;
+        __atomic_store_n(&SlotReadIdx[DDC], ReadIdx, __ATOMIC_RELEASE);
+        Sender->BatchHistogram[Sent]++;
+    }
+}
+
+
+//
+// packet sender thread. Serves the DDCs in its DDCMask.
+// woken by the DMA thread when it has filled slots for one of those DDCs.
+// when the DMA thread starts a new run, slots left from the previous run are discarded
+// and the sequence counts restart from zero. The thread then acknowledges the new generation;
+// the DMA thread waits for that before it fills a slot, so no slot of the new run can be
+// sent with the old sequence count or destination.
+//
+static void *DDCPacketSender(void *arg)
+{
+    struct DDCSenderData* Sender = (struct DDCSenderData*)arg;
+    uint32_t Generation = 0;                                    // run we are sending for; 0 = none yet
+    uint32_t NewGeneration;
+    struct timespec Timeout;
+    uint32_t DDC;
+
+    SetThreadCPU(Sender->CPU);
+    printf("spinning up DDC packet sender thread for DDC mask %03x, pid=%ld\n", Sender->DDCMask, syscall(SYS_gettid));
+    while (!__atomic_load_n(&DDCSendersExit, __ATOMIC_ACQUIRE))
+    {
+        clock_gettime(CLOCK_REALTIME, &Timeout);
+        Timeout.tv_nsec += VSENDERWAKEUP * 1000000L;
+        if (Timeout.tv_nsec >= 1000000000L)
+        {
+            Timeout.tv_sec++;
+            Timeout.tv_nsec -= 1000000000L;
+        }
+        sem_timedwait(&Sender->PacketsReady, &Timeout);
+
+        NewGeneration = __atomic_load_n(&DDCStreamGeneration, __ATOMIC_ACQUIRE);
+        if (NewGeneration != Generation)
+        {
+            Generation = NewGeneration;
+            for (DDC = 0; DDC < VNUMDDC; DDC++)
+                if (Sender->DDCMask & (1 << DDC))
+                {
+                    SequenceCounter[DDC] = 0;
+                    memset(DDCLatencyHistogram[DDC], 0, sizeof(DDCLatencyHistogram[DDC]));
+                    memcpy(&DDCDestAddr[DDC], &reply_addr, sizeof(struct sockaddr_in));   // local copy of PC destination address (reply_addr is global)
+                    __atomic_store_n(&SlotReadIdx[DDC], SlotStartIdx[DDC], __ATOMIC_RELEASE);
+                }
+            __atomic_store_n(&Sender->AckGeneration, Generation, __ATOMIC_RELEASE);
+        }
+        if (Generation == 0)
+            continue;
+
+        for (DDC = 0; DDC < VNUMDDC; DDC++)
+            if (Sender->DDCMask & (1 << DDC))
+                SendDDCPackets(Sender, DDC);
+    }
+    return NULL;
+}
+
+
+//
+// set the DDC to sender thread mapping from a command line string
+// Spec is one group per sender thread, separated by "/".
+// each group is a DDC or DDC range, optionally followed by ":" and a CPU number
+// eg "0-4:2/5-9:3" = DDC0-4 sent by a thread on CPU 2; DDC5-9 by a thread on CPU 3.
+// any DDC not listed is served by the first thread.
+// returns true if error
+//
+bool SetDDCSenderMapping(char* Spec)
+{
+    char* Group;
+    char* SavePtr;
+    unsigned int First, Last;
+    int CPU;
+    uint32_t Mask;
+    uint32_t Mapped = 0;
+
+    NumDDCSenders = 0;
+    for (Group = strtok_r(Spec, "/", &SavePtr); Group != NULL; Group = strtok_r(NULL, "/", &SavePtr))
+    {
+        if (NumDDCSenders >= VMAXDDCSENDERS)
+            return true;
+        CPU = -1;
+        if (sscanf(Group, "%u-%u:%d", &First, &Last, &CPU) < 2)
+        {
+            if (sscanf(Group, "%u:%d", &First, &CPU) < 1)
+                return true;
+            Last = First;
+        }
+        if ((First > Last) || (Last >= VNUMDDC))
+            return true;
+        Mask = ((1 << (Last + 1)) - 1) & ~((1 << First) - 1);
+        if (Mask & Mapped)                                      // DDC on two threads
+            return true;
+        Mapped |= Mask;
+        DDCSenders[NumDDCSenders].DDCMask = Mask;
+        DDCSenders[NumDDCSenders].CPU = CPU;
+        NumDDCSenders++;
+    }
+    if (NumDDCSenders == 0)
+        return true;
+    DDCSenders[0].DDCMask |= ((1 << VNUMDDC) - 1) & ~Mapped;
+    return false;
+}
+
+
+//
+// set the CPU for the DDC DMA thread
+//
+void SetDDCDMAThreadCPU(int CPU)
+{
+    DDCDMAThreadCPU = CPU;
+}
+
+
+//
+// latency targeted DMA size controller
+// a sample waits in the FIFO while a DMA's worth of data accumulates, then for the DMA itself.
+// so the latency seen by the oldest sample in a DMA is (fill time + DMA time).
+// fill time is known from the stream byte rate, set by the DDC rate word: one frame of
+// (1 rate word + FrameLength sample words) every 48KHz sample. DMA time is measured.
+// the controller picks the largest DMA that meets the latency target, so a small target gives
+// minimum latency (CW/QSK) and a large target gives big efficient DMAs (panadapters).
+// if the FIFO has built up more than one DMA's worth, we are falling behind: the DMA is
+// enlarged to drain it, whatever the target, to avoid FIFO overflow.
+//
+struct DDCDMAController
+{
+    uint32_t TargetNs;                                      // latency target
+    uint32_t ByteRate;                                      // DDC stream bytes per second; 0 if not known
+    uint32_t DMANsPerStep;                                  // smoothed DMA time per VDMASIZESTEP bytes
+    uint32_t Threshold;                                     // FIFO depth (words) to wait for before DMA
+    //
+    // achieved latency for the current run
+    //
+    uint64_t LatencyTotalNs;
+    uint32_t LatencyMaxNs;
+    uint32_t LatencyCount;
+};
+
+struct DDCDMAController DDCDMAControl;
+
+
+//
+// initialise the controller at the start of a run. Byte rate is unknown until a rate word is decoded.
+//
+static void DMAControllerReset(struct DDCDMAController* Ctl)
+{
+    memset(Ctl, 0, sizeof(struct DDCDMAController));
+    Ctl->TargetNs = DDCLatencyTarget * 1000;
+    Ctl->Threshold = VDMATRANSFERSIZE / 8;
+}
+
+
+//
+// set the stream byte rate from a newly decoded rate word's frame length
+//
+static void DMAControllerSetRate(struct DDCDMAController* Ctl, uint32_t FrameLength)
+{
+    Ctl->ByteRate = (FrameLength + 1) * 8 * VDDCFRAMERATE;
+}
+
+
+//
+// the largest DMA that meets the latency target; also sets the wake-up threshold
+//
+static uint32_t DMAControllerTargetSize(struct DDCDMAController* Ctl)
+{
+    uint32_t Target;
+    uint64_t FillNs;
+
+    if(Ctl->ByteRate == 0)                                  // rate not known yet: smallest DMA
+        Target = VDMASIZESTEP;
+    else
+    {
+        for (Target = VMAXDMASIZE; Target > VDMASIZESTEP; Target -= VDMASIZESTEP)
+        {
+            FillNs = (uint64_t)Target * 1000000000ULL / Ctl->ByteRate;
+            if((FillNs + (uint64_t)Ctl->DMANsPerStep * (Target / VDMASIZESTEP)) <= Ctl->TargetNs)
+                break;
+        }
+    }
+    Ctl->Threshold = Target / 8;
+    return Target;
+}
+
+
+//
+// choose the DMA size now, given the current FIFO depth in words, and the FIFO depth
+// (wake-up threshold) to wait for before the next DMA
+// never returns more than the FIFO holds
+//
+static uint32_t DMAControllerChooseSize(struct DDCDMAController* Ctl, uint32_t Depth)
+{
+    uint32_t Target;
+    uint32_t Available;
+
+    Target = DMAControllerTargetSize(Ctl);
+
+    Available = (Depth * 8) & ~(VDMASIZESTEP - 1);         // whole pages in FIFO now
+    if(Available > Target + VDMASIZESTEP)                   // backlog: drain it
+        return (Available > VMAXDMASIZE) ? VMAXDMASIZE : Available;
+    return (Available < Target) ? Available : Target;
+}
+
+
+//
+// poll interval while waiting for the FIFO to reach threshold: the time for the remaining
+// words to arrive, so we neither wake up needlessly nor oversleep the target
+//
+static uint32_t DMAControllerWakeupUs(struct DDCDMAController* Ctl, uint32_t Depth)
+{
+    uint64_t WaitUs = VMAXWAKEUPUS;
+
+    if((Ctl->ByteRate != 0) && (Depth < Ctl->Threshold))
+        WaitUs = (uint64_t)(Ctl->Threshold - Depth) * 8 * 1000000ULL / Ctl->ByteRate;
+    if(WaitUs < VMINWAKEUPUS)
+        WaitUs = VMINWAKEUPUS;
+    else if(WaitUs > VMAXWAKEUPUS)
+        WaitUs = VMAXWAKEUPUS;
+    return (uint32_t)WaitUs;
+}
+
+
+//
+// record a completed DMA: Depth is the FIFO depth (words) when it started, DMANs how long it took.
+// the oldest sample transferred had been in the FIFO for (Depth words / byte rate).
+//
+static void DMAControllerRecord(struct DDCDMAController* Ctl, uint32_t Depth, uint32_t Size, uint32_t DMANs)
+{
+    uint32_t PerStep;
+    uint32_t LatencyNs;
+
+    PerStep = DMANs / (Size / VDMASIZESTEP);
+    if(Ctl->DMANsPerStep == 0)
+        Ctl->DMANsPerStep = PerStep;
+    else
+        Ctl->DMANsPerStep = (7 * Ctl->DMANsPerStep + PerStep) / 8;
+    if(Ctl->ByteRate != 0)
+    {
+        LatencyNs = (uint32_t)((uint64_t)Depth * 8 * 1000000000ULL / Ctl->ByteRate) + DMANs;
+        Ctl->LatencyTotalNs += LatencyNs;
+        Ctl->LatencyCount++;
+        if(LatencyNs > Ctl->LatencyMaxNs)
+            Ctl->LatencyMaxNs = LatencyNs;
+    }
+}
+
+
+//
+// overlapped DMA: keep every buffer in flight.
+// each DMA goes straight after the one before it in the ring. A DMA only completes when
+// it is full, so it is sized like a single DMA: from the latency target if set, else from
+// the FIFO depth; that way a low sample rate doesn't wait for a large DMA to fill.
+//
+uint32_t AsyncSubmitOffset;                                 // ring offset for the next DMA
+uint32_t AsyncPendingBytes;                                 // bytes in DMAs in flight
+uint32_t AsyncNextBuffer;                                   // next buffer to submit
+uint32_t AsyncLength[VMAXASYNCDMABUFFERS];                  // size of the DMA in each buffer
+
+static int AsyncDDCSubmit(struct RingBuffer* Ring, uint32_t Depth)
+{
+    uint32_t Size;
+
+    while(DDCAsyncReader.InFlight < DDCAsyncDMABuffers)
+    {
+        if(DDCLatencyTarget != 0)
+            Size = DMAControllerTargetSize(&DDCDMAControl);
+        else if(Depth > 2048)
+            Size = 16384;
+        else if(Depth > 1024)
+            Size = 8192;
+        else
+            Size = 4096;
+        if(Size > VASYNCDMASIZE)
+            Size = VASYNCDMASIZE;
+        if(RingBufferSpace(Ring) < AsyncPendingBytes + Size)
+            break;
+        if(AsyncDMAReadSubmitTo(&DDCAsyncReader, AsyncNextBuffer, Ring->Base + AsyncSubmitOffset, Size) != 0)
+            return -EIO;
+        AsyncLength[AsyncNextBuffer] = Size;
+        AsyncPendingBytes += Size;
+        AsyncSubmitOffset = (AsyncSubmitOffset + Size) % Ring->Size;
+        AsyncNextBuffer = (AsyncNextBuffer + 1) % DDCAsyncDMABuffers;
+    }
+    return 0;
+}
+
+
 //
 //
 // this runs as its own thread to send outgoing data
@@ -264,34 +736,41 @@ void *OutgoingDDCIQ(void *arg)
     uint32_t DMATransferSize;
     bool InitError = false;                                     // becomes true if we get an initialisation error
     
-    uint32_t ResidueBytes;
     uint32_t Depth = 0;
     
     int IQReadfile_fd = -1;									    // DMA read file device
+    int FIFOEvent_fd = -1;                                      // FIFO monitor interrupt event device
+    uint32_t FIFOEventCount = 0;                                // interrupt events received
+    uint32_t FIFOEventTimeouts = 0;                             // waits that timed out with no interrupt
+    bool FIFOEventSpurious = false;                             // last interrupt wasn't over threshold
     uint32_t RegisterValue;
     bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
     int DDC;                                                    // iterator
 
     struct ThreadSocketData *ThreadData;                        // socket etc data for each thread.
                                                                 // points to 1st one
-//
-// variables for outgoing UDP frame
-//
-    struct sockaddr_in DestAddr[VNUMDDC];                       // destination address for outgoing data
-    struct iovec iovecinst[VNUMDDC];                            // instance of iovec
-    struct msghdr datagram[VNUMDDC];
-    uint32_t SequenceCounter[VNUMDDC];                          // UDP sequence count
+    uint32_t Sender;                                            // sender thread iterator
+    uint32_t Generation;                                        // run number given to the sender threads
+    uint32_t AsyncRegion = 0;                                   // overlapped DMA: buffer being decoded
+    unsigned char* AsyncRegions[VMAXASYNCDMABUFFERS];           // overlapped DMA: DMA buffer regions
+    float ReadyPercent;
+    int Result;
+    struct timespec DMAStart, DMAEnd;                           // DMA timing for size controller
+    uint32_t WakeupUs;                                          // poll interval
+    uint32_t WakeDepth;                                         // FIFO depth to wait for before DMA
+    struct timespec RunStart;
+    uint32_t Slot;
+    struct RingBuffer* Ring;                                    // ring being decoded: DMARing, or the streaming ring
 //
 // variables for analysing a DDC frame
 //
-    uint32_t FrameLength;                                       // number of words per frame
+    uint32_t FrameLength = 0;                                   // number of words per frame
     uint32_t DDCCounts[VNUMDDC];                                // number of samples per DDC in a frame
     uint32_t RateWord;                                          // DDC rate word from buffer
     uint32_t HdrWord;                                           // check word read form DMA's data
-    uint16_t* SrcWordPtr, * DestWordPtr;                        // 16 bit read & write pointers
+    uint8_t* SrcPtr;                                            // sample data read pointer
     uint32_t *LongWordPtr;
     uint32_t PrevRateWord;                                      // last used rate word
-    uint32_t Cntr;                                              // sample word counter
     bool HeaderFound;
     uint32_t DecodeByteCount;                                   // bytes to decode
     unsigned int Current;                                   // current occupied locations in FIFO
@@ -302,6 +781,8 @@ void *OutgoingDDCIQ(void *arg)
 //
     PrevRateWord = 0xFFFFFFFF;                                  // illegal value to forc re-calculation of rates
     DMATransferSize = VDMATRANSFERSIZE;                         // initial size, but can be changed
+    if(DDCStreamRing)                                           // the streaming ring replaces overlapped DMA
+        DDCAsyncDMABuffers = 0;
     InitError = CreateDynamicMemory();
     //
     // open DMA device driver
@@ -314,17 +795,55 @@ void *OutgoingDDCIQ(void *arg)
         InitError = true;
     }
 
+    //
+    // overlapped DMA: the DMA ring is filled by a sequence of DMAs, each placed after the last.
+    // a frame that spans two DMAs, or the end of the ring, is contiguous because the ring
+    // is mirrored. One DMA is being decoded while DMAs for all the buffers are in flight;
+    // ring space is only re-used when the decode has moved on past it.
+    //
+    if((DDCAsyncDMABuffers != 0) && !InitError)
+    {
+        for (Slot = 0; Slot < DDCAsyncDMABuffers; Slot++)
+            AsyncRegions[Slot] = DMARing.Base + Slot * VASYNCDMASIZE;
+        if(AsyncDMAReadOpen(&DDCAsyncReader, IQReadfile_fd, VADDRDDCSTREAMREAD, DDCAsyncDMABuffers, VASYNCDMASIZE, AsyncRegions) != 0)
+        {
+            printf("overlapped DMA not available for DDC data; using single DMA\n");
+            DDCAsyncDMABuffers = 0;
+        }
+    }
+    //
+    // single DMA reads go to the ring write pointer: pin the whole ring, including its mirror
+    //
+    if((DDCAsyncDMABuffers == 0) && !InitError)
+        DMARegisterBuffer(IQReadfile_fd, DMARing.Base, 2 * DMARing.Size);
+
     ThreadData = (struct ThreadSocketData*)arg;
+    SetThreadCPU(DDCDMAThreadCPU);
     printf("spinning up outgoing I/Q thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
 
+    //
+    // start the packet sender threads
+    //
+    if((DDCSendBatchLimit == 0) || (DDCSendBatchLimit > VDDCSLOTS))
+        DDCSendBatchLimit = VDEFAULTDDCBATCH;
+    for (Sender = 0; Sender < NumDDCSenders; Sender++)
+    {
+        DDCSenders[Sender].ThreadData = ThreadData;
+        sem_init(&DDCSenders[Sender].PacketsReady, 0, 0);
+        if(pthread_create(&DDCSenders[Sender].Thread, NULL, DDCPacketSender, &DDCSenders[Sender]) != 0)
+        {
+            printf("DDC packet sender thread create failed\n");
+            InitError = true;
+            NumDDCSenders = Sender;
+            break;
+        }
+    }
+
     //
     // set up per-DDC data structures
     //
     for (DDC = 0; DDC < VNUMDDC; DDC++)
-    {
-        SequenceCounter[DDC] = 0;                           // clear UDP packet counter
         (ThreadData + DDC)->Active = true;                  // set outgoing socket active
-    }
 
 
 
@@ -337,7 +856,14 @@ void *OutgoingDDCIQ(void *arg)
 //    RegisterWrite(0x1010, 0x0000002A);      // disable DDC data transfer; DDC2=test source
     SetRXDDCEnabled(false);
     usleep(1000);                           // give FIFO time to stop recording 
-    SetupFIFOMonitorChannel(eRXDDCDMA, false);
+    //
+    // if the event device is available, block on the FIFO monitor interrupt instead of
+    // polling FIFO depth. If no interrupt is ever seen, revert to polling (see below)
+    //
+    FIFOEvent_fd = OpenFIFOMonitorEvents();
+    if(UseDebug)
+        printf("DDC FIFO wakeup by %s\n", (FIFOEvent_fd >= 0) ? "interrupt event" : "polling");
+    SetupFIFOMonitorChannel(eRXDDCDMA, (FIFOEvent_fd >= 0));
     ResetDMAStreamFIFO(eRXDDCDMA);
     RegisterValue = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
 	if(UseDebug)
@@ -367,82 +893,80 @@ void *OutgoingDDCIQ(void *arg)
         printf("starting outgoing DDC data\n");
         StartupCount = VSTARTUPDELAY;
         //
-        // initialise outgoing DDC packets - 1 per DDC
+        // start a new run: samples and packets from any previous run are discarded.
+        // the sender threads pick up the new generation, reset their sequence counts
+        // and start reading from the slot we start writing to.
+        // wait until they all have, before any slot is filled
         //
         for (DDC = 0; DDC < VNUMDDC; DDC++)
         {
-            SequenceCounter[DDC] = 0;
-            memcpy(&DestAddr[DDC], &reply_addr, sizeof(struct sockaddr_in));           // local copy of PC destination address (reply_addr is global)
-            memset(&iovecinst[DDC], 0, sizeof(struct iovec));
-            memset(&datagram[DDC], 0, sizeof(struct msghdr));
-            iovecinst[DDC].iov_base = UDPBuffer[DDC];
-            iovecinst[DDC].iov_len = VDDCPACKETSIZE;
-            datagram[DDC].msg_iov = &iovecinst[DDC];
-            datagram[DDC].msg_iovlen = 1;
-            datagram[DDC].msg_name = &DestAddr[DDC];                   // MAC addr & port to send to
-            datagram[DDC].msg_namelen = sizeof(struct sockaddr_in);
+            SlotFillBytes[DDC] = 0;
+            SlotStartIdx[DDC] = SlotWriteIdx[DDC];
+        }
+        Generation = __atomic_add_fetch(&DDCStreamGeneration, 1, __ATOMIC_RELEASE);
+        for (Sender = 0; Sender < NumDDCSenders; Sender++)
+        {
+            sem_post(&DDCSenders[Sender].PacketsReady);
+            while (__atomic_load_n(&DDCSenders[Sender].AckGeneration, __ATOMIC_ACQUIRE) != Generation)
+                usleep(100);
+        }
+        //
+        // start with an empty DMA buffer. For overlapped DMA, put a DMA in flight for every buffer.
+        //
+        RingBufferReset(&DMARing);
+        DMAControllerReset(&DDCDMAControl);
+        if(DDCAsyncDMABuffers != 0)
+        {
+            AsyncRegion = 0;
+            AsyncNextBuffer = 0;
+            AsyncSubmitOffset = 0;
+            AsyncPendingBytes = 0;
+            if(AsyncDDCSubmit(&DMARing, 0) != 0)
+                InitError = true;
+        }
+        //
+        // kernel streaming ring: the driver keeps the DMA engine reading into a ring of blocks,
+        // with an interrupt as each block fills, so there is no DMA call here at all.
+        // it has to start before the DDCs are enabled.
+        //
+        Ring = &DMARing;
+        if(DDCStreamRing)
+        {
+            Result = DMAStreamOpen(&DDCStream, IQReadfile_fd, VADDRDDCSTREAMREAD, VSTREAMBLOCKSIZE, VSTREAMBLOCKS);
+            if(Result == 0)
+                Ring = &DDCStream.Ring;
+            else
+            {
+                printf("kernel streaming ring not available for DDC data (error %d); using single DMA\n", Result);
+                DDCStreamRing = false;
+            }
         }
       //
       // enable Saturn DDC to transfer data
       //
         printf("outDDCIQ: enable data transfer\n");
+        //
+        // timestamps count from zero; or if the PC has enabled timestamps, from the epoch of
+        // the system clock. With the Pi's clock disciplined by a GPS PPS input (gpsd/chrony),
+        // packets from different radios can then be aligned.
+        //
+        DDCFrameCount = 0;
+        DDCResyncCount = 0;
+        DDCTimeBase = 0;
+        if(GEnableTimeStamping)
+        {
+            clock_gettime(CLOCK_REALTIME, &RunStart);
+            DDCTimeBase = (uint64_t)RunStart.tv_sec * VTICKRATE + (uint64_t)RunStart.tv_nsec * VTICKRATE / 1000000000ULL;
+        }
         SetRXDDCEnabled(true);
         HeaderFound = false;
         while(!InitError && SDRActive)
         {
 
-        //
-        // loop through all DDC I/Q buffers.
-        // while there is enough I/Q data for this DDC in local (ARM) memory, make DDC Packets
-        // then put any residues at the heads of the buffer, ready for new data to come in
-        //
-            for (DDC = 0; DDC < VNUMDDC; DDC++)
-            {
-                while ((IQHeadPtr[DDC] - IQReadPtr[DDC]) > VIQBYTESPERFRAME)
-                {
-//                    printf("enough data for packet: DDC= %d\n", DDC);
-                    *(uint32_t*)UDPBuffer[DDC] = htonl(SequenceCounter[DDC]++);     // add sequence count
-                    memset(UDPBuffer[DDC] + 4, 0, 8);                               // clear the timestamp data
-                    *(uint16_t*)(UDPBuffer[DDC] + 12) = htons(24);                  // bits per sample
-                    *(uint32_t*)(UDPBuffer[DDC] + 14) = htons(VIQSAMPLESPERFRAME);  // I/Q samples for ths frame
-                    //
-                    // now add I/Q data & send outgoing packet
-                    //
-                    memcpy(UDPBuffer[DDC] + 16, IQReadPtr[DDC], VIQBYTESPERFRAME);
-                    IQReadPtr[DDC] += VIQBYTESPERFRAME;
-
-                    int Error;
-                    Error = sendmsg((ThreadData+DDC)->Socketid, &datagram[DDC], 0);
-                    if(StartupCount != 0)                                   // decrement startup message count
-                        StartupCount--;
-
-                    if (Error == -1)
-                    {
-                        printf("Send Error, DDC=%d, errno=%d, socket id = %d\n", DDC, errno, (ThreadData+DDC)->Socketid);
-                        InitError = true;
-                    }
-                }
-                //
-                // now copy any residue to the start of the buffer (before the data copy in point)
-                // unless the buffer already starts at or below the base
-                // if we do a copy, the 1st free location is always base addr
-                //
-                ResidueBytes = IQHeadPtr[DDC] - IQReadPtr[DDC];
-                //		printf("Residue = %d bytes\n",ResidueBytes);
-                if (IQReadPtr[DDC] > IQBasePtr[DDC])                                // move data down
-                {
-                    if (ResidueBytes != 0) 		// if there is residue to move
-                    {
-                        memcpy(IQBasePtr[DDC] - ResidueBytes, IQReadPtr[DDC], ResidueBytes);
-                        IQReadPtr[DDC] = IQBasePtr[DDC] - ResidueBytes;
-                    }
-                    else
-                        IQReadPtr[DDC] = IQBasePtr[DDC];
-                    IQHeadPtr[DDC] = IQBasePtr[DDC];                            // ready for new data at base
-                }
-            }
+            if(__atomic_load_n(&DDCSendError, __ATOMIC_ACQUIRE))    // a sender thread couldn't send
+                InitError = true;
             //
-            // P2 packet sending complete.There are no DDC buffers with enough data to send out.
+            // The sender threads send the P2 packets.
             // bring in more data by DMA if there is some, else sleep for a while and try again
             // we have the same issue with DMA: a transfer isn't exactly aligned to the amount we can read out 
             // according to the DDC settings. So we either need to have the part-used DDC transfer variables
@@ -450,87 +974,197 @@ void *OutgoingDDCIQ(void *arg)
             // and copy it like we do with IQ data so the next readout begins at a new frame
             // the latter approach seems easier!
             //
-            Depth = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
-
-            if((StartupCount == 0) && FIFOOverThreshold)
+            // the streaming ring doesn't use the FIFO depth, and reports its own overruns
+            //
+            if(!DDCStreamRing)
             {
-                pthread_mutex_lock(&g_fifo_overflow_mutex);
-                GlobalFIFOOverflows |= 0b00000001;
-                pthread_mutex_unlock(&g_fifo_overflow_mutex);
-                if(UseDebug)
-                    printf("RX DDC FIFO Overthreshold, depth now = %d\n", Current);
+                Depth = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
+
+                //
+                // over threshold is the wakeup depth (see below), so overflow is reported from the FIFO flag
+                //
+                if((StartupCount == 0) && FIFOOverflow)
+                {
+                    pthread_mutex_lock(&g_fifo_overflow_mutex);
+                    GlobalFIFOOverflows |= 0b00000001;
+                    pthread_mutex_unlock(&g_fifo_overflow_mutex);
+                    if(UseDebug)
+                        printf("RX DDC FIFO Overflow, depth now = %d\n", Current);
+                }
             }
 // note this could often generate a message at low sample rate because we deliberately read it down to zero.
 // this isn't a problem as we can send the data on without the code becoming blocked. so not a useful trap.
 //            if((StartupCount == 0) && FIFOUnderflow)
 //                 printf("RX DDC FIFO Underflowed, depth now = %d\n", Current);
             //		printf("read: depth = %d\n", Depth);
-            while(Depth < (DMATransferSize/8U))			// 8 bytes per location
+            if(DDCStreamRing)
             {
-                usleep(500);								// 1ms wait
-                Depth = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
-                if((StartupCount == 0) && FIFOOverThreshold)
+                //
+                // streaming ring: wait for filled blocks. If the driver has overwritten
+                // unread blocks, the ring restarts empty so find the next header again.
+                //
+                Result = DMAStreamWait(&DDCStream, VFIFOEVENTTIMEOUT);
+                if(Result == 0)
+                    continue;
+                if(Result == -EOVERFLOW)
                 {
-                    pthread_mutex_lock(&g_fifo_overflow_mutex);
-                    GlobalFIFOOverflows |= 0b00000001;
-                    pthread_mutex_unlock(&g_fifo_overflow_mutex);
+                    HeaderFound = false;
+                    for (DDC = 0; DDC < VNUMDDC; DDC++)
+                        SlotFillBytes[DDC] = 0;
+                    DDCResyncCount++;
                     if(UseDebug)
-                        printf("RX DDC FIFO Overthreshold, depth now = %d\n", Current);
+                        printf("DDC streaming ring overrun: resync\n");
+                    continue;
+                }
+                if(Result < 0)
+                {
+                    printf("DDC streaming ring error %d\n", Result);
+                    InitError = true;
+                    break;
+                }
+                clock_gettime(CLOCK_MONOTONIC, &DMAEnd);
+            }
+            else if(DDCAsyncDMABuffers != 0)
+            {
+                //
+                // overlapped DMA: collect the next DMA, then re-use its buffer at once
+                // so the DMAs in flight stay the same while this one is decoded
+                //
+                Result = AsyncDMAReadWait(&DDCAsyncReader);
+                if(Result != (int)AsyncRegion)
+                {
+                    printf("overlapped DDC DMA error, buffer %d returned %d\n", AsyncRegion, Result);
+                    InitError = true;
+                    break;
                 }
-//                if((StartupCount == 0) && FIFOUnderflow)
-//                    printf("RX DDC FIFO Underflowed, depth now = %d\n", Current);
-             }
-//            printf("DDC DMA read %d bytes from destination to base\n", DMATransferSize);
-            if(Depth > 4096)
-                DMATransferSize = 32768;
-            else if(Depth > 2048)
-                DMATransferSize = 16384;
-            else if(Depth > 1024)
-                DMATransferSize = 8192;
+                clock_gettime(CLOCK_MONOTONIC, &DMAEnd);
+                RingBufferCommit(&DMARing, AsyncLength[AsyncRegion]);
+                AsyncPendingBytes -= AsyncLength[AsyncRegion];
+                AsyncRegion = (AsyncRegion + 1) % DDCAsyncDMABuffers;
+                if(AsyncDDCSubmit(&DMARing, Depth) != 0)
+                {
+                    InitError = true;
+                    break;
+                }
+            }
             else
-                DMATransferSize = 4096;
-
-            DMAReadFromFPGA(IQReadfile_fd, DMAHeadPtr, DMATransferSize, VADDRDDCSTREAMREAD);
-            DMAHeadPtr += DMATransferSize;
-            //
-            // find header: may not be the 1st word
-            //
-//            DumpMemoryBuffer(DMAReadPtr, DMATransferSize);
-            if(HeaderFound == false)                                                    // 1st time: look for header
-                for(Cntr=16; Cntr < (DMAHeadPtr - DMAReadPtr); Cntr+=8)                  // search for rate word; ignoring 1st
+            {
+                //
+                // the FIFO monitor threshold is the depth we want to wake at, so the interrupt
+                // arrives when there is enough to read. The FPGA also raises it for underflow,
+                // which latches again every time we read the FIFO empty: an interrupt that
+                // wasn't over threshold is followed by a timed sleep, not another interrupt wait.
+                //
+                WakeDepth = (DDCLatencyTarget != 0) ? DDCDMAControl.Threshold : (DMATransferSize/8U);     // 8 bytes per location
+                if(FIFOEvent_fd >= 0)
+                    SetFIFOMonitorThreshold(eRXDDCDMA, WakeDepth, true);
+                while(Depth < WakeDepth)
                 {
-                    if(*(DMAReadPtr + Cntr + 7) == 0x80)
+                    WakeupUs = (DDCLatencyTarget != 0) ? DMAControllerWakeupUs(&DDCDMAControl, Depth) : 500;
+                    if((FIFOEvent_fd >= 0) && !FIFOEventSpurious)   // wait for interrupt, or timeout
                     {
-//                        printf("found header at offset=%x\n", Cntr);
-                        HeaderFound = true;
-                        DMAReadPtr += Cntr;                                             // point read buffer where header is 
-                        break;
+                        Result = WaitFIFOMonitorEvent(FIFOEvent_fd, VFIFOEVENTTIMEOUT);
+                        Depth = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);
+                        if(Result > 0)
+                        {
+                            if(FIFOOverThreshold)
+                                FIFOEventCount++;
+                            else
+                                FIFOEventSpurious = true;
+                        }
+                        else if((FIFOEventCount == 0) && (++FIFOEventTimeouts >= VFIFOEVENTFALLBACK))
+                        {
+                            printf("no DDC FIFO interrupt from firmware; reverting to polling\n");
+                            close(FIFOEvent_fd);
+                            FIFOEvent_fd = -1;
+                            SetupFIFOMonitorChannel(eRXDDCDMA, false);
+                        }
+                    }
+                    else
+                    {
+                        usleep(WakeupUs);						// 0.5ms wait, or as set by size controller
+                        FIFOEventSpurious = false;
+                        Depth = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
+                    }
+                    if((StartupCount == 0) && FIFOOverflow)
+                    {
+                        pthread_mutex_lock(&g_fifo_overflow_mutex);
+                        GlobalFIFOOverflows |= 0b00000001;
+                        pthread_mutex_unlock(&g_fifo_overflow_mutex);
+                        if(UseDebug)
+                            printf("RX DDC FIFO Overflow, depth now = %d\n", Current);
                     }
+    //                if((StartupCount == 0) && FIFOUnderflow)
+    //                    printf("RX DDC FIFO Underflowed, depth now = %d\n", Current);
+                 }
+    //            printf("DDC DMA read %d bytes from destination to base\n", DMATransferSize);
+                if(DDCLatencyTarget != 0)
+                {
+                    //
+                    // latency targeted: re-plan with the current depth.
+                    // this also sets the threshold for the next wait.
+                    //
+                    DMATransferSize = DMAControllerChooseSize(&DDCDMAControl, Depth);
                 }
-            if (HeaderFound == false)                                        // if rate flag not set
-            {
-//                printf("Rate word not found when expected. rate= %08x\n", RateWord);
-                InitError = true;
-                exit(1);
+                else if(Depth > 4096)
+                    DMATransferSize = 32768;
+                else if(Depth > 2048)
+                    DMATransferSize = 16384;
+                else if(Depth > 1024)
+                    DMATransferSize = 8192;
+                else
+                    DMATransferSize = 4096;
+
+                clock_gettime(CLOCK_MONOTONIC, &DMAStart);
+                DMAReadFromFPGA(IQReadfile_fd, RingBufferWritePtr(&DMARing), DMATransferSize, VADDRDDCSTREAMREAD);
+                clock_gettime(CLOCK_MONOTONIC, &DMAEnd);
+                RingBufferCommit(&DMARing, DMATransferSize);
+                if(DDCLatencyTarget != 0)
+                    DMAControllerRecord(&DDCDMAControl, Depth, DMATransferSize,
+                                        (DMAEnd.tv_sec - DMAStart.tv_sec) * 1000000000L + (DMAEnd.tv_nsec - DMAStart.tv_nsec));
             }
+            DDCDMACompleteNs = (uint64_t)DMAEnd.tv_sec * 1000000000ULL + DMAEnd.tv_nsec;
+            DMAReadPtr = RingBufferReadPtr(Ring);
+            DMAHeadPtr = DMAReadPtr + Ring->Fill;
+            //
+            // find header: may not be the 1st word
+            //
+//            DumpMemoryBuffer(DMAReadPtr, DMATransferSize);
+            // 1st time: look for header, ignoring 1st 2 words. If there isn't one
+            // the data is dropped and we look again after the next DMA.
+            //
+            if(HeaderFound == false)
+                HeaderFound = FindDDCHeader(&DMAReadPtr, DMAHeadPtr, 16);
 
 
             //
             // finally copy data to DMA buffers according to the embedded DDC rate words
             // the 1st word is pointed by DMAReadPtr and it should point to a DDC rate word
-            // search for it if not!
             // (it should always be left in that state).
+            // if not, framing has been lost: resynchronise to the next rate word.
             // the top half of the 1st 64 bit word should be 0x8000
             // and that is located in the 2nd 32 bit location.
             // assume that DMA is > 1 frame.
 //            printf("headptr = %x readptr = %x\n", DMAHeadPtr, DMAReadPtr);
             DecodeByteCount = DMAHeadPtr - DMAReadPtr;
-            while (DecodeByteCount >= 16)                       // minimum size to try!
+            while (HeaderFound && (DecodeByteCount >= 16))      // minimum size to try!
             {
                 if(*(DMAReadPtr + 7) != 0x80)
                 {
-                    printf("header not found for rate word at addr %lx\n", (uint64_t)DMAReadPtr);
-                    exit(1);
+                    //
+                    // resync: part filled packets are dropped, so every DDC starts a new packet
+                    // at the next good frame. Frames skipped are estimated from the bytes
+                    // dropped, to keep the timestamps close.
+                    //
+                    SrcPtr = DMAReadPtr;
+                    HeaderFound = FindDDCHeader(&DMAReadPtr, DMAHeadPtr, 8);
+                    DDCFrameCount += (DMAReadPtr - SrcPtr) / ((FrameLength + 1) * 8);
+                    DecodeByteCount = DMAHeadPtr - DMAReadPtr;
+                    for (DDC = 0; DDC < VNUMDDC; DDC++)
+                        SlotFillBytes[DDC] = 0;
+                    DDCResyncCount++;
+                    if(UseDebug)                                                        // total is reported at end of run
+                        printf("DDC stream framing lost: resync, %ld bytes dropped\n", (long)(DMAReadPtr - SrcPtr));
                 }
                 else                                                                    // analyse word, then process
                 {
@@ -540,32 +1174,23 @@ void *OutgoingDDCIQ(void *arg)
                     if (RateWord != PrevRateWord)
                     {
                         FrameLength = AnalyseDDCHeader(RateWord, &DDCCounts[0]);           // read new settings
+                        DMAControllerSetRate(&DDCDMAControl, FrameLength);
 //                        printf("new framelength = %d\n", FrameLength);
                         PrevRateWord = RateWord;                                        // so so we know its analysed
                     }
                     if (DecodeByteCount >= ((FrameLength+1) * 8))             // if bytes for header & frame
                     {
-                        //THEN COPY DMA DATA TO I / Q BUFFERS
+                        //THEN DEMULTIPLEX DMA DATA INTO THE DDC PACKET SLOTS
                         DMAReadPtr += 8;                                                // point to 1st location past rate word
-                        SrcWordPtr = (uint16_t*)DMAReadPtr;                             // read sample data in 16 bit chunks
+                        SrcPtr = DMAReadPtr;                                            // 1st sample word
                         for (DDC = 0; DDC < VNUMDDC; DDC++)
                         {
                             HdrWord = DDCCounts[DDC];                                   // number of words for this DDC. reuse variable
                             if (HdrWord != 0)
-                            {
-                                DestWordPtr = (uint16_t *)IQHeadPtr[DDC];
-                                for (Cntr = 0; Cntr < HdrWord; Cntr++)                  // count 64 bit words
-                                {
-                                    *DestWordPtr++ = *SrcWordPtr++;                     // move 48 bits of sample data
-                                    *DestWordPtr++ = *SrcWordPtr++;
-                                    *DestWordPtr++ = *SrcWordPtr++;
-                                    SrcWordPtr++;                                       // and skip 16 bits where theres no data
-                                }
-                                IQHeadPtr[DDC] += 6 * HdrWord;                          // 6 bytes per sample
-                            }
-                            // read N samples; write at head ptr
+                                SrcPtr = DemuxDDCSamples(DDC, SrcPtr, HdrWord);
                         }
                         DMAReadPtr += FrameLength * 8;                                  // that's how many bytes we read out
+                        DDCFrameCount++;
                         DecodeByteCount -= (FrameLength+1) * 8;
                     }
                     else
@@ -573,32 +1198,108 @@ void *OutgoingDDCIQ(void *arg)
                 }
             }
             //
-            // now copy any residue to the start of the buffer (before the data copy in point)
-            // unless the buffer already starts at or below the base
-            // if we do a copy, the 1st free location is always base addr
+            // wake the sender threads for DDCs that have new packets
+            //
+            for (Sender = 0; Sender < NumDDCSenders; Sender++)
+                if (DDCSlotsFilled & DDCSenders[Sender].DDCMask)
+                    sem_post(&DDCSenders[Sender].PacketsReady);
+            DDCSlotsFilled = 0;
+            if(StartupCount > DDCPacketsMade)                   // decrement startup message count
+                StartupCount -= DDCPacketsMade;
+            else
+                StartupCount = 0;
+            DDCPacketsMade = 0;
+
             //
-            ResidueBytes = DMAHeadPtr - DMAReadPtr;
-            //		printf("Residue = %d bytes\n",ResidueBytes);
-            if (DMAReadPtr > DMABasePtr)                                // move data down
+            // remove the decoded data from the ring. Any part frame left over stays in place.
+            // overlapped DMA: a buffer whose DMA couldn't fit before the decode is submitted now
+            // streaming ring: hand the blocks decoded back to the driver
+            //
+            RingBufferConsume(Ring, DMAReadPtr - RingBufferReadPtr(Ring));
+            if(DDCStreamRing)
+                DMAStreamRelease(&DDCStream);
+            else if(DDCAsyncDMABuffers != 0)
             {
-                if (ResidueBytes != 0) 		// if there is residue to move
-                {
-                    memcpy(DMABasePtr - ResidueBytes, DMAReadPtr, ResidueBytes);
-                    DMAReadPtr = DMABasePtr - ResidueBytes;
-                }
-                else
-                    DMAReadPtr = DMABasePtr;
-                DMAHeadPtr = DMABasePtr;                            // ready for new data at base
+                if(AsyncDDCSubmit(&DMARing, Depth) != 0)
+                    InitError = true;
             }
         }     // end of while(!InitError) loop
+        if(DDCStreamRing)
+        {
+            if(UseDebug)
+                printf("DDC streaming ring: %d overruns\n", DDCStream.Control->Overruns);
+            DMAStreamClose(&DDCStream);
+        }
+
+        if(UseDebug && (DDCResyncCount != 0))
+            printf("DDC stream resynchronised %d times\n", DDCResyncCount);
+
+        //
+        // report DMA to wire latency for each DDC that sent packets
+        //
+        if(UseDebug)
+            for (DDC = 0; DDC < VNUMDDC; DDC++)
+            {
+                for (Slot = 0; Slot < VLATENCYBUCKETS; Slot++)
+                    if (DDCLatencyHistogram[DDC][Slot] != 0)
+                        break;
+                if (Slot == VLATENCYBUCKETS)
+                    continue;
+                printf("DDC%d DMA to wire latency (<us: packets):", DDC);
+                for (Slot = 0; Slot < VLATENCYBUCKETS; Slot++)
+                    if (DDCLatencyHistogram[DDC][Slot] != 0)
+                        printf(" %d:%d", 2 << Slot, DDCLatencyHistogram[DDC][Slot]);
+                printf("\n");
+            }
+
+        //
+        // report the latency achieved by the DMA size controller
+        //
+        if((DDCLatencyTarget != 0) && (DDCAsyncDMABuffers == 0) && (DDCDMAControl.LatencyCount != 0))
+            printf("DDC DMA latency: target %dus, mean %dus, max %dus; last DMA size %d\n", DDCLatencyTarget,
+                   (uint32_t)(DDCDMAControl.LatencyTotalNs / DDCDMAControl.LatencyCount / 1000),
+                   DDCDMAControl.LatencyMaxNs / 1000, DMATransferSize);
+
+        //
+        // overlapped DMA: collect and discard any DMAs still in flight, and report
+        // how well DMA was overlapped with decoding
+        //
+        if(DDCAsyncDMABuffers != 0)
+        {
+            while((DDCAsyncReader.InFlight != 0) && (AsyncDMAReadWait(&DDCAsyncReader) >= 0))
+                ;
+            if(UseDebug)
+                printf("DDC overlapped DMA efficiency = %4.1f%%, %4.1f%% of DMAs complete before needed\n",
+                       AsyncDMAOverlapEfficiency(&DDCAsyncReader, &ReadyPercent), ReadyPercent);
+        }
     }
 
 //
 // tidy shutdown of the thread
 //
     printf("shutting down DDC outgoing thread\n");
+    if(DDCAsyncDMABuffers != 0)
+        AsyncDMAReadClose(&DDCAsyncReader);
+    if(FIFOEvent_fd >= 0)
+        close(FIFOEvent_fd);
+    __atomic_store_n(&DDCSendersExit, true, __ATOMIC_RELEASE);
+    for (Sender = 0; Sender < NumDDCSenders; Sender++)
+    {
+        sem_post(&DDCSenders[Sender].PacketsReady);
+        pthread_join(DDCSenders[Sender].Thread, NULL);
+        sem_destroy(&DDCSenders[Sender].PacketsReady);
+        if(UseDebug)
+        {
+            printf("DDC sender %d sendmmsg batches (packets: count):", Sender);
+            for (Slot = 1; Slot <= VDDCSLOTS; Slot++)
+                if (DDCSenders[Sender].BatchHistogram[Slot] != 0)
+                    printf(" %d:%d", Slot, DDCSenders[Sender].BatchHistogram[Slot]);
+            printf("\n");
+        }
+    }
     close(ThreadData->Socketid); 
     ThreadData->Active = false;                   // signal closed
+    DMAUnregisterBuffer(IQReadfile_fd, DMARing.Base);
     FreeDynamicMemory();
     return NULL;
 }
@@ -23,6 +23,14 @@
 
 
 #define VDDCPACKETSIZE 1444             // each DDC I/Qpacket
+#define VDEFAULTDDCBATCH 16             // default max DDC packets sent per sendmmsg() call
+#define VMAXDDCSENDERS 4                // max DDC packet sender threads
+
+
+extern uint32_t DDCSendBatchLimit;      // max DDC packets sent per sendmmsg() call (-b option)
+extern uint32_t DDCLatencyTarget;       // DDC DMA latency target in us, 0 = fixed DMA size ladder (-l option)
+extern uint32_t DDCAsyncDMABuffers;     // overlapped DDC DMA buffer count, 0 = not overlapped (-o option)
+extern bool DDCStreamRing;              // true to read DDC data from a kernel streaming ring (-r option)
 
 
 //
@@ -31,6 +39,21 @@
 void *OutgoingDDCIQ(void *arg);
 
 
+//
+// set the DDC to packet sender thread mapping from a command line string (-t option)
+// one group per thread separated by "/"; each group is a DDC or DDC range, optionally
+// followed by ":" and the CPU to run that thread on. eg "0-4:2/5-9:3"
+// returns true if error
+//
+bool SetDDCSenderMapping(char* Spec);
+
+
+//
+// set the CPU for the DDC DMA thread (-c option)
+//
+void SetDDCDMAThreadCPU(int CPU);
+
+
 //
 // interface calls to get commands from PC settings
 //
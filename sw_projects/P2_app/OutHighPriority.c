@@ -59,9 +59,12 @@ void *OutgoingHighPriority(void *arg)
   int Error;
   uint8_t Byte;                                   // data being encoded
   uint16_t Word;                                  // data being encoded
-  unsigned int FIFOCount;
   bool ATUTuneRequest = false;
-  bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;      // FIFO flags
+  bool FIFOOverflow[4], FIFOUnderflow[4], FIFOOverThreshold[4];      // FIFO flags for each monitored FIFO
+  unsigned int FIFOCounts[4];
+  uint32_t FIFOResults[4];
+  EDMAStreamSelect FIFOChannels[4] = {eRXDDCDMA, eMicCodecDMA, eTXDUCDMA, eSpkCodecDMA};
+  unsigned int AnalogueIn[VNUMANALOGUEIN];                  // RF board analogue inputs
   uint8_t FIFOOverflows;
   uint8_t ADCOverflows = 0;                       // set non zero if ADC overflows detected
   uint16_t ADC1MaxAmpl;                           // max ADC amplitude in period where overflows clecked
@@ -142,18 +145,19 @@ void *OutgoingHighPriority(void *arg)
       wr_be_u16(UDPBuffer+41, PeakADC2MaxAmpl);         // ADC2 peak hold
       PeakADC2MaxAmpl = 0;
 
-      Word = (uint16_t)GetAnalogueIn(4);
+      GetAnalogueInputs(AnalogueIn);                    // read all 6 in one go
+      Word = (uint16_t)AnalogueIn[4];
       wr_be_u16(UDPBuffer+6, Word);                     // exciter power
-      Word = (uint16_t)GetAnalogueIn(0);
+      Word = (uint16_t)AnalogueIn[0];
       wr_be_u16(UDPBuffer+14, Word);                    // forward power
-      Word = (uint16_t)GetAnalogueIn(1);
+      Word = (uint16_t)AnalogueIn[1];
       wr_be_u16(UDPBuffer+22, Word);                    // reverse power
-      Word = (uint16_t)GetAnalogueIn(5);
+      Word = (uint16_t)AnalogueIn[5];
       wr_be_u16(UDPBuffer+49, Word);                    // supply voltage
 
-      Word = (uint16_t)GetAnalogueIn(2);
+      Word = (uint16_t)AnalogueIn[2];
       wr_be_u16(UDPBuffer+57, Word);                    // AIN3 user_analog1
-      Word = (uint16_t)GetAnalogueIn(3);
+      Word = (uint16_t)AnalogueIn[3];
       wr_be_u16(UDPBuffer+55, Word);                    // AIN4 user_analog2
 
       Byte = (uint8_t)GetUserIOBits();                  // user I/O bits
@@ -165,28 +169,21 @@ void *OutgoingHighPriority(void *arg)
 // and they are cleared by the data transfer reads of the monitor channel
 //
       FIFOOverflows = 0;
-      ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &FIFOCount);				// read the DDC FIFO Depth register
-      wr_be_u16(UDPBuffer+31, FIFOCount);                       // DDC samples
-      if(FIFOOverThreshold)
+      ReadFIFOMonitorChannels(4, FIFOChannels, FIFOOverflow, FIFOOverThreshold, FIFOUnderflow, FIFOCounts, FIFOResults);	// read DDC, mic, DUC & speaker FIFO Depth registers
+      wr_be_u16(UDPBuffer+31, FIFOCounts[0]);                   // DDC samples
+      if(FIFOOverThreshold[0])
         FIFOOverflows |= 0b00000001;
 
-      ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &FIFOCount);				// read the mic FIFO Depth register
-
-      Word = Word*4;                                            // 4 samples per FIFO location
-      wr_be_u16(UDPBuffer+33, FIFOCount);                       // mic samples
-      if(FIFOOverThreshold)
+      wr_be_u16(UDPBuffer+33, FIFOCounts[1]);                   // mic samples
+      if(FIFOOverThreshold[1])
         FIFOOverflows |= 0b00000010;
 
-      ReadFIFOMonitorChannel(eTXDUCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &FIFOCount);				// read the DUC FIFO Depth register
-      Word = (Word*4)/3;                                        // 4/3 samples per FIFO location
-      wr_be_u16(UDPBuffer+35, FIFOCount);                       // DUC samples
-      if(FIFOUnderflow)
+      wr_be_u16(UDPBuffer+35, FIFOCounts[2]);                   // DUC samples
+      if(FIFOUnderflow[2])
         FIFOOverflows |= 0b00000100;
 
-      ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &FIFOCount);				// read the speaker FIFO Depth register
-      Word = Word*2;                                            // 2 samples per FIFO location
-      wr_be_u16(UDPBuffer+37, FIFOCount);                       // speaker samples
-      if(FIFOUnderflow)
+      wr_be_u16(UDPBuffer+37, FIFOCounts[3]);                   // speaker samples
+      if(FIFOUnderflow[3])
         FIFOOverflows |= 0b00001000;
 
       pthread_mutex_lock(&g_fifo_overflow_mutex);
@@ -110,6 +110,8 @@ void *OutgoingMicSamples(void *arg)
         printf("XDMA read device open failed for mic data\n");
         InitError = true;
     }
+    else
+        DMARegisterBuffer(DMAReadfile_fd, MicReadBuffer, MicBufferSize);    // pin once, not per read
 
   //
   // now initialise Saturn hardware.
@@ -219,6 +221,7 @@ void *OutgoingMicSamples(void *arg)
       ThreadError = true;
 
     printf("shutting down outgoing mic data thread\n");
+    DMAUnregisterBuffer(DMAReadfile_fd, MicReadBuffer);
     close(ThreadData->Socketid); 
     ThreadData->Active = false;                   // signal closed
     return NULL;
@@ -27,15 +27,18 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <syscall.h>
+#include <time.h>
 #include "../common/saturnregisters.h"
 #include "../common/hwaccess.h"
 #include "../common/debugaids.h"
+#include "Outwideband.h"
 
 
 //
 // global holding the current step of C&C data. Each new USB frame updates this.
 //
-#define VDMABUFFERSIZE 65536						            // memory buffer to reserve (2x wideband FIFO size)
+#define VDMABUFFERSIZE 65536						            // memory buffer to reserve per capture (2x wideband FIFO size)
+#define VWBCAPTURESPERADC 2                         // captures held per ADC: one being sent while the next is read
 #define VALIGNMENT 4096                             // buffer alignment
 
 #define VWBPACKETSIZE 1500                          // packet size is a variable, sp make max for UDP
@@ -43,12 +46,28 @@
 #define VWBBYTESPERFRAME 2*VWBSAMPLESPERFRAME       // total bytes in one outgoing frame
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
 #define VNUMWBADC 2                                 // number of ADC that WB data can be collected for
+#define VWBLINKSHARE 40                             // percentage of the link rate wideband data may use
+#define VDEFAULTLINKMBPS 100                        // link rate if not known
+#define VWBPACERBURST (8 * VWBPACKETSIZE)           // bytes that can be sent back to back
+#define VWBCAPTUREBUFFERS (VNUMWBADC * VWBCAPTURESPERADC)
+#define VWBIDLEPOLLUS 5000                          // wait between checks for a new capture when none being sent (us)
+#define VWBMAXWAITUS 1000                           // longest pacer wait, so the FIFO is checked between packets (us)
+#define VWBMINWAITUS 20                             // shortest pacer wait (us)
 
 
 //
 // define the memory buffers:
+// each capture read from the FIFO goes to a free buffer for its ADC, and is sent out from there
 //
-uint8_t* WBDMAReadBuffer = NULL;								// data for DMA read from DDC
+struct WBCapture
+{
+    uint8_t* Buffer;                                            // data for DMA read from wideband FIFO
+    int ADC;                                                    // ADC recorded
+    uint32_t PacketsSent;                                       // packets sent so far; also sequence number
+    uint32_t Order;                                             // capture number, to send oldest first
+    bool Full;                                                  // true from FIFO read until all sent
+};
+struct WBCapture WBCaptures[VWBCAPTUREBUFFERS];
 uint32_t WBDMABufferSize = VDMABUFFERSIZE;
 
 uint8_t* WBUDPBuffer[VNUMDDC];                                  // DDC frame buffer
@@ -65,6 +84,14 @@ uint8_t StoredSampleSize;                                       // sample resolu
 uint8_t StoredRate;                                             // update rate in ms
 uint8_t StoredPacketCount;                                      // packets to be transferred out
 
+//
+// token bucket pacer for outgoing packets
+// tokens are bytes; they accumulate at WBPacerRate up to VWBPACERBURST
+//
+uint64_t WBPacerRate = (uint64_t)VDEFAULTLINKMBPS * 1000000 / 8 * VWBLINKSHARE / 100;    // bytes per second
+uint64_t WBPacerTokens;                                         // bytes that can be sent now
+uint64_t WBPacerTime;                                           // time tokens last added (ns)
+
 
 
 //
@@ -73,17 +100,23 @@ uint8_t StoredPacketCount;                                      // packets to be
 bool CreateWBDynamicMemory(void)                              // return true if error
 {
     uint32_t ADC;
+    uint32_t Cntr;
     bool Result = false;
 //
-// first create the buffer for DMA, and initialise its pointers
+// first create the buffers for DMA, and initialise their pointers
 //
-    posix_memalign((void**)&WBDMAReadBuffer, VALIGNMENT, WBDMABufferSize);
-    if (!WBDMAReadBuffer)
+    for (Cntr = 0; Cntr < VWBCAPTUREBUFFERS; Cntr++)
     {
-        printf("Wideband read buffer allocation failed\n");
-        Result = true;
+        posix_memalign((void**)&WBCaptures[Cntr].Buffer, VALIGNMENT, WBDMABufferSize);
+        if (!WBCaptures[Cntr].Buffer)
+        {
+            printf("Wideband read buffer allocation failed\n");
+            Result = true;
+            continue;
+        }
+        memset(WBCaptures[Cntr].Buffer, 0, WBDMABufferSize);
+        WBCaptures[Cntr].Full = false;
     }
-    memset(WBDMAReadBuffer, 0, WBDMABufferSize);
 
     //
     // set up per-Wideband ADC data structures
@@ -99,8 +132,10 @@ bool CreateWBDynamicMemory(void)                              // return true if
 void FreeWBDynamicMemory(void)
 {
     uint32_t ADC;
+    uint32_t Cntr;
 
-    free(WBDMAReadBuffer);
+    for (Cntr = 0; Cntr < VWBCAPTUREBUFFERS; Cntr++)
+        free(WBCaptures[Cntr].Buffer);
     //
     // free the per-DDC buffers
     //
@@ -135,21 +170,106 @@ void SetWidebandParams(uint8_t Enables, uint16_t SampleCount, uint8_t SampleSize
 
 
 //
-// read out the Wideband FIFO
+// set the pacer rate from the ethernet link speed
+//
+void SetWidebandLinkSpeed(uint32_t Mbps)
+{
+    if(Mbps == 0)
+        Mbps = VDEFAULTLINKMBPS;
+    WBPacerRate = (uint64_t)Mbps * 1000000 / 8 * VWBLINKSHARE / 100;
+    printf("Wideband data paced to %d%% of %dMbps link\n", VWBLINKSHARE, Mbps);
+}
+
+
+//
+// get a monotonic time in ns
+//
+static uint64_t WBTimeNow(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+//
+// add pacer tokens for the time since the last call
+//
+static void WBPacerRefill(void)
+{
+    uint64_t Now, Elapsed;
+
+    Now = WBTimeNow();
+    Elapsed = Now - WBPacerTime;
+    if(Elapsed > 1000000000ULL)                         // (limit to 1s so no overflow)
+        Elapsed = 1000000000ULL;
+    WBPacerTokens += Elapsed * WBPacerRate / 1000000000ULL;
+    if(WBPacerTokens > VWBPACERBURST)
+        WBPacerTokens = VWBPACERBURST;
+    WBPacerTime = Now;
+}
+
+
+//
+// time in us until the pacer will have Bytes tokens
+//
+static uint32_t WBPacerWait(uint32_t Bytes)
+{
+    uint64_t Wait;
+
+    if(WBPacerTokens >= Bytes)
+        return 0;
+    Wait = (Bytes - WBPacerTokens) * 1000000ULL / WBPacerRate;
+    if(Wait < VWBMINWAITUS)
+        Wait = VWBMINWAITUS;
+    if(Wait > VWBMAXWAITUS)
+        Wait = VWBMAXWAITUS;
+    return (uint32_t)Wait;
+}
+
+
+//
+// find a capture buffer for an ADC: the oldest full one if Full, else a free one
+// buffers Cntr*VNUMWBADC + ADC belong to each ADC
+// returns NULL if none
+//
+static struct WBCapture* WBFindCapture(int ADC, bool Full)
+{
+    int Cntr;
+    struct WBCapture* Capture;
+    struct WBCapture* Found = NULL;
+
+    for (Cntr = 0; Cntr < VWBCAPTURESPERADC; Cntr++)
+    {
+        Capture = &WBCaptures[Cntr * VNUMWBADC + ADC];
+        if(Capture->Full == Full)
+            if((Found == NULL) || (Full && ((int32_t)(Capture->Order - Found->Order) < 0)))
+                Found = Capture;
+    }
+    return Found;
+}
+
+
+//
+// read out the Wideband FIFO into Buffer, up to MaxWords 64 bit words
 // returns the number of samples read
 // read available word count, then do DMA to memory buffer
+// the DMA mutex is only held for this one read, so the mic thread can run between reads
 //
-uint32_t ReadFIFOContent()
+uint32_t ReadFIFOContent(uint8_t* Buffer, uint32_t MaxWords)
 {
     uint32_t SampleCount = 0;
     uint32_t WordCount = 0;                             // count of 64 bit words in the FIFO
     bool ADC1, ADC2;
 
     WordCount = GetWidebandStatus(&ADC1, &ADC2);
+    if(WordCount > MaxWords)
+        WordCount = MaxWords;
     if(WordCount != 0)
     {
         sem_wait(&MicWBDMAMutex);                       // get protected access
-        DMAReadFromFPGA(DMAReadfile_fd, WBDMAReadBuffer, WordCount * 8, VADDRWIDEBANDREAD);
+        DMAReadFromFPGA(DMAReadfile_fd, Buffer, WordCount * 8, VADDRWIDEBANDREAD);
         sem_post(&MicWBDMAMutex);                       // get protected access
         SampleCount = WordCount * 4;
 //        printf("word count in readFIFOContent = %d\n", WordCount);
@@ -160,14 +280,19 @@ uint32_t ReadFIFOContent()
 
 //
 // strategy:
-// 1. We have one DMA buffer, big enough for the largest DMA from the wideband FIFO
+// 1. We have VWBCAPTURESPERADC DMA buffers per ADC, each big enough for the largest DMA from the wideband FIFO
 // 2. On startup: turn off the IP and clear the FIFO if any data in it. 
 // 3. when the wideband settings change: stop operation; clear FIFO; setup new settings & restart if still enabled
 // 4. wideband IP started; it periodically writes defined sample count to FIFO
 // 5. When write complete, a status flag is set; one for each ADC
-// 6. when a flag is set, DMA out the data for that ADC then write the bit to say "data transferred"
-// 7. break data into N outgoing packets and send to Thetis over UDP
-// 8. Need to check if both ADCs are enabled, because more data will follow if so
+// 6. when a flag is set, and a capture buffer for that ADC is free, DMA out the data into it
+//    then write the bit to say "data transferred" at once, so the next capture can record.
+//    The IP records ADC0 then ADC1 in turn, waiting for each to be transferred, so the FIFO
+//    only ever holds one capture.
+// 7. break data into N outgoing packets and send to Thetis over UDP from the oldest full buffer,
+//    paced by a token bucket set from the link speed; the FIFO is checked again between packets
+// 8. Need to check if both ADCs are enabled, because more data will follow if so.
+//    packets for the two ADCs are interleaved so both panadapters update in the same cycle.
 // 9. when exiting: turn off the IP.
 //
 
@@ -187,10 +312,20 @@ void *OutgoingWidebandSamples(void *arg)
     bool InitError = false;                                     // becomes true if we get an initialisation error
     
     int ADC;                                                    // iterator
-    uint32_t SampleWordCount;                                   // no of 64 bit words required
+    uint32_t SampleWordCount = 0;                               // no of 64 bit words required
     bool ADC1, ADC2;                                            // true if data available
+    bool Available[VNUMWBADC];                                  // ADC1, ADC2 as array
     uint32_t PacketCounter;
     uint32_t StartAddress;                                      // data locations in wideband collected data
+    struct WBCapture* Capture;                                  // capture being read or sent
+    struct WBCapture* ReadCapture[VNUMWBADC];                   // captures to read to
+    int Cntr;
+    int SendADC = 0;                                            // ADC to send next packet for
+    bool Sent;                                                  // true if a packet sent this pass
+    bool ReadOK;
+    uint32_t CaptureCount = 0;                                  // captures read
+    uint32_t PacketBytes;                                       // outgoing packet length
+    uint32_t WaitTime;                                          // us to wait before next pass
     struct ThreadSocketData *ThreadData;                        // socket etc data for each thread.
                                                                 // points to 1st one
 //
@@ -199,7 +334,6 @@ void *OutgoingWidebandSamples(void *arg)
     struct sockaddr_in DestAddr[VNUMWBADC];                     // destination address for outgoing data
     struct iovec iovecinst[VNUMWBADC];                          // instance of iovec
     struct msghdr datagram[VNUMWBADC];
-    uint32_t SequenceCounter[VNUMWBADC];                        // UDP sequence count
     
 
 //
@@ -219,7 +353,6 @@ void *OutgoingWidebandSamples(void *arg)
     //
     for (ADC = 0; ADC < VNUMWBADC; ADC++)
     {
-        SequenceCounter[ADC] = 0;                           // clear UDP packet counter
         (ThreadData + ADC)->Active = true;                  // set outgoing socket active
     }
 
@@ -232,7 +365,7 @@ void *OutgoingWidebandSamples(void *arg)
 // 
     SetWidebandEnable(false, false, false);                 // turn off data collection
     usleep(150);                                            // wait dfor any current write to end
-    ReadFIFOContent();                                      // then empty the FIFO
+    ReadFIFOContent(WBCaptures[0].Buffer, VDMABUFFERSIZE / 8);   // then empty the FIFO
 
 //
 // thread loop. runs continuously until commanded by main loop to exit
@@ -258,7 +391,6 @@ void *OutgoingWidebandSamples(void *arg)
         //
         for (ADC = 0; ADC < VNUMWBADC; ADC++)
         {
-            SequenceCounter[ADC] = 0;
             memcpy(&DestAddr[ADC], &reply_addr, sizeof(struct sockaddr_in));           // local copy of PC destination address (reply_addr is global)
             memset(&iovecinst[ADC], 0, sizeof(struct iovec));
             memset(&datagram[ADC], 0, sizeof(struct msghdr));
@@ -285,7 +417,9 @@ void *OutgoingWidebandSamples(void *arg)
             {
                 SetWidebandEnable(false, false, false);                 // turn off data collection
                 usleep(150);                                            // wait for any current write to end
-                ReadFIFOContent();                                      // then empty the FIFO discarding data
+                ReadFIFOContent(WBCaptures[0].Buffer, VDMABUFFERSIZE / 8);  // then empty the FIFO discarding data
+                for (Cntr = 0; Cntr < VWBCAPTUREBUFFERS; Cntr++)        // and discard any unsent captures
+                    WBCaptures[Cntr].Full = false;
                 SampleWordCount = ((StoredSamplePerPktCount * StoredPacketCount) / 4) + 8;    // no. 64 bit words; over-read by 8 words
                 SetWidebandSampleCount(SampleWordCount);
                 SetWidebandUpdateRate(StoredRate);
@@ -295,48 +429,94 @@ void *OutgoingWidebandSamples(void *arg)
             }
 //
 // then if enabled:
-// using a while loop, wait for data to be available from the FPGA. 
-// When it is, read it and clear the IP "data available" flag
-// (strategy step 6)
-// then send out packets to SDR client
+// if capture buffers are free, see if data is available from the FPGA.
+// When it is, read it and clear the IP "data available" flag at once (strategy step 6)
+// then send out packets to SDR client from the oldest capture for each ADC in turn, as the pacer allows
 // recheck if parameters have changed after a successful ready
 //
+            WaitTime = VWBIDLEPOLLUS;                   // long wait unless a capture is being sent
             if(StoredEnables != 0)                      // if active
             {
                 GetWidebandStatus(&ADC1, &ADC2);      // get flags for data available
-                if(ADC1 || ADC2)                                        // if data available for either
+                Available[0] = ADC1;
+                Available[1] = ADC2;
+                ReadOK = ADC1 || ADC2;
+                for (ADC = 0; ADC < VNUMWBADC; ADC++)
                 {
-                    SampleWordCount = ReadFIFOContent();                // then read FIFO till empty
-//                    printf("WB data available, ADC sample count = %d\n", SampleWordCount);
+                    ReadCapture[ADC] = NULL;
+                    if(Available[ADC])
+                    {
+                        ReadCapture[ADC] = WBFindCapture(ADC, false);
+                        if(ReadCapture[ADC] == NULL)
+                            ReadOK = false;                     // no space: leave the data in the FIFO for now
+                    }
+                }
+                if(ReadOK)                                      // if data available, and somewhere to put it
+                {
+                    for (ADC = 0; ADC < VNUMWBADC; ADC++)
+                    {
+                        Capture = ReadCapture[ADC];
+                        if(Capture == NULL)
+                            continue;
+                        //
+                        // a short read (less than a whole capture) is discarded: the buffer
+                        // would otherwise be sent with stale data from its last capture
+                        //
+                        if(ReadFIFOContent(Capture->Buffer, VDMABUFFERSIZE / 8) < SampleWordCount * 4)    // read FIFO till empty
+                        {
+                            if(UseDebug)
+                                printf("Wideband ADC%d capture short read, discarded\n", ADC + 1);
+                            continue;
+                        }
+                        Capture->ADC = ADC;
+                        Capture->PacketsSent = 0;                       // sequence restarts at 0 for each frame
+                        Capture->Order = CaptureCount++;
+                        Capture->Full = true;
+                    }
                     SetWidebandEnable((bool)(StoredEnables&1), (bool)(StoredEnables&2), true);  // re-enable record
-                    //
-                    // now transfer data out on UDP packets
-                    // first select the buffer set yo use based on what data is available
-                    //
-                    if(ADC2)
-                        ADC=1;
-                    else
-                        ADC=0;
-                    SequenceCounter[ADC] = 0;                           // restart at 0 for each frame
-                    for(PacketCounter = 0; PacketCounter < StoredPacketCount; PacketCounter++)
+                }
+
+                //
+                // now transfer data out on UDP packets, as many as the pacer allows
+                // alternate between ADCs one packet at a time
+                //
+                PacketBytes = StoredSamplePerPktCount * 2 + 4;                      // P2 data dependent
+                WBPacerRefill();
+                do
+                {
+                    Sent = false;
+                    for (Cntr = 0; (Cntr < VNUMWBADC) && !Sent && (WBPacerTokens >= PacketBytes); Cntr++)
                     {
-                        *(uint32_t*)WBUDPBuffer[ADC] = htonl(SequenceCounter[ADC]++);     // add sequence count
+                        ADC = SendADC;
+                        SendADC = (SendADC + 1) % VNUMWBADC;
+                        Capture = WBFindCapture(ADC, true);
+                        if(Capture == NULL)
+                            continue;
+                        PacketCounter = Capture->PacketsSent++;
+                        *(uint32_t*)WBUDPBuffer[ADC] = htonl(PacketCounter);     // add sequence count
                         //
                         // now add I/Q data & send outgoing packet
                         //
                         StartAddress = (PacketCounter * StoredSamplePerPktCount * 2) + 32;   // byte address; inset 4 words into recording
-                        memcpy(WBUDPBuffer[ADC] + 4, WBDMAReadBuffer + StartAddress, StoredSamplePerPktCount * 2);
-                        iovecinst[ADC].iov_len = StoredSamplePerPktCount * 2 + 4;           // P2 data dependent
-
+                        memcpy(WBUDPBuffer[ADC] + 4, Capture->Buffer + StartAddress, StoredSamplePerPktCount * 2);
+                        iovecinst[ADC].iov_len = PacketBytes;
                         sendmsg((ThreadData+ADC)->Socketid, &datagram[ADC], 0);
-                        usleep(200);                    // gap between outgoing messages
+                        WBPacerTokens -= PacketBytes;
+                        if(Capture->PacketsSent >= StoredPacketCount)
+                            Capture->Full = false;                      // buffer free for the next capture
+                        Sent = true;
                     }
-                }
+                } while(Sent);
+                for (ADC = 0; ADC < VNUMWBADC; ADC++)
+                    if(WBFindCapture(ADC, true) != NULL)                // if more to send, wait for the pacer
+                        WaitTime = WBPacerWait(PacketBytes);
             }
-            usleep(5000);
+            usleep(WaitTime);
 
         }     // end of while(!InitError&& SDRActive) loop - typically when comm with SDR client stops
         StoredEnables = false;                                          // force a re-config if comm continues later
+        for (Cntr = 0; Cntr < VWBCAPTUREBUFFERS; Cntr++)
+            WBCaptures[Cntr].Full = false;
     } //end of while(!InitError)
 
 //
@@ -34,6 +34,14 @@ void SetWidebandParams(uint8_t Enables, uint16_t SampleCount, uint8_t SampleSize
 
 
 
+//
+// set the ethernet link speed in Mbit/s (0 if not known)
+// wideband packets are paced to a share of it
+//
+void SetWidebandLinkSpeed(uint32_t Mbps);
+
+
+
 //
 // this runs as its own thread to send outgoing wideband data
 // thread initiated after a "Start" command
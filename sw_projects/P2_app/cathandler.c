@@ -24,8 +24,10 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/time.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
@@ -38,20 +40,26 @@
 #include "cathandler.h"
 #include "catmessages.h"
 #include "serialport.h"
+#include "controlreactor.h"
 
 
 
 bool CATPortAssigned = false;                // true if CAT set up and active
 int CATPort = 0;
-bool ThreadActive = false;                  // true while CAT thread running
-bool CATKeepaliveActive = false;            // true while keepalive thread running
-bool SignalThreadEnd = false;               // asserted to terminate thread
-pthread_t CATThread;                        // thread reads/writes CAT commands
-pthread_t CATKeepaliveThread;               // thread requests activity every 15s
+int CATSocketid = -1;                       // CAT TCP/IP socket; -1 if not connected
+bool CATConnecting = false;                 // true while a connect() is in progress
+time_t CATConnectTime;                      // time connect() started
+unsigned int CATSendOffset = 0;             // characters of the oldest queued string already sent
+bool CATWaitingToSend = false;              // true if waiting for the socket to be writable
+time_t CATKeepaliveTime;                    // time keepalive last sent
+time_t CATRetryTime;                        // earliest time to retry a failed connection
 bool CATDebugPrint = false;                 // true if to print generated CAT messages
 
 
 
+#define VCATKEEPALIVESECS 15                // time between keepalives
+#define VCATRETRYSECS 5                     // time between connection attempts
+#define VCATCONNECTTIMEOUT 2                // connect() timeout (s)
 #define VNUMOPSTRINGS 16                    // size of output queue
 #define VOPSTRSIZE 100                      // size of each string in queue
 //
@@ -357,6 +365,7 @@ void SendCATMessage(char* Msg)
       strcpy(OutputStrings[CATWritePtr++], Msg);
       if(CATWritePtr >= VNUMOPSTRINGS)
         CATWritePtr = 0;
+      ReactorWake();                                            // reactor sends it
       if (CATDebugPrint)
         printf("Sent CAT msg %s\n", Msg);                       // debug
     }
@@ -530,211 +539,282 @@ void MakeCATMessageString(int Device, ECATCommands Cmd, char* Param)
 
 
 
-// this runs as its own thread to create activity at least every 15s
-// otherwise Thetis drops connection after 30s
 //
-void* CATKeepaliveThreadFunction(__attribute__((unused)) void *arg)
-{ 
-    int Cntr = 0;
+// the CAT TCP/IP connection is run by the control reactor, in the main thread, so nothing
+// here may block: the socket is non blocking. CATReactorTick() starts a connection once a port
+// is assigned and the SDR is active, and sends the output queue and the keepalive;
+// CATSocketEvent() completes the connection, handles received CAT commands, and sends
+// any output left queued because the socket was full.
+// Thetis drops the connection after 30s without activity, so a keepalive is sent every 15s.
+//
+static void CATClose(void)
+{
+    if(CATSocketid >= 0)
+    {
+        ReactorRemove(CATSocketid);
+        close(CATSocketid);
+        printf("Closing CAT Port\n");
+    }
+    CATSocketid = -1;
+    CATConnecting = false;
+    CATWaitingToSend = false;
+    CATSendOffset = 0;
+    CATPort = 0;                                            // set port not assigned
+    CATPortAssigned = false;
+}
 
-    printf("spinning up CAT keepalive thread, pid=%ld\n", syscall(SYS_gettid));
 
 //
-// wait up to 10s for SDR active to become set
-// (there seems to be a race condition between general packet to SDR and high priority data packet
-// and we can get here without it set)
+// give up on a connection attempt; CATReactorTick() retries later
 //
-    while((Cntr++ < 10 && !SDRActive))
-        sleep(1);
+static void CATConnectFailed(void)
+{
+    ReactorRemove(CATSocketid);
+    close(CATSocketid);
+    CATSocketid = -1;
+    CATConnecting = false;
+}
+
+
+//
+// send queued CAT messages until the queue is empty or the socket is full
+// unsent strings (and the unsent part of a string) stay queued, and the reactor
+// calls CATSocketEvent() when the socket can take more
+//
+static void CATSendQueued(void)
+{
+    unsigned int TXMessageLength;
+    ssize_t Sent;
+    bool Full = false;
 
-    Cntr = 0;
-    CATKeepaliveActive = true;
-    while(SDRActive && !SignalThreadEnd)
+    while(GetCATOPBufferUsed() != 0)
     {
-        if(Cntr++ == 1500)
+      TXMessageLength = strlen(OutputStrings[CATReadPtr]);
+      Sent = send(CATSocketid, OutputStrings[CATReadPtr] + CATSendOffset, TXMessageLength - CATSendOffset, MSG_DONTWAIT);
+      if(Sent < 0)
+      {
+        if((errno == EAGAIN) || (errno == EWOULDBLOCK))
         {
-            MakeCATMessageNoParam(DESTTCPCATPORT, eZZXV);
-            Cntr = 0;
+          Full = true;
+          break;
         }
-        usleep(10000);                                                  // 10ms * 1500 = 15 sec delay between keepalives
+        perror("CAT send Error");
+        CATClose();
+        return;
+      }
+      CATSendOffset += Sent;
+      if(CATSendOffset < TXMessageLength)
+      {
+        Full = true;
+        break;
+      }
+      CATSendOffset = 0;
+      CATReadPtr++;
+      if(CATReadPtr >= VNUMOPSTRINGS)
+        CATReadPtr = 0;
+    }
+    if(Full != CATWaitingToSend)
+    {
+      ReactorWatchWrite(CATSocketid, Full);
+      CATWaitingToSend = Full;
     }
-    printf("closing CAT keepalive thread\n");
-    CATKeepaliveActive = false;
-    return NULL;
 }
 
 
+//
+// a non blocking connect() has finished: see if it succeeded
+// returns true if connected
+//
+static bool CATConnectComplete(void)
+{
+    int Error = 0;
+    socklen_t Length = sizeof(Error);
+
+    if(getsockopt(CATSocketid, SOL_SOCKET, SO_ERROR, &Error, &Length) < 0)
+      Error = errno;
+    if(Error != 0)
+    {
+      printf("CAT connect: %s\n", strerror(Error));
+      CATConnectFailed();
+      return false;
+    }
+    CATConnecting = false;
+    ReactorWatchWrite(CATSocketid, false);
+    CATPortAssigned = true;
+    CATKeepaliveTime = time(NULL);
+    printf("connected to CAT\n");
+    return true;
+}
+
 
-// this runs as its own thread to send and receive CAT data
-// thread initiated after a port number received
-// will be instructed to stop & exit by SDRActive becoming false
-// (connection to SDR client list so no port to make use of)
-// this is called when a connection port available; create socket on entry.
 //
-void* CATHandlerThread(__attribute__((unused)) void *arg)
+// control reactor handler: CAT socket event
+// writable completes a connection, or lets more queued output be sent.
+// a TCP/IP packet can contain one or several CAT commands, so need to break them up!
+//
+static void CATSocketEvent(int Socketid, uint32_t Events, __attribute__((unused)) void* arg)
 {
-    bool ThreadError = false;
-    int CATSocketid;                                 // socket to access internet
-    struct sockaddr_in addr_cat;
-    int ActiveCATPort;
     int ReadResult;
-    int Cntr = 0;
     char ReadBuffer[1024] = {0};
-    char SendBuffer[1024] = {0};
-    unsigned int TXMessageLength;
-    int SendError = 0;
     char* SemicolonPosition = 0;
     unsigned int ReadBufferLength;
     char StringToParse[1024];
     bool CharsRemaining;
     unsigned int CatStringLength;
-    
-
-//    bool DebugMessageSent = false;
 
-//
-// wait up to 10s for SDR active to become set
-// (there seems to be a race condition between general packet to SDR and high priority data packet
-// and we can get here without it set)
-//
-    while((Cntr++ < 10 && !SDRActive))
-      sleep(1);
+    if(CATConnecting)
+    {
+        if(Events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+            if(CATConnectComplete())
+                CATSendQueued();
+        return;
+    }
+    if(Events & EPOLLOUT)
+    {
+        CATSendQueued();
+        if(CATSocketid < 0)
+            return;
+    }
+    if(!(Events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+        return;
 
+    ReadResult = recv(Socketid, ReadBuffer, 1023, MSG_DONTWAIT);
+    if(ReadResult > 0)
+    {
+        CharsRemaining = true;
+        //
+        // break into indivisual CAT commands, and process them
+        //
+        while(CharsRemaining)
+        {
+          ReadBufferLength = strlen(ReadBuffer);
+          if(ReadBufferLength < 3)
+            CharsRemaining = false;                               // minimum CAT cat command length
+          SemicolonPosition = strchr(ReadBuffer, ';');
+          if(SemicolonPosition == NULL)                           // if no semicolon we don't have a CAT command
+            break;
+          CatStringLength = (SemicolonPosition - ReadBuffer) + 1;
+          strncpy(StringToParse, ReadBuffer, CatStringLength);
+          StringToParse[CatStringLength] = 0;                     // null terminate
+          ParseCATCmd(StringToParse, DESTTCPCATPORT);
+          //
+          // now remove that CAT command from the buffer, and see if there is anything left to process
+          //
+          if(ReadBufferLength>CatStringLength)
+          {
+              strncpy(ReadBuffer, ReadBuffer+CatStringLength, (ReadBufferLength-CatStringLength));
+              ReadBuffer[ReadBufferLength-CatStringLength] = 0;         // null terminate
+          }
+          else 
+            CharsRemaining = false;
+        }
+    }
     //
-    // loop, creating then using socket
-    // written this way so that if the port changes, we can exit the processing loop & re-connect
+    // a closed connection stays readable, so it must be closed here
+    // (error 104 happens if server drops connection)
     //
-    while(!ThreadError && SDRActive && !SignalThreadEnd)
+    else if((ReadResult == 0) || ((ReadResult == -1) && (errno == ECONNRESET)))
     {
-      //
-      // create socket for TCP/IP connection
-      //
-      printf("Creating CAT socket on port %d, pid=%ld\n", CATPort, syscall(SYS_gettid));
-      struct timeval ReadTimeout;                                       // read timeout
-      int yes = 1;
-      if((CATSocketid = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-      {
-          perror("CAT socket fail");
-          return NULL;
-          CATPort = 0;
-      }
+      printf("CAT server dropped connection\n");
+      CATClose();
+    }
+}
 
-    //
-    // set 1ms timeout, and re-use any recently open ports
-    //
-      setsockopt(CATSocketid, SOL_SOCKET, SO_REUSEADDR, (void *)&yes , sizeof(yes));
-      ReadTimeout.tv_sec = 0;
-      ReadTimeout.tv_usec = 1000;
-      setsockopt(CATSocketid, SOL_SOCKET, SO_RCVTIMEO, (void *)&ReadTimeout , sizeof(ReadTimeout));
+
+//
+// create non blocking socket for TCP/IP connection and start connecting to the CAT port
+// the connection completes (or fails) later, in CATSocketEvent()
+//
+static void CATConnect(void)
+{
+    struct sockaddr_in addr_cat;
+    int yes = 1;
+
+    printf("Creating CAT socket on port %d\n", CATPort);
+    if((CATSocketid = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0)
+    {
+        perror("CAT socket fail");
+        return;
+    }
+    setsockopt(CATSocketid, SOL_SOCKET, SO_REUSEADDR, (void *)&yes , sizeof(yes));
+    if(!ReactorAdd(CATSocketid, CATSocketEvent, NULL))
+    {
+        close(CATSocketid);
+        CATSocketid = -1;
+        return;
+    }
 
     //
     // connect to destination port
     //
-      addr_cat.sin_addr.s_addr = reply_addr.sin_addr.s_addr;
-      addr_cat.sin_family = AF_INET;
-      addr_cat.sin_port = htons(CATPort);
-      ActiveCATPort = CATPort;
-      printf("Connecting CAT socket to port %d\n", CATPort);
-
-      if(connect(CATSocketid, (struct sockaddr *)&addr_cat, sizeof(struct sockaddr_in)) < 0)
-      {
-          perror("CAT connect");
-          ActiveCATPort = 0;
-          return NULL;
-      }
-      ThreadActive = true;
-      CATPortAssigned = true;
+    addr_cat.sin_addr.s_addr = reply_addr.sin_addr.s_addr;
+    addr_cat.sin_family = AF_INET;
+    addr_cat.sin_port = htons(CATPort);
+    printf("Connecting CAT socket to port %d\n", CATPort);
+    CATConnecting = true;
+    CATConnectTime = time(NULL);
+    if(connect(CATSocketid, (struct sockaddr *)&addr_cat, sizeof(struct sockaddr_in)) == 0)
+        CATConnectComplete();
+    else if(errno == EINPROGRESS)
+        ReactorWatchWrite(CATSocketid, true);               // writable when connect completes
+    else
+    {
+        perror("CAT connect");
+        CATConnectFailed();
+    }
+}
 
-      printf("connected to CAT\n");
 
+//
+// called by the control reactor after every wake
+// make or close the connection as needed; then send any queued CAT messages
+//
+void CATReactorTick(void)
+{
+    time_t Now;
 
-      //
-      // now loop; process read, write events
-      // exit loop if port number changes
-      // a TCP/IP packet can contain one or several CAT commands, so need to break them up!
-      //
-      while(!ThreadError && SDRActive && !SignalThreadEnd && (ActiveCATPort == CATPort))    // thread main loop
-      {
-  //        ReadResult = read(CATSocketid, ReadBuffer, 1023);
-          ReadResult = recv(CATSocketid, ReadBuffer, 1023, 0);
-          if(ReadResult > 0)
-          {
-              CharsRemaining = true;
-              //
-              // break into indivisual CAT commands, and process them
-              //
-              while(CharsRemaining)
-              {
-                ReadBufferLength = strlen(ReadBuffer);
-                if(ReadBufferLength < 3)
-                  CharsRemaining = false;                               // minimum CAT cat command length
-                SemicolonPosition = strchr(ReadBuffer, ';');
-                if(SemicolonPosition == NULL)                           // if no semicolon we don't have a CAT command
-                  break;
-                CatStringLength = (SemicolonPosition - ReadBuffer) + 1;
-                strncpy(StringToParse, ReadBuffer, CatStringLength);
-                StringToParse[CatStringLength] = 0;                     // null terminate
-                ParseCATCmd(StringToParse, DESTTCPCATPORT);
-                //
-                // now remove that CAT command from the buffer, and see if there is anything left to process
-                //
-                if(ReadBufferLength>CatStringLength)
-                {
-                    strncpy(ReadBuffer, ReadBuffer+CatStringLength, (ReadBufferLength-CatStringLength));
-                    ReadBuffer[ReadBufferLength-CatStringLength] = 0;         // null terminate
-                }
-                else 
-                  CharsRemaining = false;
-              }
-              memset(ReadBuffer, 0, sizeof(ReadBuffer));
-          }
-          else if((ReadResult == -1) && (errno == 104))            // error 104 happens if server drops connection
-          {
-            printf("CAT server dropped connection\n");
-            ThreadError = true;
-          }
+    Now = time(NULL);
+    if((CATSocketid >= 0) && !SDRActive)                    // client has gone: no port to make use of
+        CATClose();
+    if((CATSocketid < 0) && (CATPort != 0) && SDRActive && (Now >= CATRetryTime))
+    {
+        CATRetryTime = Now + VCATRETRYSECS;
+        CATConnect();
+    }
+    if(CATSocketid < 0)
+        return;
+    if(CATConnecting)
+    {
+        if((Now - CATConnectTime) >= VCATCONNECTTIMEOUT)
+        {
+            printf("CAT connect timed out\n");
+            CATConnectFailed();
+        }
+        return;
+    }
 
-          //
-          // if there are CAT messages available, send them
-          //
-          while((GetCATOPBufferUsed() != 0) && !SignalThreadEnd && !ThreadError)
-          {
-            TXMessageLength = strlen(OutputStrings[CATReadPtr]);
-            strcpy(SendBuffer, OutputStrings[CATReadPtr++]);
-            if(CATReadPtr >= VNUMOPSTRINGS)
-              CATReadPtr = 0;
-            SendError = send(CATSocketid, SendBuffer, TXMessageLength, 0);
-            if(SendError == -1)
-            {
-              perror("CAT send Error");
-              ThreadError = true; 
-              break;
-            }
-          }
-      }                                                       // end of thread main loop
-      close(CATSocketid);
-      printf("Closing CAT Port & terminating thread\n");
-      ActiveCATPort = 0;
-      CATPort = 0;                                            // set port not assigned
-      CATPortAssigned = false;
+    if((Now - CATKeepaliveTime) >= VCATKEEPALIVESECS)
+    {
+        MakeCATMessageNoParam(DESTTCPCATPORT, eZZXV);
+        CATKeepaliveTime = Now;
     }
-    ThreadActive = false;
-    ThreadError = false;
-    return NULL;
+    //
+    // if there are CAT messages available, send them
+    //
+    if(!CATWaitingToSend)
+        CATSendQueued();
 }
 
 
 //
 // function to setup a CAT port handler
-// save port number, and create a thread if needed
+// save port number; the reactor makes the connection
 // note this will be called a lot of times: every time a high priority command message received. 
 // only process this if the port is not yet assigned
 //
 // there is a race condition. This is called from inhighpriority.c, but a necessary condition
-// for SDRActive to be set is for general packet to SDR to have arrived too. So the CAT thread
-// may be established before SDRActive is set, and it must wait for it.
-// We can't test here for it, or we'd miss the first high priority message and have to wait for the next
-// which may only be after a tuning action or other user event.
+// for SDRActive to be set is for general packet to SDR to have arrived too. So the port may
+// be set before SDRActive is set; CATReactorTick() waits for it before connecting.
 //
 void SetupCATPort(int Port)
 {
@@ -742,43 +822,19 @@ void SetupCATPort(int Port)
     {
         CATPort = Port;
         printf("CATPort initialised to %d\n", Port);
-        SignalThreadEnd = false;
-        ThreadActive = false;
-
-        if((!ThreadActive) && (CATPort != 0))
-        {
-          if(pthread_create(&CATThread, NULL, CATHandlerThread, NULL) < 0)
-          {
-              perror("pthread_create CAT handler");
-              CATPort = 0;
-              return;
-          }
-          pthread_detach(CATThread);
-          
-          // and create the keepalive
-          if(pthread_create(&CATKeepaliveThread, NULL, CATKeepaliveThreadFunction, NULL) < 0)
-          {
-              perror("pthread_create CAT keepalive");
-              CATPort = 0;
-              return;
-          }
-          pthread_detach(CATKeepaliveThread);
-        }
+        CATRetryTime = 0;
+        ReactorWake();
     }  
 }
 
 
 //
 // function to shut down CAT handler
-// only returns when shutdown of CAT handler and the keepalive is complete
-// signal thread to shut down, then wait
+// closes the connection; called from the control reactor thread, or after it has ended
 //
 void ShutdownCATHandler(void)
 {
-    SignalThreadEnd = true;
-    while(ThreadActive || CATKeepaliveActive)
-        usleep(1000);
-    SignalThreadEnd = false;
+    CATClose();
 }
 
 
@@ -87,6 +87,13 @@ void MakeCATMessageString(int Device, ECATCommands Cmd, char* Param);
 //
 void SetupCATPort(int Port);
 
+
+//
+// run the CAT connection: called by the control reactor after every wake
+//
+void CATReactorTick(void);
+
+
 //
 // function to shut down CAT handler
 // only returns when shutdown is complete
@@ -0,0 +1,198 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// controlreactor.c:
+// single thread event loop for the low rate control sockets
+//
+// the command port, DDC specific, DUC specific and high priority sockets, and the CAT
+// TCP/IP connection, are all served by one thread waiting in epoll_wait() rather than
+// a thread each polling its own socket every 1ms. The high rate data streams keep
+// their own threads.
+//
+//////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "controlreactor.h"
+
+
+#define VMAXREACTORSOCKETS 16                   // sockets that can be watched
+#define VREACTOREVENTS 8                        // events read per epoll_wait() call
+
+
+struct ReactorEntry
+{
+    int Socketid;                               // -1 if entry unused
+    ReactorHandler Handler;
+    void* Context;
+};
+
+int ReactorFd = -1;                             // epoll instance
+int ReactorWakeFd = -1;                         // eventfd written by ReactorWake()
+struct ReactorEntry ReactorEntries[VMAXREACTORSOCKETS];
+
+
+//
+// create the reactor. Returns true if successful
+//
+bool ReactorCreate(void)
+{
+    struct epoll_event Event = {0};
+    int Cntr;
+
+    for(Cntr = 0; Cntr < VMAXREACTORSOCKETS; Cntr++)
+        ReactorEntries[Cntr].Socketid = -1;
+    ReactorFd = epoll_create1(EPOLL_CLOEXEC);
+    if(ReactorFd < 0)
+    {
+        perror("epoll_create1");
+        return false;
+    }
+    ReactorWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(ReactorWakeFd < 0)
+    {
+        perror("eventfd");
+        return false;
+    }
+    Event.events = EPOLLIN;
+    Event.data.ptr = NULL;                      // NULL marks the wake event
+    if(epoll_ctl(ReactorFd, EPOLL_CTL_ADD, ReactorWakeFd, &Event) < 0)
+    {
+        perror("epoll_ctl wake");
+        return false;
+    }
+    return true;
+}
+
+
+//
+// watch a socket: Handler is called from the reactor thread whenever it is readable
+// a socket can only be added once. Returns true if successful
+//
+bool ReactorAdd(int Socketid, ReactorHandler Handler, void* Context)
+{
+    struct epoll_event Event = {0};
+    int Cntr;
+
+    for(Cntr = 0; Cntr < VMAXREACTORSOCKETS; Cntr++)
+        if(ReactorEntries[Cntr].Socketid == -1)
+            break;
+    if(Cntr == VMAXREACTORSOCKETS)
+    {
+        printf("control reactor: no free entry for socket %d\n", Socketid);
+        return false;
+    }
+    ReactorEntries[Cntr].Handler = Handler;
+    ReactorEntries[Cntr].Context = Context;
+    Event.events = EPOLLIN;
+    Event.data.ptr = &ReactorEntries[Cntr];
+    if(epoll_ctl(ReactorFd, EPOLL_CTL_ADD, Socketid, &Event) < 0)
+    {
+        perror("epoll_ctl add");
+        return false;
+    }
+    ReactorEntries[Cntr].Socketid = Socketid;
+    return true;
+}
+
+
+//
+// stop watching a socket (call before closing it)
+//
+void ReactorRemove(int Socketid)
+{
+    int Cntr;
+
+    for(Cntr = 0; Cntr < VMAXREACTORSOCKETS; Cntr++)
+        if(ReactorEntries[Cntr].Socketid == Socketid)
+        {
+            epoll_ctl(ReactorFd, EPOLL_CTL_DEL, Socketid, NULL);
+            ReactorEntries[Cntr].Socketid = -1;
+        }
+}
+
+
+//
+// also call the handler for a watched socket when it is writable (Enable true), or stop doing so
+// Returns true if successful
+//
+bool ReactorWatchWrite(int Socketid, bool Enable)
+{
+    struct epoll_event Event = {0};
+    int Cntr;
+
+    for(Cntr = 0; Cntr < VMAXREACTORSOCKETS; Cntr++)
+        if(ReactorEntries[Cntr].Socketid == Socketid)
+            break;
+    if(Cntr == VMAXREACTORSOCKETS)
+        return false;
+    Event.events = Enable ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    Event.data.ptr = &ReactorEntries[Cntr];
+    if(epoll_ctl(ReactorFd, EPOLL_CTL_MOD, Socketid, &Event) < 0)
+    {
+        perror("epoll_ctl mod");
+        return false;
+    }
+    return true;
+}
+
+
+//
+// wake the reactor so its Tick function runs soon. Can be called from any thread or a signal handler
+//
+void ReactorWake(void)
+{
+    uint64_t One = 1;
+
+    if(ReactorWakeFd >= 0)
+        if(write(ReactorWakeFd, &One, sizeof(One)) < 0)
+            return;                             // only fails if already signalled many times
+}
+
+
+//
+// run the reactor in the calling thread.
+// after every wake (socket events, ReactorWake(), or at least every VREACTORTICKMS)
+// Tick() is called; the reactor returns when Tick() returns false.
+// an entry removed by a handler may still have an event in the list just read;
+// its Socketid is then -1 and the event is ignored.
+//
+void ReactorRun(bool (*Tick)(void))
+{
+    struct epoll_event Events[VREACTOREVENTS];
+    struct ReactorEntry* Entry;
+    uint64_t Count;
+    int NumEvents;
+    int Cntr;
+
+    while(Tick())
+    {
+        NumEvents = epoll_wait(ReactorFd, Events, VREACTOREVENTS, VREACTORTICKMS);
+        if((NumEvents < 0) && (errno != EINTR))
+        {
+            perror("epoll_wait");
+            return;
+        }
+        for(Cntr = 0; Cntr < NumEvents; Cntr++)
+        {
+            Entry = (struct ReactorEntry*)Events[Cntr].data.ptr;
+            if(Entry == NULL)
+            {
+                if(read(ReactorWakeFd, &Count, sizeof(Count)) < 0)
+                    continue;                   // already cleared
+            }
+            else if(Entry->Socketid != -1)
+                Entry->Handler(Entry->Socketid, Events[Cntr].events, Entry->Context);
+        }
+    }
+}
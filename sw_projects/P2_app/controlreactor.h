@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// controlreactor.h:
+// single thread event loop for the low rate control sockets
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __controlreactor_h
+#define __controlreactor_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define VREACTORTICKMS 100                      // longest wait without an event (ms)
+
+
+//
+// handler called by the reactor when a socket it watches has an event
+// Events is the epoll event mask; Context is as given to ReactorAdd()
+//
+typedef void (*ReactorHandler)(int Socketid, uint32_t Events, void* Context);
+
+
+//
+// create the reactor. Returns true if successful
+//
+bool ReactorCreate(void);
+
+
+//
+// watch a socket: Handler is called from the reactor thread whenever it is readable
+// a socket can only be added once. Returns true if successful
+//
+bool ReactorAdd(int Socketid, ReactorHandler Handler, void* Context);
+
+
+//
+// stop watching a socket (call before closing it)
+//
+void ReactorRemove(int Socketid);
+
+
+//
+// also call the handler for a watched socket when it is writable (Enable true), or stop doing so
+// Returns true if successful
+//
+bool ReactorWatchWrite(int Socketid, bool Enable);
+
+
+//
+// wake the reactor so its Tick function runs soon. Can be called from any thread or a signal handler
+//
+void ReactorWake(void);
+
+
+//
+// run the reactor in the calling thread.
+// after every wake (socket events, ReactorWake(), or at least every VREACTORTICKMS)
+// Tick() is called; the reactor returns when Tick() returns false.
+//
+void ReactorRun(bool (*Tick)(void));
+
+
+#endif
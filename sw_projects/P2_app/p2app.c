@@ -47,6 +47,7 @@
 #include "../common/saturnregisters.h"              // register I/O for Saturn
 #include "../common/codecwrite.h"                   // codec register I/O for Saturn
 #include "../common/version.h"                      // version I/O for Saturn
+#include "../common/capabilities.h"                 // hardware capabilities
 #include "../common/auxadc.h"                       // version I/O for Saturn
 
 #include "threaddata.h"
@@ -54,6 +55,8 @@
 #include "IncomingDDCSpecific.h"
 #include "IncomingDUCSpecific.h"
 #include "InHighPriority.h"
+#include "controlreactor.h"
+#include "udpreceive.h"
 #include "InDUCIQ.h"
 #include "InSpkrAudio.h"
 #include "OutMicAudio.h"
@@ -135,17 +138,20 @@ struct sockaddr_in reply_addr;              // destination address for outgoing
 
 bool IsTXMode;                              // true if in TX
 bool SDRActive;                             // true if this SDR is running at the moment
+uint32_t SDRRunCount = 0;                   // incremented each time SDRActive is set (a new run)
 bool ReplyAddressSet = false;               // true when reply address has been set
 bool StartBitReceived = false;              // true when "run" bit has been set
 bool NewMessageReceived = false;            // set whenever a message is received
 bool ExitRequested = false;                 // true if "exit checking" thread requests shutdown
 bool SkipExitCheck = false;                 // true to skip "exit checking", if running as a service
 bool ThreadError = false;                   // true if a thread reports an error
+bool IncompatibleFirmware = false;          // becomes set if firmware is not compatible with this version
 bool UseDebug = false;                      // true if to enable debugging
 bool UseControlPanel = false;               // true if to use a control panel
 bool UseGanymede = false;                   // true if to use Ganymede PA protection
 bool UseLDGATU = false;                     // true if to use an LDG ATU via CAT
 bool UseAriesATU = false;                   // true if to use an Aries ATU
+bool UseWriteBehind = false;                // true to queue TX I/Q and speaker DMA writes in the driver
 uint32_t LODebugDDC1Frequency;              // -x debug mode: LO frequency for DDC1
 bool InterleavedDDCDebugMode = false;       // true if interleaved DDC for debug are allowed
 
@@ -198,9 +204,6 @@ uint16_t DefaultPorts[VPORTTABLESIZE] =
 };
 
 
-pthread_t DDCSpecificThread;
-pthread_t DUCSpecificThread;
-pthread_t HighPriorityToSDRThread;
 pthread_t SpkrAudioThread;
 pthread_t DUCIQThread;
 pthread_t DDCIQThread[VNUMDDC];               // array, but not sure how many
@@ -225,6 +228,7 @@ void sig_handler(int signo)
     if (signo == SIGINT)
         printf("received SIGINT\n");
     ExitRequested = true;
+    ReactorWake();
 }
 
 //
@@ -290,6 +294,7 @@ int MakeSocket(struct ThreadSocketData* Ptr, int DDCid)
 
   //
   // set 1ms timeout, and re-use any recently open ports
+  // (the incoming data threads wait in UDPBatchReceive() instead, so the timeout doesn't apply to them)
   //
   setsockopt(Ptr->Socketid, SOL_SOCKET, SO_REUSEADDR, (void *)&yes , sizeof(yes));
   ReadTimeout.tv_sec = 0;
@@ -320,6 +325,28 @@ int MakeSocket(struct ThreadSocketData* Ptr, int DDCid)
 }
 
 
+//
+// read the link speed of a network interface in Mbit/s
+// returns 0 if not known (eg no link)
+//
+uint32_t GetLinkSpeed(const char* Interface)
+{
+  char Path[64];
+  FILE* fp;
+  int Speed = 0;
+
+  snprintf(Path, sizeof(Path), "/sys/class/net/%s/speed", Interface);
+  fp = fopen(Path, "r");
+  if(fp != NULL)
+  {
+    if((fscanf(fp, "%d", &Speed) != 1) || (Speed < 0))
+      Speed = 0;
+    fclose(fp);
+  }
+  return (uint32_t)Speed;
+}
+
+
 //
 // this runs as its own thread to monitor command line activity. A string "exist" exits the application. 
 // thread initiated at the start.
@@ -336,6 +363,7 @@ void* CheckForExitCommand(__attribute__((unused)) void *arg)
     if((ch == 'x') || (ch == 'X'))
     {
       ExitRequested = true;
+      ReactorWake();
       break;
     }
   }
@@ -374,6 +402,118 @@ void* CheckForActivity(__attribute__((unused)) void *arg)
 
 
 
+//
+// control reactor handler for command packets arriving at port 1024
+// these are identified by the command byte (byte 4)
+// cmd=00: general packet
+// cmd=02: discovery
+// cmd=03: set IP address (not supported)
+// cmd=04: erase (not supported)
+// cmd=05: program (not supported)
+// arg points to the part written discovery reply packet
+//
+void HandleCommandPort(int Socketid, __attribute__((unused)) uint32_t Events, void* arg)
+{
+  static struct UDPReceiveBatch Batch;                              // received messages
+  uint8_t* DiscoveryReply = (uint8_t*)arg;
+  uint8_t* UDPInBuffer;                                             // incoming message, in Batch
+  struct sockaddr_in* addr_from;                                    // source of incoming message
+  uint8_t CmdByte;                                                  // command word from PC app
+  int Count;                                                        // messages received
+  int Msg;
+  int size;
+
+  if((Batch.Buffer == NULL) && !UDPBatchCreate(&Batch, VDDCPACKETSIZE, 8))
+  {
+    printf("command port receive buffer allocation failed\n");
+    return;
+  }
+  while((Count = UDPBatchReceive(&Batch, Socketid, 0)) > 0)
+  {
+    for(Msg = 0; Msg < Count; Msg++)
+    {
+      UDPInBuffer = UDPBatchData(&Batch, Msg);
+      addr_from = UDPBatchFrom(&Batch, Msg);
+      size = UDPBatchLength(&Batch, Msg);
+//
+// only process packets of length 60 bytes on this port, to exclude protocol 1 discovery for example.
+// (that means we can't handle the programming packet but we don't use that anyway)
+//
+      CmdByte = UDPInBuffer[4];
+      if(size != VDISCOVERYSIZE)
+        continue;
+      NewMessageReceived = true;
+      switch(CmdByte)
+      {
+        //
+        // general packet. Get the port numbers and establish listener threads
+        //
+        case 0:
+          printf("P2 General packet to SDR, size= %d\n", size);
+          //
+          // get "from" MAC address and port; this is where the data goes back to
+          //
+          memset(&reply_addr, 0, sizeof(reply_addr));
+          reply_addr.sin_family = AF_INET;
+          reply_addr.sin_addr.s_addr = addr_from->sin_addr.s_addr;
+          reply_addr.sin_port = addr_from->sin_port;                      // (but each outgoing thread needs to set its own sin_port)
+          HandleGeneralPacket(UDPInBuffer);
+          ReplyAddressSet = true;
+          if(ReplyAddressSet && StartBitReceived)
+          {
+            if(!SDRActive)                                          // a new run
+                __atomic_add_fetch(&SDRRunCount, 1, __ATOMIC_RELEASE);
+            SDRActive = true;                                       // only set active if we have start bit too
+            SetTXEnable(true);
+          }
+          break;
+
+        //
+        // discovery packet
+        //
+        case 2:
+          printf("P2 Discovery packet\n");
+          if(SDRActive || IncompatibleFirmware)
+            DiscoveryReply[4] = 3;                             // response 2 if not active, 3 if running
+          else
+            DiscoveryReply[4] = 2;                             // response 2 if not active, 3 if running
+          sendto(Socketid, DiscoveryReply, VDISCOVERYREPLYSIZE, 0, (struct sockaddr *)addr_from, sizeof(struct sockaddr_in));
+          break;
+
+        case 3:
+        case 4:
+        case 5:
+          printf("Unsupported packet\n");
+          break;
+
+        default:
+          break;
+
+      }// end switch (packet type)
+    }
+  }
+  if(Count < 0)
+  {
+    perror("recvfrom, port 1024");
+    ThreadError = true;
+  }
+}
+
+
+//
+// called by the control reactor after every wake
+// runs the CAT connection; returns false to end the reactor when the app should exit
+//
+bool ReactorTick(void)
+{
+  if(ExitRequested || ThreadError)
+    return false;
+  CATReactorTick();
+  return true;
+}
+
+
+
 //
 // Shutdown()
 // perform ordely shutdown of the program
@@ -387,9 +527,7 @@ void Shutdown()
     ShutdownAriesHandler();
 
   close(SocketData[0].Socketid);                          // close incoming data socket
-  sem_destroy(&DDCInSelMutex);
   sem_destroy(&DDCResetFIFOMutex);
-  sem_destroy(&RFGPIOMutex);
   sem_destroy(&CodecRegMutex);
   sem_destroy(&DDCResetFIFOMutex);                        // for DMA
   SetMOX(false);
@@ -409,7 +547,7 @@ void Shutdown()
 //
 int main(int argc, char *argv[])
 {
-  int i, size;
+  int i;
 //
 // part written discovery reply packet
 //
@@ -431,28 +569,20 @@ int main(int argc, char *argv[])
     0,0,0,0,0,0,0,0,0,0,0,0,0,0                   // 15 bytes padding
   };
 
-  uint8_t CmdByte;                                                  // command word from PC app
   struct ifreq hwaddr;                                              // holds this device MAC address
-  struct sockaddr_in addr_from;                                     // holds MAC address of source of incoming messages
-  uint8_t UDPInBuffer[VDDCPACKETSIZE];                              // outgoing buffer
-  struct iovec iovecinst;                                           // iovcnt buffer - 1 for each outgoing buffer
-  struct msghdr datagram;                                           // multiple incoming message header
 
   uint32_t TestFrequency;                                           // -f test source DDS freq
   int CmdOption;                                                    // command line option
   char BuildDate[]=GIT_DATE;
-	ESoftwareID ID;
+	const struct SaturnCapabilities* Caps;                          // hardware capabilities
 	unsigned int Version = 0;
   unsigned int MajorVersion = 0;
-  bool IncompatibleFirmware = false;                                // becomes set if firmware is not compatible with this version
   unsigned int PCBVersion;
 
   //
   // initialise register access semaphores
   //
-  sem_init(&DDCInSelMutex, 0, 1);                                   // for DDC input select register
   sem_init(&DDCResetFIFOMutex, 0, 1);                               // for FIFO reset register
-  sem_init(&RFGPIOMutex, 0, 1);                                     // for RF GPIO register
   sem_init(&CodecRegMutex, 0, 1);                                   // for codec accesss
   sem_init(&MicWBDMAMutex, 0, 1);                                   // for mic and WB DMA
     
@@ -463,7 +593,8 @@ int main(int argc, char *argv[])
 
   OpenXDMADriver(false);
   PrintVersionInfo();
-  PCBVersion = GetPCBVersionNumber();
+  Caps = GetCapabilities();                                         // probe version registers once
+  PCBVersion = Caps->PCBVersion;
   printf("p2app client app software Version:%d Build Date:%s\n", P2APPVERSION, BuildDate);
   PrintAuxADCInfo();
   if (IsFallbackConfig())
@@ -471,7 +602,7 @@ int main(int argc, char *argv[])
   
   SetSpkrMute(true);                                                // mute speaker before initialising codec
   usleep(10000);
-  CodecInitialise(PCBVersion);
+  CodecInitialise();
   InitialiseDACAttenROMs();
 //  InitialiseCWKeyerRamp(true, 5000);                              // create initial default 5 ms ramp, P2
   InitialiseCWKeyerRamp(true, 9000);                                // create initial default 9ms DL1YCF amp, P2
@@ -482,8 +613,8 @@ int main(int argc, char *argv[])
   SetByteSwapping(true);                                            // h/w to generate network byte order
   SetSpkrMute(false);
 
-  Version = GetFirmwareVersion(&ID);                                // TX scaling changed at FW V13
-  MajorVersion = GetFirmwareMajorVersion();
+  Version = Caps->FirmwareVersion;                                  // TX scaling changed at FW V13
+  MajorVersion = Caps->FirmwareMajorVersion;
 
   if(PCBVersion <= 2)
   {
@@ -535,7 +666,7 @@ int main(int argc, char *argv[])
 // option string needs a colon after each option letter that has a parameter after it
 // and it has a leading colon to suppress error messages
 //
-  while((CmdOption = getopt(argc, argv, ":a:i:f:x:m:sdphg")) != -1)
+  while((CmdOption = getopt(argc, argv, ":a:b:c:i:f:j:l:o:t:x:m:sdphgrw")) != -1)
   {
     switch(CmdOption)
     {
@@ -544,12 +675,20 @@ int main(int argc, char *argv[])
         printf("optional arguments:\n");
         printf("-a LDG        control TUNE for LDG ATU\n");
         printf("-a Aries      control TUNE for Aries ATU\n");
+        printf("-b <packets>  max DDC I/Q packets sent per system call (1-32, default 16)\n");
+        printf("-c <cpu>      run the DDC DMA thread on this CPU\n");
         printf("-f <frequency in Hz> turns on test source for all DDCs\n");
         printf("-g            enables PA protection (G2-1k only)\n");
         printf("-i saturn     board responds as board id = Saturn\n");
         printf("-i orionmk2   board responds as board id = Orion mk 2\n");
+        printf("-j <ms>       TX I/Q jitter buffer target depth (1-60ms, default: TX FIFO kept full)\n");
+        printf("-l <us>       DDC latency target: DMA size set to meet it (eg 1000 for CW, 20000 for panadapter)\n");
         printf("-m xlr        selects balanced XLR microphone input\n");
         printf("-m jack       selects unbalanced 3.5mm microphone input\n");
+        printf("-o <buffers>  overlapped DDC DMA using 2-4 buffers (default off)\n");
+        printf("-r            read DDC data from a kernel streaming ring (needs updated XDMA driver)\n");
+        printf("-w            TX I/Q and speaker DMA writes queued in the driver (needs updated XDMA driver; TX I/Q not with -j)\n");
+        printf("-t <map>      DDC packet sender threads, eg 0-4:2/5-9:3 = DDC0-4 on CPU2, DDC5-9 on CPU3\n");
         printf("-s            skip checking for exit keys, run as service\n");
         printf("-d            print additional debug\n");
         printf("-p            drive G2 control panel\n");
@@ -577,6 +716,70 @@ int main(int argc, char *argv[])
         }
         break;
 
+      case 'b':
+        DDCSendBatchLimit = (atoi(optarg));
+        if((DDCSendBatchLimit == 0) || (DDCSendBatchLimit > 32))
+        {
+          printf("error parsing DDC batch size. Value must be 1 to 32\n");
+          return EXIT_SUCCESS;
+        }
+        printf ("DDC I/Q packets per send call = %d\n", DDCSendBatchLimit);
+        break;
+
+      case 'j':
+        DUCJitterTarget = (atoi(optarg));
+        if((DUCJitterTarget == 0) || (DUCJitterTarget > 60))
+        {
+          printf("error parsing TX jitter buffer depth. Value must be 1 to 60 ms\n");
+          return EXIT_SUCCESS;
+        }
+        printf ("TX I/Q jitter buffer target depth = %dms\n", DUCJitterTarget);
+        break;
+
+      case 'l':
+        DDCLatencyTarget = (atoi(optarg));
+        if((DDCLatencyTarget < 100) || (DDCLatencyTarget > 100000))
+        {
+          printf("error parsing DDC latency target. Value must be 100 to 100000 us\n");
+          return EXIT_SUCCESS;
+        }
+        printf ("DDC DMA latency target = %dus\n", DDCLatencyTarget);
+        break;
+
+      case 'o':
+        DDCAsyncDMABuffers = (atoi(optarg));
+        if((DDCAsyncDMABuffers < 2) || (DDCAsyncDMABuffers > 4))
+        {
+          printf("error parsing overlapped DMA buffers. Value must be 2 to 4\n");
+          return EXIT_SUCCESS;
+        }
+        printf ("DDC overlapped DMA with %d buffers\n", DDCAsyncDMABuffers);
+        break;
+
+      case 'r':
+        printf ("DDC data read from kernel streaming ring\n");
+        DDCStreamRing = true;
+        break;
+
+      case 'w':
+        printf ("TX I/Q and speaker DMA write-behind enabled\n");
+        UseWriteBehind = true;
+        break;
+
+      case 'c':
+        SetDDCDMAThreadCPU(atoi(optarg));
+        printf ("DDC DMA thread on CPU %d\n", atoi(optarg));
+        break;
+
+      case 't':
+        if(SetDDCSenderMapping(optarg))
+        {
+          printf("error parsing DDC sender thread map\n");
+          printf("-t 0-4:2/5-9:3  DDC0-4 sent by a thread on CPU2, DDC5-9 by a thread on CPU3\n");
+          return EXIT_SUCCESS;
+        }
+        break;
+
       case 'g':
         printf ("Ganymede PA control enabled\n");                  
         UseGanymede = true;
@@ -753,34 +956,31 @@ int main(int argc, char *argv[])
     ioctl(SocketData[VPORTCOMMAND].Socketid, SIOCGIFHWADDR, &hwaddr);
     for(i = 0; i < 6; ++i) DiscoveryReply[i + 5] = hwaddr.ifr_addr.sa_data[i];         // copy MAC to reply message
 #endif
+  SetWidebandLinkSpeed(GetLinkSpeed(hwaddr.ifr_name));                                 // pace wideband data to the link
   DiscoveryReply[13] = (uint8_t)Version;
   DiscoveryReply[23] = (uint8_t)P2APPVERSION;
   
 
 
+  //
+  // the low rate incoming control sockets are served by the control reactor in the main thread
+  //
+  if(!ReactorCreate())
+    return EXIT_FAILURE;
   MakeSocket(SocketData+VPORTDDCSPECIFIC, 0);            // create and bind a socket
-  if(pthread_create(&DDCSpecificThread, NULL, IncomingDDCSpecific, (void*)&SocketData[VPORTDDCSPECIFIC]) < 0)
-  {
-    perror("pthread_create DDC specific");
+  if(!ReactorAdd(SocketData[VPORTDDCSPECIFIC].Socketid, IncomingDDCSpecific, (void*)&SocketData[VPORTDDCSPECIFIC]))
     return EXIT_FAILURE;
-  }
-  pthread_detach(DDCSpecificThread);
+  SocketData[VPORTDDCSPECIFIC].Active = true;
 
   MakeSocket(SocketData+VPORTDUCSPECIFIC, 0);            // create and bind a socket
-  if(pthread_create(&DUCSpecificThread, NULL, IncomingDUCSpecific, (void*)&SocketData[VPORTDUCSPECIFIC]) < 0)
-  {
-    perror("pthread_create DUC specific");
+  if(!ReactorAdd(SocketData[VPORTDUCSPECIFIC].Socketid, IncomingDUCSpecific, (void*)&SocketData[VPORTDUCSPECIFIC]))
     return EXIT_FAILURE;
-  }
-  pthread_detach(DUCSpecificThread);
+  SocketData[VPORTDUCSPECIFIC].Active = true;
 
   MakeSocket(SocketData+VPORTHIGHPRIORITYTOSDR, 0);            // create and bind a socket
-  if(pthread_create(&HighPriorityToSDRThread, NULL, IncomingHighPriority, (void*)&SocketData[VPORTHIGHPRIORITYTOSDR]) < 0)
-  {
-    perror("pthread_create High priority to SDR");
+  if(!ReactorAdd(SocketData[VPORTHIGHPRIORITYTOSDR].Socketid, IncomingHighPriority, (void*)&SocketData[VPORTHIGHPRIORITYTOSDR]))
     return EXIT_FAILURE;
-  }
-  pthread_detach(HighPriorityToSDRThread);
+  SocketData[VPORTHIGHPRIORITYTOSDR].Active = true;
 
   MakeSocket(SocketData+VPORTSPKRAUDIO, 0);            // create and bind a socket
   if(pthread_create(&SpkrAudioThread, NULL, IncomingSpkrAudio, (void*)&SocketData[VPORTSPKRAUDIO]) < 0)
@@ -874,97 +1074,13 @@ int main(int argc, char *argv[])
 
 
   //
-  // now main processing loop. Process received Command packets arriving at port 1024
-  // these are identified by the command byte (byte 4)
-  // cmd=00: general packet
-  // cmd=02: discovery
-  // cmd=03: set IP address (not supported)
-  // cmd=04: erase (not supported)
-  // cmd=05: program (not supported)
+  // now main processing loop: the control reactor serves the command port and the other
+  // control sockets from this thread, until exit is requested
   //
-  while(1)
-  {
-    memset(&iovecinst, 0, sizeof(struct iovec));
-    memset(&datagram, 0, sizeof(datagram));
-    iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-    iovecinst.iov_len = VDDCPACKETSIZE;
-    datagram.msg_iov = &iovecinst;
-    datagram.msg_iovlen = 1;
-    datagram.msg_name = &addr_from;
-    datagram.msg_namelen = sizeof(addr_from);
-    size = recvmsg(SocketData[0].Socketid, &datagram, 0);         // get one message. If it times out, gets size=-1
-    if(size < 0 && errno != EAGAIN)
-    {
-      perror("recvfrom, port 1024");
-      return EXIT_FAILURE;
-    }
-    if(ExitRequested)
-      break;
-    if(ThreadError)
-      break;
-
-
-//
-// only process packets of length 60 bytes on this port, to exclude protocol 1 discovery for example.
-// (that means we can't handle the programming packet but we don't use that anyway)
-//
-    CmdByte = UDPInBuffer[4];
-    if(size==VDISCOVERYSIZE)  
-    {
-      NewMessageReceived = true;
-      switch(CmdByte)
-      {
-        //
-        // general packet. Get the port numbers and establish listener threads
-        //
-        case 0:
-          printf("P2 General packet to SDR, size= %d\n", size);
-          //
-          // get "from" MAC address and port; this is where the data goes back to
-          //
-          memset(&reply_addr, 0, sizeof(reply_addr));
-          reply_addr.sin_family = AF_INET;
-          reply_addr.sin_addr.s_addr = addr_from.sin_addr.s_addr;
-          reply_addr.sin_port = addr_from.sin_port;                       // (but each outgoing thread needs to set its own sin_port)
-          HandleGeneralPacket(UDPInBuffer);
-          ReplyAddressSet = true;
-          if(ReplyAddressSet && StartBitReceived)
-          {
-            SDRActive = true;                                       // only set active if we have start bit too
-            SetTXEnable(true);
-          }
-          break;
-
-        //
-        // discovery packet
-        //
-        case 2:
-          printf("P2 Discovery packet\n");
-          if(SDRActive || IncompatibleFirmware)
-            DiscoveryReply[4] = 3;                             // response 2 if not active, 3 if running
-          else
-            DiscoveryReply[4] = 2;                             // response 2 if not active, 3 if running
-
-          memset(&UDPInBuffer, 0, VDISCOVERYREPLYSIZE);
-          memcpy(&UDPInBuffer, DiscoveryReply, VDISCOVERYREPLYSIZE);
-          sendto(SocketData[0].Socketid, &UDPInBuffer, VDISCOVERYREPLYSIZE, 0, (struct sockaddr *)&addr_from, sizeof(addr_from));
-          break;
-
-        case 3:
-        case 4:
-        case 5:
-          printf("Unsupported packet\n");
-          break;
-
-        default:
-          break;
-
-      }// end switch (packet type)
-    }
-//
-// now do any "post packet" processing
-//
-  } //while(1)
+  if(!ReactorAdd(SocketData[VPORTCOMMAND].Socketid, HandleCommandPort, DiscoveryReply))
+    return EXIT_FAILURE;
+  SocketData[VPORTCOMMAND].Active = true;
+  ReactorRun(ReactorTick);
   if(ThreadError)
     printf("Thread error reported - exiting\n");
   //
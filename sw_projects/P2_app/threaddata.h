@@ -73,11 +73,13 @@ extern struct ThreadSocketData SocketData[];        // data for each thread
 extern struct sockaddr_in reply_addr;               // destination address for outgoing data
 extern bool IsTXMode;                               // true if in TX
 extern bool SDRActive;                              // true if this SDR is running at the moment
+extern uint32_t SDRRunCount;                        // incremented each time SDRActive is set (a new run)
 extern bool ReplyAddressSet;                        // true when reply address has been set
 extern bool StartBitReceived;                       // true when "run" bit has been set
 extern bool NewMessageReceived;                     // set whenever a message is received
 extern bool ThreadError;                            // set true if a thread reports an error
 extern bool UseDebug;                               // true if debugging enabled
+extern bool UseWriteBehind;                         // true to queue TX DMA writes in the driver (-w option)
 extern uint8_t GlobalFIFOOverflows;                 // FIFO overflow words
 extern pthread_mutex_t g_fifo_overflow_mutex;       // protect GlobalFIFOOverflows from race conditions
 extern sem_t MicWBDMAMutex;                         // protect one DMA read channel shared by mic and WB read
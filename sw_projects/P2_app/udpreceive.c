@@ -0,0 +1,116 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// udpreceive.c:
+// batched UDP receive for the incoming protocol 2 ports
+//
+//////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+#include "udpreceive.h"
+
+
+//
+// allocate buffers for up to MaxMessages messages of MessageSize bytes
+// returns true if successful
+//
+bool UDPBatchCreate(struct UDPReceiveBatch* Batch, uint32_t MessageSize, uint32_t MaxMessages)
+{
+    uint32_t Cntr;
+
+    memset(Batch, 0, sizeof(struct UDPReceiveBatch));
+    if((MaxMessages == 0) || (MaxMessages > VMAXUDPBATCH))
+        MaxMessages = VMAXUDPBATCH;
+    Batch->Buffer = malloc(MessageSize * MaxMessages);
+    if(Batch->Buffer == NULL)
+        return false;
+    Batch->MessageSize = MessageSize;
+    Batch->MaxMessages = MaxMessages;
+    for(Cntr = 0; Cntr < MaxMessages; Cntr++)
+    {
+        Batch->Iovecs[Cntr].iov_base = UDPBatchData(Batch, Cntr);
+        Batch->Iovecs[Cntr].iov_len = MessageSize;
+        Batch->Msgs[Cntr].msg_hdr.msg_iov = &Batch->Iovecs[Cntr];
+        Batch->Msgs[Cntr].msg_hdr.msg_iovlen = 1;
+        Batch->Msgs[Cntr].msg_hdr.msg_name = &Batch->Addrs[Cntr];
+    }
+    return true;
+}
+
+
+//
+// release the buffers
+//
+void UDPBatchDestroy(struct UDPReceiveBatch* Batch)
+{
+    free(Batch->Buffer);
+    Batch->Buffer = NULL;
+    Batch->Count = 0;
+    Batch->Next = 0;
+}
+
+
+//
+// wait up to TimeoutMs (-1 = no limit) for messages on a socket, then read all those queued.
+// the read doesn't wait, so the socket receive timeout set by MakeSocket() plays no part.
+// returns number of messages received, 0 if timed out, or -1 if error (errno set)
+//
+int UDPBatchReceive(struct UDPReceiveBatch* Batch, int Socketid, int TimeoutMs)
+{
+    struct pollfd PollData;
+    uint32_t Cntr;
+    int Result;
+
+    Batch->Count = 0;
+    Batch->Next = 0;
+    PollData.fd = Socketid;
+    PollData.events = POLLIN;
+    Result = poll(&PollData, 1, TimeoutMs);
+    if(Result < 0)
+        return (errno == EINTR) ? 0 : -1;
+    if(Result == 0)
+        return 0;
+
+    for(Cntr = 0; Cntr < Batch->MaxMessages; Cntr++)
+        Batch->Msgs[Cntr].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    Result = recvmmsg(Socketid, Batch->Msgs, Batch->MaxMessages, MSG_DONTWAIT, NULL);
+    if(Result < 0)
+        return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+    Batch->Count = (uint32_t)Result;
+    return Result;
+}
+
+
+//
+// return the next message, receiving a new batch when all of the last one have been returned.
+// sets *Data to the message; returns its length, or -1 with errno = EAGAIN if timed out
+// (as recvmsg() with a receive timeout), or -1 if error
+//
+int UDPBatchNext(struct UDPReceiveBatch* Batch, int Socketid, int TimeoutMs, uint8_t** Data)
+{
+    int Result;
+
+    if(Batch->Next >= Batch->Count)
+    {
+        Result = UDPBatchReceive(Batch, Socketid, TimeoutMs);
+        if(Result < 0)
+            return -1;
+        if(Result == 0)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+    *Data = UDPBatchData(Batch, Batch->Next);
+    return (int)UDPBatchLength(Batch, Batch->Next++);
+}
@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// udpreceive.h:
+// batched UDP receive for the incoming protocol 2 ports
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __udpreceive_h
+#define __udpreceive_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+
+#define VMAXUDPBATCH 32                         // max messages per receive call
+
+
+//
+// a set of receive buffers, filled by one recvmmsg() call.
+// the wait for the 1st message blocks in poll() (not on the socket receive timeout);
+// then every message already queued, up to MaxMessages, is read in the same call.
+// not thread safe: intended for one receiving thread.
+//
+struct UDPReceiveBatch
+{
+    uint8_t* Buffer;                            // MaxMessages buffers of MessageSize bytes
+    uint32_t MessageSize;                       // buffer size per message
+    uint32_t MaxMessages;                       // messages per receive call
+    uint32_t Count;                             // messages received by the last call
+    uint32_t Next;                              // next message returned by UDPBatchNext()
+    struct mmsghdr Msgs[VMAXUDPBATCH];          // one header per message
+    struct iovec Iovecs[VMAXUDPBATCH];
+    struct sockaddr_in Addrs[VMAXUDPBATCH];     // source address of each message
+};
+
+
+//
+// allocate buffers for up to MaxMessages messages of MessageSize bytes
+// returns true if successful
+//
+bool UDPBatchCreate(struct UDPReceiveBatch* Batch, uint32_t MessageSize, uint32_t MaxMessages);
+
+
+//
+// release the buffers
+//
+void UDPBatchDestroy(struct UDPReceiveBatch* Batch);
+
+
+//
+// wait up to TimeoutMs (-1 = no limit) for messages on a socket, then read all those queued
+// returns number of messages received, 0 if timed out, or -1 if error (errno set)
+//
+int UDPBatchReceive(struct UDPReceiveBatch* Batch, int Socketid, int TimeoutMs);
+
+
+//
+// return the next message, receiving a new batch when all of the last one have been returned.
+// sets *Data to the message; returns its length, or -1 with errno = EAGAIN if timed out
+// (as recvmsg() with a receive timeout), or -1 if error
+//
+int UDPBatchNext(struct UDPReceiveBatch* Batch, int Socketid, int TimeoutMs, uint8_t** Data);
+
+
+//
+// access message N of the last batch received
+//
+static inline uint8_t* UDPBatchData(struct UDPReceiveBatch* Batch, uint32_t N)
+{
+    return Batch->Buffer + N * Batch->MessageSize;
+}
+
+static inline uint32_t UDPBatchLength(struct UDPReceiveBatch* Batch, uint32_t N)
+{
+    return Batch->Msgs[N].msg_len;
+}
+
+static inline struct sockaddr_in* UDPBatchFrom(struct UDPReceiveBatch* Batch, uint32_t N)
+{
+    return &Batch->Addrs[N];
+}
+
+
+#endif
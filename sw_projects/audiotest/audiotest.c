@@ -322,9 +322,7 @@ void cleanup(AppContext *app, AudioContext *audio)
     if (audio->read_buffer) free(audio->read_buffer);
     if (audio->dma_write_fd >= 0) close(audio->dma_write_fd);
     if (audio->dma_read_fd >= 0) close(audio->dma_read_fd);
-    sem_destroy(&DDCInSelMutex);
     sem_destroy(&DDCResetFIFOMutex);
-    sem_destroy(&RFGPIOMutex);
     sem_destroy(&CodecRegMutex);
     pthread_mutex_destroy(&audio->mic_test_mutex);
     pthread_mutex_destroy(&audio->speaker_test_mutex);
@@ -946,7 +944,6 @@ int main(int argc, char *argv[])
     audio.buffer_size = MEM_BUFFER_SIZE;
     pthread_t ptt_thread, mic_test_thread, speaker_test_thread;
     void *thread_args[2] = {&app, &audio};
-    unsigned int PCBVersion;
 
 
     // Initialize circular buffer
@@ -1128,17 +1125,6 @@ int main(int argc, char *argv[])
     }
 
     printf("Initializing synchronization primitives...\n");
-    if (sem_init(&DDCInSelMutex, 0, 1) != 0) 
-    {
-        fprintf(stderr, "Failed to init DDCInSelMutex: %s\n", strerror(errno));
-        hardware_available = false;
-        cleanup(&app, &audio);
-        return EXIT_FAILURE;
-    }
-    else
-    {
-        printf("DDCInSelMutex initialized\n");
-    }
     if (sem_init(&DDCResetFIFOMutex, 0, 1) != 0) 
     {
         fprintf(stderr, "Failed to init DDCResetFIFOMutex: %s\n", strerror(errno));
@@ -1150,16 +1136,6 @@ int main(int argc, char *argv[])
     {
         printf("DDCResetFIFOMutex initialized\n");
     }
-    if (sem_init(&RFGPIOMutex, 0, 1) != 0) 
-    {
-        fprintf(stderr, "Failed to init RFGPIOMutex: %s\n", strerror(errno));
-        hardware_available = false;
-        cleanup(&app, &audio);
-        return EXIT_FAILURE;
-    }else
-    {
-        printf("RFGPIOMutex initialized\n");
-    }
     if (pthread_mutex_init(&audio.mic_test_mutex, NULL) != 0)
     {
         fprintf(stderr, "Failed to init mic_test_mutex: %s\n", strerror(errno));
@@ -1197,8 +1173,7 @@ int main(int argc, char *argv[])
     {
         printf("XDMA driver opened successfully\n");
         PrintVersionInfo();
-        PCBVersion = GetPCBVersionNumber();
-        CodecInitialise(PCBVersion);            // pass Saturn PCB version so CODEC can be identified
+        CodecInitialise();                      // CODEC type identified from Saturn PCB version
         SetByteSwapping(false);
         SetSpkrMute(false);
         uint32_t codecReg = RegisterRead(VADDRCODECSPIREG);
@@ -141,9 +141,7 @@ void on_sensor3_button_changed()
 void on_window_main_destroy()
 {
     gtk_main_quit();
-	sem_destroy(&DDCInSelMutex);
 	sem_destroy(&DDCResetFIFOMutex);
-	sem_destroy(&RFGPIOMutex);
 	sem_destroy(&CodecRegMutex);
 	SetMOX(false);
 	SetTXEnable(false);
@@ -211,7 +209,6 @@ int main(int argc, char *argv[])
 {
     guint Context;                                  // status bar context
     int XDMAAccess = 0;
-    unsigned int PCBVersion;
 
 
     gtk_init(&argc, &argv);
@@ -244,9 +241,7 @@ int main(int argc, char *argv[])
   //
   // initialise register access semaphores
   //
-  	sem_init(&DDCInSelMutex, 0, 1);                                   // for DDC input select register
   	sem_init(&DDCResetFIFOMutex, 0, 1);                               // for FIFO reset register
-  	sem_init(&RFGPIOMutex, 0, 1);                                     // for RF GPIO register
   	sem_init(&CodecRegMutex, 0, 1);                                   // for codec writes
 
 	XDMAAccess = OpenXDMADriver(true);
@@ -255,8 +250,7 @@ int main(int argc, char *argv[])
         gtk_statusbar_push(StatusBar, Context, "Connected to /dev/xdma0_user");    
     }
 	PrintVersionInfo();
-    PCBVersion = GetPCBVersionNumber();
-	CodecInitialise(PCBVersion);
+	CodecInitialise();
 	SetByteSwapping(false);                                            // h/w to generate normalbyte order
 	SetSpkrMute(false);
     SetTXDriveLevel(0);                                                 // DAC current & Atten value
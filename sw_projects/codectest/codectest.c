@@ -305,9 +305,7 @@ int main(int argc, char *argv[])
   //
   // initialise register access semaphores
   //
-  		sem_init(&DDCInSelMutex, 0, 1);                                   // for DDC input select register
   		sem_init(&DDCResetFIFOMutex, 0, 1);                               // for FIFO reset register
-  		sem_init(&RFGPIOMutex, 0, 1);                                     // for RF GPIO register
   		sem_init(&CodecRegMutex, 0, 1);                                   // for codec writes
 
 		OpenXDMADriver(false);
@@ -385,9 +383,7 @@ out:
 		close(DMAWritefile_fd);
 		close(DMAReadfile_fd);
 		free(WriteBuffer);
-  		sem_destroy(&DDCInSelMutex);
   		sem_destroy(&DDCResetFIFOMutex);
-  		sem_destroy(&RFGPIOMutex);
   		sem_destroy(&CodecRegMutex);
 	}
 }
@@ -0,0 +1,97 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// capabilities.c:
+// hardware capabilities of the Saturn board and its FPGA firmware
+//
+// the firmware and PCB versions cannot change while an app runs, so the
+// registers are read once and the results held in a struct that is never
+// written again. This keeps version register reads out of the status loops.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/capabilities.h"
+#include <pthread.h>
+#include <stdio.h>
+
+
+static struct SaturnCapabilities Capabilities;
+static pthread_once_t CapabilitiesProbed = PTHREAD_ONCE_INIT;
+
+
+//
+// default DMA FIFO depths, before firmware V10
+//
+static const uint32_t DefaultFIFODepths[VNUMDMAFIFO] =
+{
+    8192,             //  eRXDDCDMA,		selects RX
+    1024,             //  eTXDUCDMA,		selects TX
+    256,              //  eMicCodecDMA,	selects mic samples
+    256               //  eSpkCodecDMA	selects speaker samples
+};
+
+
+//
+// ProbeCapabilities(void)
+// read the version registers and derive the capabilities
+// called once only, by pthread_once()
+//
+static void ProbeCapabilities(void)
+{
+    struct SaturnCapabilities* Caps = &Capabilities;
+    unsigned int Version;
+    unsigned int Cntr;
+
+    Version = GetFirmwareVersion(&Caps->FirmwareID);
+    Caps->FirmwareVersion = Version;
+    Caps->FirmwareMajorVersion = GetFirmwareMajorVersion();
+    Caps->PCBVersion = GetPCBVersionNumber();
+
+    if (Caps->PCBVersion >= 3)
+        Caps->CodecType = e3204;
+    else
+        Caps->CodecType = e23b;
+    Caps->HasTXHighPassFilter = (Caps->PCBVersion >= 3);
+
+    Caps->HasAlexTXAntRegister = (Version >= 12);
+    Caps->HasWordAddressedKeyerRAM = (Version >= 14);
+    Caps->HasADCPeakRegisters = (Version >= 27);
+
+    //
+    // FIFO sizes are firmware version dependent
+    //
+    for (Cntr = 0; Cntr < VNUMDMAFIFO; Cntr++)
+        Caps->FIFODepths[Cntr] = DefaultFIFODepths[Cntr];
+    if ((Version >= 10) && (Version <= 12))
+    {
+        printf("loading new FIFO sizes for updated firmware <= 12\n");
+        Caps->FIFODepths[0] = 16384;       //  eRXDDCDMA,		selects RX
+        Caps->FIFODepths[1] = 2048;        //  eTXDUCDMA,		selects TX
+        Caps->FIFODepths[2] = 256;         //  eMicCodecDMA,	selects mic samples
+        Caps->FIFODepths[3] = 1024;        //  eSpkCodecDMA	selects speaker samples
+    }
+    else if (Version >= 13)
+    {
+        printf("loading new FIFO sizes for updated firmware V13+\n");
+        Caps->FIFODepths[0] = 16384;       //  eRXDDCDMA,		selects RX
+        Caps->FIFODepths[1] = 4096;        //  eTXDUCDMA,		selects TX
+        Caps->FIFODepths[2] = 256;         //  eMicCodecDMA,	selects mic samples
+        Caps->FIFODepths[3] = 1024;        //  eSpkCodecDMA	selects speaker samples
+    }
+}
+
+
+//
+// const struct SaturnCapabilities* GetCapabilities(void)
+//
+const struct SaturnCapabilities* GetCapabilities(void)
+{
+    pthread_once(&CapabilitiesProbed, ProbeCapabilities);
+    return &Capabilities;
+}
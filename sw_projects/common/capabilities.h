@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// capabilities.h:
+// hardware capabilities of the Saturn board and its FPGA firmware
+// probed once from the version registers, then read from memory
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __capabilities_h
+#define __capabilities_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturnregisters.h"
+#include "../common/version.h"
+
+
+//
+// codec fitted to the Saturn board
+//
+typedef enum
+{
+    e23b,                               // TLV320AIC23B (now obsolete)
+    e3204                               // TLV320AIC3204 (suitable replacement)
+} ECodecType;
+
+
+//
+// hardware capabilities
+// version dependent code should test these flags, not the version numbers
+//
+struct SaturnCapabilities
+{
+    ESoftwareID FirmwareID;                         // FPGA software ID
+    unsigned int FirmwareVersion;                   // 16 bit FPGA firmware version
+    unsigned int FirmwareMajorVersion;              // 7 bit FPGA firmware major version
+    uint16_t PCBVersion;                            // 1: 1st prototype; 2: production V1; 3: production V2
+    ECodecType CodecType;                           // codec fitted (from PCB version)
+    uint32_t FIFODepths[VNUMDMAFIFO];               // DMA FIFO depths, 64 bit words
+    bool HasAlexTXAntRegister;                      // V12+: separate Alex TX filter/TX antenna register
+    bool HasWordAddressedKeyerRAM;                  // V14+: keyer ramp length is a word address; 20ms max ramp
+    bool HasADCPeakRegisters;                       // V27+: ADC peak amplitude registers after the overflow register
+    bool HasTXHighPassFilter;                       // PCB V3+: TX high pass filter above 49MHz
+};
+
+
+//
+// const struct SaturnCapabilities* GetCapabilities(void)
+// returns the board capabilities. The first call reads the version registers,
+// so must be made after OpenXDMADriver(); later calls make no register access.
+//
+const struct SaturnCapabilities* GetCapabilities(void);
+
+
+#endif
@@ -26,11 +26,79 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
 
 #define VMEMBUFFERSIZE 32768										// memory buffer to reserve
 #define AXIBaseAddress 0x10000									// address of StreamRead/Writer IP
+#define VREGISTERMAPSIZE 0x10000								// user BAR space mapped for register access
+
+//
+// XDMA driver register batch ioctl (see cdev_ctrl.h in the driver)
+//
+struct XDMARegBatch
+{
+	uint32_t Count;
+	uint32_t Pad;
+	uint64_t Ops;											// pointer to struct RegisterOp[Count]
+};
+#define VXDMAIOCREGBATCH _IOWR('x', 4, struct XDMARegBatch)	// read values are copied back
+_Static_assert(sizeof(struct XDMARegBatch) == 16, "must match struct xdma_reg_batch in the driver");
+_Static_assert(VXDMAIOCREGBATCH == 0xC0107804, "must match XDMA_IOCREGBATCH in the driver");
+
+//
+// XDMA driver pinned buffer ioctls (see cdev_sgdma.h in the driver)
+//
+struct XDMAPinBuffer
+{
+	uint64_t Addr;											// user buffer address
+	uint64_t Length;
+	uint32_t Handle;										// returned by driver
+	uint32_t Pad;
+};
+struct XDMAPinnedTransfer
+{
+	uint32_t Handle;
+	uint32_t Pad;
+	uint64_t Offset;										// byte offset in pinned buffer
+	uint64_t Length;
+	uint64_t AXIAddr;
+};
+#define VXDMAIOCBUFPIN _IOWR('q', 7, struct XDMAPinBuffer)
+#define VXDMAIOCBUFUNPIN _IOW('q', 8, int)
+#define VXDMAIOCPINNEDXFER _IOW('q', 9, struct XDMAPinnedTransfer)
+
+//
+// XDMA driver streaming ring ioctls (see cdev_sgdma.h in the driver)
+//
+struct XDMAStreamStart
+{
+	uint64_t AXIAddr;										// FPGA address each block is read from
+	uint32_t BlockSize;
+	uint32_t BlockCount;
+	uint32_t MapLength;										// returned by driver
+	uint32_t Pad;
+};
+#define VXDMAIOCSTREAMSTART _IOWR('q', 10, struct XDMAStreamStart)
+#define VXDMAIOCSTREAMSTOP _IO('q', 11)
+
+//
+// XDMA driver write-behind ring ioctls (see cdev_sgdma.h in the driver)
+//
+struct XDMAWriteBehindStart
+{
+	uint64_t AXIAddr;										// FPGA address written
+	uint32_t RingLength;									// power of 2
+	uint32_t MaxTransfer;									// largest DMA to the FPGA
+};
+#define VXDMAIOCWBSTART _IOW('q', 12, struct XDMAWriteBehindStart)
+#define VXDMAIOCWBSTOP _IO('q', 13)
 
 #include "../common/hwaccess.h"
 
@@ -39,6 +107,23 @@
 // mem read/write variables:
 //
 	int register_fd;                             // device identifier
+	volatile uint32_t* RegisterBase = NULL;      // user BAR mapped into memory; NULL if not mapped
+	bool RegisterBatchIoctl = true;              // false if driver has no register batch ioctl
+
+//
+// DMA buffers registered with the driver. An entry is filled in before InUse is set,
+// so DMA calls can search the table without taking the mutex.
+//
+struct PinnedDMABuffer
+{
+	int fd;                                      // DMA file device it was registered on
+	unsigned char* Base;
+	uint32_t Length;
+	uint32_t Handle;                             // driver handle
+	bool InUse;
+};
+static struct PinnedDMABuffer PinnedBuffers[VMAXPINNEDDMABUFFERS];
+static pthread_mutex_t PinnedBufferMutex = PTHREAD_MUTEX_INITIALIZER;
 
 
 
@@ -59,6 +144,17 @@ int OpenXDMADriver(bool Silent)
 		if(!Silent)
 			printf("register access connected to /dev/xdma0_user\n");
         Result = 1;
+        //
+        // map the user BAR so registers can be read and written directly, without a system call.
+        // if the driver won't map it, registers are accessed by pread/pwrite instead.
+        //
+        RegisterBase = mmap(NULL, VREGISTERMAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, register_fd, 0);
+        if (RegisterBase == MAP_FAILED)
+        {
+            RegisterBase = NULL;
+            if(!Silent)
+                printf("register space mmap failed; using read/write calls\n");
+        }
     }
     return Result;
 }
@@ -69,10 +165,108 @@ int OpenXDMADriver(bool Silent)
 //
 void CloseXDMADriver(void)
 {
+    if (RegisterBase != NULL)
+        munmap((void*)RegisterBase, VREGISTERMAPSIZE);
+    RegisterBase = NULL;
     close(register_fd);
 }
 
 
+//
+// register a DMA buffer with the driver
+// returns 0 if success, else an error code
+//
+int DMARegisterBuffer(int fd, unsigned char* Buffer, uint32_t Length)
+{
+	struct XDMAPinBuffer Pin;
+	uint32_t Cntr;
+	int Result = -ENOSPC;
+
+	if ((fd < 0) || (Buffer == NULL) || (Length == 0))
+		return -EINVAL;
+	pthread_mutex_lock(&PinnedBufferMutex);
+	for (Cntr = 0; Cntr < VMAXPINNEDDMABUFFERS; Cntr++)
+	{
+		if (PinnedBuffers[Cntr].InUse)
+			continue;
+		Pin.Addr = (uint64_t)(uintptr_t)Buffer;
+		Pin.Length = Length;
+		Pin.Handle = 0;
+		Pin.Pad = 0;
+		if (ioctl(fd, VXDMAIOCBUFPIN, &Pin) != 0)
+		{
+			Result = -errno;							// old driver gives EINVAL: use pread/pwrite
+			break;
+		}
+		PinnedBuffers[Cntr].fd = fd;
+		PinnedBuffers[Cntr].Base = Buffer;
+		PinnedBuffers[Cntr].Length = Length;
+		PinnedBuffers[Cntr].Handle = Pin.Handle;
+		__atomic_store_n(&PinnedBuffers[Cntr].InUse, true, __ATOMIC_RELEASE);
+		Result = 0;
+		break;
+	}
+	pthread_mutex_unlock(&PinnedBufferMutex);
+	return Result;
+}
+
+
+//
+// unregister a DMA buffer
+//
+void DMAUnregisterBuffer(int fd, unsigned char* Buffer)
+{
+	uint32_t Cntr;
+
+	pthread_mutex_lock(&PinnedBufferMutex);
+	for (Cntr = 0; Cntr < VMAXPINNEDDMABUFFERS; Cntr++)
+	{
+		if (PinnedBuffers[Cntr].InUse && (PinnedBuffers[Cntr].fd == fd) && (PinnedBuffers[Cntr].Base == Buffer))
+		{
+			__atomic_store_n(&PinnedBuffers[Cntr].InUse, false, __ATOMIC_RELEASE);
+			ioctl(fd, VXDMAIOCBUFUNPIN, (int)PinnedBuffers[Cntr].Handle);
+		}
+	}
+	pthread_mutex_unlock(&PinnedBufferMutex);
+}
+
+
+//
+// find the registered buffer holding a transfer; NULL if none
+//
+static struct PinnedDMABuffer* FindPinnedBuffer(int fd, unsigned char* Data, uint32_t Length)
+{
+	struct PinnedDMABuffer* Pinned;
+	uint32_t Cntr;
+
+	for (Cntr = 0; Cntr < VMAXPINNEDDMABUFFERS; Cntr++)
+	{
+		Pinned = &PinnedBuffers[Cntr];
+		if (__atomic_load_n(&Pinned->InUse, __ATOMIC_ACQUIRE) && (Pinned->fd == fd) && (Data >= Pinned->Base)
+		    && ((uint64_t)(Data - Pinned->Base) + Length <= Pinned->Length))
+			return Pinned;
+	}
+	return NULL;
+}
+
+
+//
+// DMA to or from part of a registered buffer
+// returns the number of bytes transferred, or -1 with errno set (as pread/pwrite)
+//
+static ssize_t PinnedTransfer(struct PinnedDMABuffer* Pinned, unsigned char* Data, uint32_t Length, uint32_t AXIAddr)
+{
+	struct XDMAPinnedTransfer Transfer;
+
+	Transfer.Handle = Pinned->Handle;
+	Transfer.Pad = 0;
+	Transfer.Offset = Data - Pinned->Base;
+	Transfer.Length = Length;
+	Transfer.AXIAddr = AXIAddr;
+	return ioctl(Pinned->fd, VXDMAIOCPINNEDXFER, &Transfer);
+}
+
+
 //
 // initiate a DMA to the FPGA with specified parameters
 // returns 0 if success, else an error code
@@ -85,11 +279,16 @@ int DMAWriteToFPGA(int fd, unsigned char*SrcData, uint32_t Length, uint32_t AXIA
 {
 	ssize_t rc;									// response code
 	off_t OffsetAddr;
+	struct PinnedDMABuffer* Pinned;
 
 	OffsetAddr = AXIAddr;
 
 	// write data to FPGA from memory buffer
-	rc = pwrite(fd, SrcData, Length, OffsetAddr);
+	Pinned = FindPinnedBuffer(fd, SrcData, Length);
+	if (Pinned != NULL)
+		rc = PinnedTransfer(Pinned, SrcData, Length, AXIAddr);
+	else
+		rc = pwrite(fd, SrcData, Length, OffsetAddr);
 	if (rc < 0)
 	{
 		printf("write 0x%x @ 0x%lx failed %ld.\n", Length, OffsetAddr, rc);
@@ -111,11 +310,16 @@ int DMAReadFromFPGA(int fd, unsigned char*DestData, uint32_t Length, uint32_t AX
 {
 	ssize_t rc;									// response code
 	off_t OffsetAddr;
+	struct PinnedDMABuffer* Pinned;
 
 	OffsetAddr = AXIAddr;
 
 	// read data from FPGA to memory buffer
-	rc = pread(fd, DestData, Length, OffsetAddr);
+	Pinned = FindPinnedBuffer(fd, DestData, Length);
+	if (Pinned != NULL)
+		rc = PinnedTransfer(Pinned, DestData, Length, AXIAddr);
+	else
+		rc = pread(fd, DestData, Length, OffsetAddr);
 	if (rc < 0)
 	{
 		printf("read 0x%x @ 0x%lx failed %ld.\n", Length, OffsetAddr, rc);
@@ -125,13 +329,362 @@ int DMAReadFromFPGA(int fd, unsigned char*DestData, uint32_t Length, uint32_t AX
 	return 0;
 }
 
+//
+// start a kernel streaming ring
+// the control page is mapped on its own; the data blocks are mapped twice, into the
+// two halves of a reserved address range, so they form a mirrored ring buffer.
+//
+int DMAStreamOpen(struct DMAStreamRing* Stream, int fd, uint32_t AXIAddr, uint32_t BlockSize, uint32_t BlockCount)
+{
+	struct XDMAStreamStart Start;
+	long PageSize;
+	uint32_t Size;
+	void* Control;
+	unsigned char* Addr;
+
+	memset(Stream, 0, sizeof(struct DMAStreamRing));
+	Stream->fd = fd;
+	PageSize = sysconf(_SC_PAGESIZE);
+	Size = BlockSize * BlockCount;
+	if ((Size == 0) || (Size % PageSize))
+		return -EINVAL;
+
+	Start.AXIAddr = AXIAddr;
+	Start.BlockSize = BlockSize;
+	Start.BlockCount = BlockCount;
+	Start.MapLength = 0;
+	Start.Pad = 0;
+	if (ioctl(fd, VXDMAIOCSTREAMSTART, &Start) != 0)
+		return -errno;
+
+	Control = mmap(NULL, PageSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (Control == MAP_FAILED)
+	{
+		perror("DMA stream control mmap");
+		ioctl(fd, VXDMAIOCSTREAMSTOP);
+		return -EIO;
+	}
+	Stream->Control = Control;
+	Addr = mmap(NULL, 2 * Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if ((Addr == MAP_FAILED)
+	    || (mmap(Addr, Size, PROT_READ, MAP_SHARED | MAP_FIXED, fd, Stream->Control->DataOffset) == MAP_FAILED)
+	    || (mmap(Addr + Size, Size, PROT_READ, MAP_SHARED | MAP_FIXED, fd, Stream->Control->DataOffset) == MAP_FAILED))
+	{
+		perror("DMA stream ring mmap");
+		if (Addr != MAP_FAILED)
+			munmap(Addr, 2 * Size);
+		munmap(Control, PageSize);
+		ioctl(fd, VXDMAIOCSTREAMSTOP);
+		return -EIO;
+	}
+	Stream->Ring.Base = Addr;
+	Stream->Ring.Size = Size;
+	Stream->BlockSize = BlockSize;
+	Stream->BlockCount = BlockCount;
+	return 0;
+}
+
+
+//
+// wait for filled blocks, and add them to the ring
+//
+int DMAStreamWait(struct DMAStreamRing* Stream, uint32_t TimeoutMs)
+{
+	struct pollfd PollFd;
+	uint32_t Head;
+	uint32_t Blocks;
+
+	Head = __atomic_load_n(&Stream->Control->Head, __ATOMIC_ACQUIRE);
+	if (Head == Stream->Head)
+	{
+		PollFd.fd = Stream->fd;
+		PollFd.events = POLLIN;
+		PollFd.revents = 0;
+		if (poll(&PollFd, 1, (int)TimeoutMs) < 0)
+			return (errno == EINTR) ? 0 : -errno;
+		if (Stream->Control->Error != 0)
+			return -EIO;
+		Head = __atomic_load_n(&Stream->Control->Head, __ATOMIC_ACQUIRE);
+	}
+	Blocks = Head - Stream->Head;
+	if (Blocks == 0)
+		return 0;
+	if ((uint64_t)Blocks * Stream->BlockSize > RingBufferSpace(&Stream->Ring))
+	{
+		//
+		// the driver has lapped us: restart from the newest block
+		//
+		Stream->Ring.WriteOffset = (Head % Stream->BlockCount) * Stream->BlockSize;
+		Stream->Ring.ReadOffset = Stream->Ring.WriteOffset;
+		Stream->Ring.Fill = 0;
+		Stream->Head = Head;
+		Stream->Control->Tail = Head;
+		return -EOVERFLOW;
+	}
+	RingBufferCommit(&Stream->Ring, Blocks * Stream->BlockSize);
+	Stream->Head = Head;
+	return (int)(Blocks * Stream->BlockSize);
+}
+
+
+//
+// release the blocks that are wholly consumed
+//
+void DMAStreamRelease(struct DMAStreamRing* Stream)
+{
+	uint32_t Unread;
+
+	Unread = (Stream->Ring.Fill + Stream->BlockSize - 1) / Stream->BlockSize;
+	__atomic_store_n(&Stream->Control->Tail, Stream->Head - Unread, __ATOMIC_RELEASE);
+}
+
+
+//
+// stop the streaming ring
+// the driver keeps the memory until it is unmapped here
+//
+void DMAStreamClose(struct DMAStreamRing* Stream)
+{
+	if (Stream->Control == NULL)
+		return;
+	if ((ioctl(Stream->fd, VXDMAIOCSTREAMSTOP) < 0) && (errno == EBUSY))
+		printf("DMA streaming ring did not stop: engine unusable until it does\n");
+	if (Stream->Ring.Base != NULL)
+		munmap(Stream->Ring.Base, 2 * Stream->Ring.Size);
+	munmap((void*)Stream->Control, sysconf(_SC_PAGESIZE));
+	memset(Stream, 0, sizeof(struct DMAStreamRing));
+	Stream->fd = -1;
+}
+
+
+//
+// start the driver write-behind ring
+//
+int DMAWriteBehindStart(int fd, uint32_t AXIAddr, uint32_t RingLength, uint32_t MaxTransfer)
+{
+	struct XDMAWriteBehindStart Start;
+
+	Start.AXIAddr = AXIAddr;
+	Start.RingLength = RingLength;
+	Start.MaxTransfer = MaxTransfer;
+	if (ioctl(fd, VXDMAIOCWBSTART, &Start) != 0)
+		return -errno;
+	return 0;
+}
+
+
+//
+// send any queued data, and stop the write-behind ring
+//
+int DMAWriteBehindStop(int fd)
+{
+	if (ioctl(fd, VXDMAIOCWBSTOP) != 0)
+		return -errno;
+	return 0;
+}
+
+
+//
+// linux AIO system calls (no library wrapper needed)
+//
+static int io_setup(unsigned NumEvents, aio_context_t* Context)
+{
+	return syscall(SYS_io_setup, NumEvents, Context);
+}
+
+static int io_destroy(aio_context_t Context)
+{
+	return syscall(SYS_io_destroy, Context);
+}
+
+static int io_submit(aio_context_t Context, long NumRequests, struct iocb** Requests)
+{
+	return syscall(SYS_io_submit, Context, NumRequests, Requests);
+}
+
+static int io_getevents(aio_context_t Context, long MinEvents, long MaxEvents, struct io_event* Events, struct timespec* Timeout)
+{
+	return syscall(SYS_io_getevents, Context, MinEvents, MaxEvents, Events, Timeout);
+}
+
+static uint64_t TimeDifferenceNs(struct timespec* Start, struct timespec* End)
+{
+	return (uint64_t)(End->tv_sec - Start->tv_sec) * 1000000000ULL + End->tv_nsec - Start->tv_nsec;
+}
+
+
+//
+// open an overlapped DMA reader
+// returns 0 if success, else an error code
+//
+int AsyncDMAReadOpen(struct AsyncDMAReader* Reader, int fd, uint32_t AXIAddr, uint32_t NumBuffers,
+                     uint32_t Length, unsigned char** Buffers)
+{
+	uint32_t Cntr;
+
+	if ((NumBuffers == 0) || (NumBuffers > VMAXASYNCDMABUFFERS))
+		return -EINVAL;
+	memset(Reader, 0, sizeof(struct AsyncDMAReader));
+	if (io_setup(NumBuffers, &Reader->Context) < 0)
+	{
+		perror("DMA AIO setup");
+		return -EIO;
+	}
+	Reader->fd = fd;
+	Reader->AXIAddr = AXIAddr;
+	Reader->NumBuffers = NumBuffers;
+	Reader->Length = Length;
+	for (Cntr = 0; Cntr < NumBuffers; Cntr++)
+	{
+		Reader->Buffers[Cntr] = Buffers[Cntr];
+		Reader->Control[Cntr].aio_data = Cntr;							// returned in completion event
+		Reader->Control[Cntr].aio_lio_opcode = IOCB_CMD_PREAD;
+		Reader->Control[Cntr].aio_fildes = fd;
+		Reader->Control[Cntr].aio_buf = (uint64_t)(uintptr_t)Buffers[Cntr];
+		Reader->Control[Cntr].aio_nbytes = Length;
+		Reader->Control[Cntr].aio_offset = AXIAddr;
+	}
+	return 0;
+}
+
+
+//
+// submit a DMA into one buffer. DMAs complete in the order they are submitted.
+// returns 0 if success, else an error code
+//
+int AsyncDMAReadSubmit(struct AsyncDMAReader* Reader, uint32_t Buffer)
+{
+	struct iocb* Request;
+
+	if (Buffer >= Reader->NumBuffers)
+		return -EINVAL;
+	if (Reader->Completions == 0 && Reader->InFlight == 0)
+		clock_gettime(CLOCK_MONOTONIC, &Reader->StartTime);
+	Request = &Reader->Control[Buffer];
+	if (io_submit(Reader->Context, 1, &Request) != 1)
+	{
+		printf("async read 0x%llx @ 0x%x submit failed\n", (unsigned long long)Request->aio_nbytes, Reader->AXIAddr);
+		perror("DMA read");
+		return -EIO;
+	}
+	Reader->InFlight++;
+	return 0;
+}
+
+
+//
+// submit a DMA of Length bytes to Address, using one buffer's control block.
+// lets the caller place each DMA, and size it, as it goes.
+// returns 0 if success, else an error code
+//
+int AsyncDMAReadSubmitTo(struct AsyncDMAReader* Reader, uint32_t Buffer, unsigned char* Address, uint32_t Length)
+{
+	if (Buffer >= Reader->NumBuffers)
+		return -EINVAL;
+	Reader->Buffers[Buffer] = Address;
+	Reader->Control[Buffer].aio_buf = (uint64_t)(uintptr_t)Address;
+	Reader->Control[Buffer].aio_nbytes = Length;
+	return AsyncDMAReadSubmit(Reader, Buffer);
+}
+
+
+//
+// wait for the oldest submitted DMA to complete
+// returns the index of the buffer filled, or a negative error code
+// a completion already available is collected without blocking, so the wait time
+// measured is only the time the caller was actually held up.
+//
+int AsyncDMAReadWait(struct AsyncDMAReader* Reader)
+{
+	struct io_event Event;
+	struct timespec NoWait = {0, 0};
+	struct timespec WaitStart;
+	bool Waited = false;
+	int Result;
+
+	if (Reader->InFlight == 0)
+		return -EINVAL;
+	Result = io_getevents(Reader->Context, 1, 1, &Event, &NoWait);
+	if (Result != 1)
+	{
+		Waited = true;
+		clock_gettime(CLOCK_MONOTONIC, &WaitStart);
+		do
+			Result = io_getevents(Reader->Context, 1, 1, &Event, NULL);
+		while ((Result < 0) && (errno == EINTR));
+	}
+	if (Result != 1)
+	{
+		perror("DMA AIO wait");
+		return -EIO;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &Reader->LastCompleteTime);
+	if (Waited)
+		Reader->WaitTimeNs += TimeDifferenceNs(&WaitStart, &Reader->LastCompleteTime);
+	else
+		Reader->ReadyCompletions++;
+	Reader->InFlight--;
+	Reader->Completions++;
+	if ((Event.data >= Reader->NumBuffers) || (Event.res != (int64_t)Reader->Control[Event.data].aio_nbytes))
+	{
+		printf("async read @ 0x%x failed %lld.\n", Reader->AXIAddr, (long long)Event.res);
+		return -EIO;
+	}
+	return (int)Event.data;
+}
+
+
+//
+// wait for any DMAs still in flight, then release the reader
+//
+void AsyncDMAReadClose(struct AsyncDMAReader* Reader)
+{
+	uint32_t InFlight;
+
+	while (Reader->InFlight != 0)
+	{
+		InFlight = Reader->InFlight;
+		AsyncDMAReadWait(Reader);
+		if (Reader->InFlight == InFlight)						// no completion collected: give up
+			break;
+	}
+	io_destroy(Reader->Context);
+	Reader->Context = 0;
+}
+
+
+//
+// overlap efficiency: the percentage of time since the 1st DMA was submitted that the caller
+// was NOT blocked waiting for a DMA to complete.
+//
+float AsyncDMAOverlapEfficiency(struct AsyncDMAReader* Reader, float* ReadyPercent)
+{
+	uint64_t ElapsedNs;
+	float Efficiency = 0.0F;
+
+	if (Reader->Completions != 0)
+	{
+		ElapsedNs = TimeDifferenceNs(&Reader->StartTime, &Reader->LastCompleteTime);
+		if (ElapsedNs != 0)
+			Efficiency = 100.0F * (1.0F - (float)Reader->WaitTimeNs / (float)ElapsedNs);
+	}
+	if (ReadyPercent != NULL)
+		*ReadyPercent = (Reader->Completions != 0) ? 100.0F * (float)Reader->ReadyCompletions / (float)Reader->Completions : 0.0F;
+	return Efficiency;
+}
+
+
 //
 // 32 bit register read over the AXILite bus
+// uses the mapped BAR if available; else a read call to the driver
 //
 uint32_t RegisterRead(uint32_t Address)
 {
 	uint32_t result = 0;
 
+    if ((RegisterBase != NULL) && (Address < VREGISTERMAPSIZE))
+        return RegisterBase[Address >> 2];
+
     ssize_t nread = pread(register_fd, &result, sizeof(result), (off_t) Address);
     if (nread != sizeof(result))
         printf("ERROR: register read: addr=0x%08X   error=%s\n",Address, strerror(errno));
@@ -141,13 +694,57 @@ uint32_t RegisterRead(uint32_t Address)
 
 //
 // 32 bit register write over the AXILite bus
+// uses the mapped BAR if available; else a write call to the driver
 //
 void RegisterWrite(uint32_t Address, uint32_t Data)
 {
+    if ((RegisterBase != NULL) && (Address < VREGISTERMAPSIZE))
+    {
+        RegisterBase[Address >> 2] = Data;
+        return;
+    }
     ssize_t nsent = pwrite(register_fd, &Data, sizeof(Data), (off_t) Address); 
     if (nsent != sizeof(Data))
         printf("ERROR: Write: addr=0x%08X   error=%s\n",Address, strerror(errno));
 }
 
 
+_Static_assert(sizeof(struct RegisterOp) == 12, "must match struct xdma_reg_op in the driver");
+
 
+//
+// a list of register reads and writes, carried out in order in one driver call
+// if the BAR is mapped there is no driver call: just access it directly.
+// if the driver doesn't support the batch ioctl, each is done by a separate call.
+// returns 0 if successful
+//
+int RegisterBatch(struct RegisterOp* Ops, uint32_t Count)
+{
+    struct XDMARegBatch Batch;
+    uint32_t Op;
+
+    if (Count > VMAXREGISTERBATCH)
+        return -EINVAL;
+    if ((RegisterBase == NULL) && RegisterBatchIoctl)
+    {
+        Batch.Count = Count;
+        Batch.Pad = 0;
+        Batch.Ops = (uint64_t)(uintptr_t)Ops;
+        if (ioctl(register_fd, VXDMAIOCREGBATCH, &Batch) == 0)
+            return 0;
+        if (errno != ENOTTY)
+        {
+            printf("ERROR: register batch: error=%s\n", strerror(errno));
+            return -errno;
+        }
+        RegisterBatchIoctl = false;                 // old driver: don't try again
+    }
+    for (Op = 0; Op < Count; Op++)
+    {
+        if (Ops[Op].Write)
+            RegisterWrite(Ops[Op].Address, Ops[Op].Value);
+        else
+            Ops[Op].Value = RegisterRead(Ops[Op].Address);
+    }
+    return 0;
+}
@@ -17,6 +17,82 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
+#include <linux/aio_abi.h>
+#include "../common/ringbuffer.h"
+
+
+#define VMAXASYNCDMABUFFERS 4                   // max buffers for an overlapped DMA reader
+#define VMAXREGISTERBATCH 32                    // max operations in one register batch
+#define VMAXPINNEDDMABUFFERS 8                  // max DMA buffers registered with the driver
+
+//
+// one operation in a register batch
+// layout must match struct xdma_reg_op in the XDMA driver (cdev_ctrl.h)
+//
+struct RegisterOp
+{
+    uint32_t Address;                           // register address
+    uint32_t Value;                             // value to write, or value read
+    uint32_t Write;                             // non zero for a write
+};
+
+//
+// overlapped (asynchronous) DMA reader
+// a reader rotates through NumBuffers buffers of Length bytes, each filled by its own DMA,
+// so that one buffer can be processed while DMAs to the others are in flight.
+// uses linux AIO: the XDMA driver queues the transfer and completes it later.
+//
+struct AsyncDMAReader
+{
+    int fd;                                     // DMA file device
+    uint32_t AXIAddr;                           // offset address in the FPGA window
+    uint32_t NumBuffers;
+    uint32_t Length;                            // bytes per DMA, unless set by AsyncDMAReadSubmitTo()
+    unsigned char* Buffers[VMAXASYNCDMABUFFERS];
+    aio_context_t Context;
+    struct iocb Control[VMAXASYNCDMABUFFERS];   // one AIO control block per buffer
+    uint32_t InFlight;                          // DMAs submitted and not yet completed
+    //
+    // overlap statistics
+    //
+    uint64_t Completions;                       // DMAs completed
+    uint64_t ReadyCompletions;                  // DMAs already complete when waited for
+    uint64_t WaitTimeNs;                        // total time blocked waiting for DMA completion
+    struct timespec StartTime;                  // time of 1st DMA submit
+    struct timespec LastCompleteTime;           // time of latest completion
+};
+
+
+//
+// streaming ring control page, shared with the driver
+// layout must match struct xdma_stream_ctrl in the XDMA driver (cdev_sgdma.h)
+//
+struct DMAStreamControl
+{
+    uint32_t Head;                              // blocks filled by the driver since the start
+    uint32_t Tail;                              // blocks consumed by us since the start
+    uint32_t BlockSize;
+    uint32_t BlockCount;
+    uint32_t DataOffset;                        // mmap offset of the data blocks
+    uint32_t Overruns;                          // driver count of unread blocks overwritten
+    uint32_t Error;                             // engine status if the DMA engine stopped
+};
+
+//
+// kernel streaming DMA ring
+// the driver keeps a DMA engine filling a ring of blocks, allocated by the driver;
+// the blocks are mapped here as a mirrored ring buffer and read in place, with no read call.
+//
+struct DMAStreamRing
+{
+    int fd;                                     // DMA file device
+    volatile struct DMAStreamControl* Control;  // mapped control page
+    struct RingBuffer Ring;                     // mirrored view of the data blocks
+    uint32_t BlockSize;                         // bytes per block
+    uint32_t BlockCount;                        // blocks in the ring
+    uint32_t Head;                              // blocks added to Ring so far
+};
 
 
 //
@@ -53,6 +129,121 @@ int DMAWriteToFPGA(int fd, unsigned char*SrcData, uint32_t Length, uint32_t AXIA
 int DMAReadFromFPGA(int fd, unsigned char*DestData, uint32_t Length, uint32_t AXIAddr);
 
 
+//
+// register a DMA buffer with the driver: it is pinned in memory and mapped for DMA once.
+// a later DMAReadFromFPGA() or DMAWriteToFPGA() on fd with its data inside the buffer then
+// skips the driver's per transfer page pinning and scatter list setup.
+// returns 0 if success, else an error code; if it fails, DMA to the buffer still works as before.
+// fd: file device (an open file)
+// Buffer, Length: memory block to register
+//
+int DMARegisterBuffer(int fd, unsigned char* Buffer, uint32_t Length);
+
+
+//
+// unregister a DMA buffer. Must be called before the buffer is freed;
+// closing fd also unregisters all buffers registered on it.
+//
+void DMAUnregisterBuffer(int fd, unsigned char* Buffer);
+
+
+//
+// open an overlapped DMA reader
+// returns 0 if success, else an error code
+// fd: file device (an open file)
+// AXIAddr: offset address in the FPGA window
+// NumBuffers: number of rotating buffers (2 for double buffering, 3 for triple...)
+// Length: bytes per DMA
+// Buffers: NumBuffers pointers to memory blocks of Length bytes
+//
+int AsyncDMAReadOpen(struct AsyncDMAReader* Reader, int fd, uint32_t AXIAddr, uint32_t NumBuffers,
+                     uint32_t Length, unsigned char** Buffers);
+
+
+//
+// submit a DMA into one buffer. DMAs complete in the order they are submitted.
+// returns 0 if success, else an error code
+//
+int AsyncDMAReadSubmit(struct AsyncDMAReader* Reader, uint32_t Buffer);
+
+
+//
+// submit a DMA of Length bytes to Address, using one buffer's control block
+// (instead of the buffer and length set at open). returns 0 if success, else an error code
+//
+int AsyncDMAReadSubmitTo(struct AsyncDMAReader* Reader, uint32_t Buffer, unsigned char* Address, uint32_t Length);
+
+
+//
+// wait for the oldest submitted DMA to complete
+// returns the index of the buffer filled, or a negative error code
+//
+int AsyncDMAReadWait(struct AsyncDMAReader* Reader);
+
+
+//
+// wait for any DMAs still in flight, then release the reader
+//
+void AsyncDMAReadClose(struct AsyncDMAReader* Reader);
+
+
+//
+// overlap efficiency: the percentage of time since the 1st DMA was submitted that the caller
+// was NOT blocked waiting for a DMA to complete. 100% means DMA was fully hidden behind processing.
+// ReadyPercent (optional) is set to the percentage of DMAs already complete when waited for.
+//
+float AsyncDMAOverlapEfficiency(struct AsyncDMAReader* Reader, float* ReadyPercent);
+
+
+//
+// start a kernel streaming ring. The driver reads blocks from AXIAddr continuously from now on.
+// BlockSize * BlockCount must be a multiple of the page size.
+// returns 0 if success, else an error code (eg if the driver has no streaming ring support)
+//
+int DMAStreamOpen(struct DMAStreamRing* Stream, int fd, uint32_t AXIAddr, uint32_t BlockSize, uint32_t BlockCount);
+
+
+//
+// wait up to TimeoutMs for filled blocks, and add them to Stream->Ring
+// returns the number of bytes added (0 if timed out), or a negative error code.
+// -EOVERFLOW means unread data was overwritten: Stream->Ring has been emptied
+// and restarted at the newest block, so the caller must resynchronise.
+//
+int DMAStreamWait(struct DMAStreamRing* Stream, uint32_t TimeoutMs);
+
+
+//
+// tell the driver how far Stream->Ring has been consumed
+// call after RingBufferConsume(&Stream->Ring, ...)
+//
+void DMAStreamRelease(struct DMAStreamRing* Stream);
+
+
+//
+// stop the streaming ring and unmap it
+//
+void DMAStreamClose(struct DMAStreamRing* Stream);
+
+
+//
+// start the driver write-behind ring on an H2C DMA device
+// DMAWriteToFPGA() on fd then copies the data into a driver ring and returns at once;
+// the driver writes it to AXIAddr (the address given to DMAWriteToFPGA() is ignored),
+// combining queued writes into DMAs of up to MaxTransfer bytes.
+// a write only waits if the ring is full. Don't register a buffer on fd with DMARegisterBuffer().
+// RingLength must be a power of 2, at least 4096.
+// returns 0 if success, else an error code (eg if the driver has no write-behind support)
+//
+int DMAWriteBehindStart(int fd, uint32_t AXIAddr, uint32_t RingLength, uint32_t MaxTransfer);
+
+
+//
+// send any queued data, and stop the write-behind ring
+// returns 0, or the error from a failed DMA
+//
+int DMAWriteBehindStop(int fd);
+
+
 //
 // single 32 bit register read, from AXI-Lite bus
 //
@@ -65,4 +256,12 @@ uint32_t RegisterRead(uint32_t Address);
 void RegisterWrite(uint32_t Address, uint32_t Data);
 
 
+//
+// a list of register reads and writes, carried out in order in one driver call
+// read values are returned in Ops[].Value. Count must be no more than VMAXREGISTERBATCH.
+// returns 0 if successful
+//
+int RegisterBatch(struct RegisterOp* Ops, uint32_t Count);
+
+
 #endif
@@ -0,0 +1,235 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// regshadow.c:
+// shadow copies of the writable FPGA control registers
+//
+// setters update the shadow with an atomic compare and swap, so two threads
+// changing different bits of one register (eg the RF GPIO register) cannot
+// lose each other's update, and no semaphore is needed around the read-modify-write.
+// an updated register is marked dirty; ShadowFlush() writes the dirty registers
+// in one batched driver call, skipping any whose value matches what was last written.
+// so a register is always written the first time it is set, and never re-written unchanged.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/regshadow.h"
+#include "../common/saturnregisters.h"
+#include "../common/hwaccess.h"                   // low level access
+#include <pthread.h>
+
+
+//
+// AXI address of each shadowed register, in EShadowRegister order
+//
+static const uint32_t ShadowAddresses[VNUMSHADOWREGS] =
+{
+    VADDRRFGPIOREG,
+    VADDRTXCONFIGREG,
+    VADDRKEYERCONFIGREG,
+    VADDRIAMBICCONFIG,
+    VADDRCODECCONFIGREG,
+    VADDRDDCINSEL,
+    VADDRDDCRATES,
+    VADDRDACCTRLREG,
+    VADDRADCCTRLREG,
+    VADDRTXDUCREG,
+    VADDRRXTESTDDSREG,
+    VADDRTXMODTESTREG,
+    VADDRALEXSPIREG+VOFFSETALEXTXFILTREG,
+    VADDRALEXSPIREG+VOFFSETALEXRXREG,
+    VADDRALEXSPIREG+VOFFSETALEXTXANTREG,
+    VADDRWIDEBANDDEPTHREG,
+    VADDRWIDEBANDPERIODREG,
+    VADDRDDC0REG,
+    VADDRDDC1REG,
+    VADDRDDC2REG,
+    VADDRDDC3REG,
+    VADDRDDC4REG,
+    VADDRDDC5REG,
+    VADDRDDC6REG,
+    VADDRDDC7REG,
+    VADDRDDC8REG,
+    VADDRDDC9REG
+};
+
+
+_Static_assert(VNUMSHADOWREGS <= VMAXREGISTERBATCH, "shadow flush must fit one register batch");
+
+static uint32_t ShadowValues[VNUMSHADOWREGS];       // current settings; updated by setters
+static uint32_t ShadowHWValues[VNUMSHADOWREGS];     // value last written to each register
+static uint32_t ShadowDirty;                        // 1 bit per register: changed since last flush
+static uint32_t ShadowForced;                       // 1 bit per register: write even if unchanged
+static uint32_t ShadowHWValid;                      // 1 bit per register: ShadowHWValues[] valid (flush only)
+static pthread_mutex_t ShadowFlushMutex = PTHREAD_MUTEX_INITIALIZER;   // serialises flushes
+static __thread unsigned int ShadowUpdateDepth;     // this thread's ShadowBeginUpdate() nesting
+
+
+//
+// mask for a field of Width bits
+//
+static inline uint32_t FieldMask(uint8_t Width)
+{
+    return (Width >= 32) ? 0xFFFFFFFF : ((1u << Width) - 1);
+}
+
+
+//
+// uint32_t ShadowRead(EShadowRegister Reg)
+//
+uint32_t ShadowRead(EShadowRegister Reg)
+{
+    return __atomic_load_n(&ShadowValues[Reg], __ATOMIC_ACQUIRE);
+}
+
+
+//
+// void ShadowWrite(EShadowRegister Reg, uint32_t Value)
+//
+void ShadowWrite(EShadowRegister Reg, uint32_t Value)
+{
+    __atomic_store_n(&ShadowValues[Reg], Value, __ATOMIC_RELEASE);
+    __atomic_fetch_or(&ShadowDirty, (1u << Reg), __ATOMIC_RELEASE);
+}
+
+
+//
+// void ShadowStore(EShadowRegister Reg, uint32_t Value)
+//
+void ShadowStore(EShadowRegister Reg, uint32_t Value)
+{
+    __atomic_store_n(&ShadowValues[Reg], Value, __ATOMIC_RELEASE);
+}
+
+
+//
+// uint32_t ShadowUpdateBits(EShadowRegister Reg, uint32_t Mask, uint32_t Bits, bool MarkDirty)
+// compare and swap loop: retried if another thread changed the register meanwhile
+//
+uint32_t ShadowUpdateBits(EShadowRegister Reg, uint32_t Mask, uint32_t Bits, bool MarkDirty)
+{
+    uint32_t Old, New;
+
+    Old = __atomic_load_n(&ShadowValues[Reg], __ATOMIC_ACQUIRE);
+    do
+    {
+        New = (Old & ~Mask) | (Bits & Mask);
+        if (New == Old)
+            break;                                      // nothing to change in the shadow
+    } while (!__atomic_compare_exchange_n(&ShadowValues[Reg], &Old, New, false,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    if (MarkDirty)
+        __atomic_fetch_or(&ShadowDirty, (1u << Reg), __ATOMIC_RELEASE);
+    return New;
+}
+
+
+//
+// void ShadowSetField(const struct RegField* Field, uint32_t Value)
+//
+void ShadowSetField(const struct RegField* Field, uint32_t Value)
+{
+    uint32_t Mask;
+
+    Mask = FieldMask(Field->Width) << Field->Shift;
+    ShadowUpdateBits(Field->Register, Mask, Value << Field->Shift, true);
+}
+
+
+//
+// uint32_t ShadowGetField(const struct RegField* Field)
+//
+uint32_t ShadowGetField(const struct RegField* Field)
+{
+    return (ShadowRead(Field->Register) >> Field->Shift) & FieldMask(Field->Width);
+}
+
+
+//
+// void ShadowForceWrite(EShadowRegister Reg)
+//
+void ShadowForceWrite(EShadowRegister Reg)
+{
+    __atomic_fetch_or(&ShadowForced, (1u << Reg), __ATOMIC_RELEASE);
+    __atomic_fetch_or(&ShadowDirty, (1u << Reg), __ATOMIC_RELEASE);
+}
+
+
+//
+// unsigned int ShadowFlush(void)
+// the dirty mask is taken atomically before the values are read, so a setter
+// that changes a register during the flush leaves it dirty for the next one.
+// flushes are serialised so ShadowHWValues[] matches the order the hardware saw.
+//
+unsigned int ShadowFlush(void)
+{
+    struct RegisterOp Ops[VNUMSHADOWREGS];
+    uint32_t Dirty, Forced;
+    uint32_t Value;
+    uint32_t Bit;
+    unsigned int Reg;
+    unsigned int Count = 0;
+
+    if (__atomic_load_n(&ShadowDirty, __ATOMIC_ACQUIRE) == 0)
+        return 0;                                       // nothing to do: don't take the lock
+
+    pthread_mutex_lock(&ShadowFlushMutex);
+    Dirty = __atomic_exchange_n(&ShadowDirty, 0, __ATOMIC_ACQ_REL);
+    Forced = __atomic_exchange_n(&ShadowForced, 0, __ATOMIC_ACQ_REL);
+    for (Reg = 0; Reg < VNUMSHADOWREGS; Reg++)
+    {
+        Bit = 1u << Reg;
+        if (!(Dirty & Bit))
+            continue;
+        Value = __atomic_load_n(&ShadowValues[Reg], __ATOMIC_ACQUIRE);
+        if ((ShadowHWValid & Bit) && !(Forced & Bit) && (Value == ShadowHWValues[Reg]))
+            continue;                                   // hardware already holds this value
+        Ops[Count].Address = ShadowAddresses[Reg];
+        Ops[Count].Value = Value;
+        Ops[Count].Write = 1;
+        Count++;
+        ShadowHWValues[Reg] = Value;
+        ShadowHWValid |= Bit;
+    }
+    if (Count != 0)
+        RegisterBatch(Ops, Count);
+    pthread_mutex_unlock(&ShadowFlushMutex);
+    return Count;
+}
+
+
+//
+// void ShadowSync(void)
+//
+void ShadowSync(void)
+{
+    if (ShadowUpdateDepth == 0)
+        ShadowFlush();
+}
+
+
+//
+// void ShadowBeginUpdate(void)
+//
+void ShadowBeginUpdate(void)
+{
+    ShadowUpdateDepth++;
+}
+
+
+//
+// void ShadowEndUpdate(void)
+//
+void ShadowEndUpdate(void)
+{
+    if (ShadowUpdateDepth != 0)
+        ShadowUpdateDepth--;
+    if (ShadowUpdateDepth == 0)
+        ShadowFlush();
+}
@@ -0,0 +1,145 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// regshadow.h:
+// shadow copies of the writable FPGA control registers
+// setters change fields in the shadow copy; a flush writes only
+// those registers whose value has changed since they were last written
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __regshadow_h
+#define __regshadow_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+//
+// writable registers held in the shadow
+// the flush writes dirty registers in this order, so it matches the order
+// the setters used to write in (eg GPIO MOX bit before keyer enable)
+//
+typedef enum
+{
+    eShadowRFGPIO,                          // RF GPIO register
+    eShadowTXConfig,                        // TX config register
+    eShadowKeyerConfig,                     // CW keyer setup register
+    eShadowIambicConfig,                    // iambic keyer config register
+    eShadowCodecConfig,                     // codec (sidetone) config register
+    eShadowDDCInSel,                        // DDC input select register
+    eShadowDDCRates,                        // DDC sample rates register
+    eShadowDACCtrl,                         // TX DAC current & step atten
+    eShadowADCCtrl,                         // RX ADC attenuators
+    eShadowDUCFreq,                         // DUC delta phase
+    eShadowTestDDSFreq,                     // RX test source delta phase
+    eShadowTXModTestFreq,                   // TX modulation test DDS
+    eShadowAlexTXFilt,                      // Alex TX filter, RX ant word
+    eShadowAlexRX,                          // Alex RX word, RX1 and RX2
+    eShadowAlexTXAnt,                       // Alex TX filter, TX ant word (FPGA V12 on)
+    eShadowWidebandDepth,                   // wideband sample count
+    eShadowWidebandPeriod,                  // wideband update period
+    eShadowDDC0Freq,                        // DDC delta phase: one register per DDC
+    eShadowDDC1Freq,
+    eShadowDDC2Freq,
+    eShadowDDC3Freq,
+    eShadowDDC4Freq,
+    eShadowDDC5Freq,
+    eShadowDDC6Freq,
+    eShadowDDC7Freq,
+    eShadowDDC8Freq,
+    eShadowDDC9Freq,
+    VNUMSHADOWREGS                          // number of shadowed registers
+} EShadowRegister;
+
+
+//
+// field descriptor: a group of bits within one shadowed register
+//
+struct RegField
+{
+    EShadowRegister Register;               // register holding the field
+    uint8_t Shift;                          // bit position of field LSB
+    uint8_t Width;                          // field width in bits (1-32)
+};
+
+
+//
+// uint32_t ShadowRead(EShadowRegister Reg)
+// returns the current shadow value of a register (not read from hardware)
+//
+uint32_t ShadowRead(EShadowRegister Reg);
+
+
+//
+// void ShadowWrite(EShadowRegister Reg, uint32_t Value)
+// set a whole register in the shadow, and mark it dirty
+//
+void ShadowWrite(EShadowRegister Reg, uint32_t Value);
+
+
+//
+// void ShadowStore(EShadowRegister Reg, uint32_t Value)
+// set a whole register in the shadow without marking it dirty.
+// the value reaches hardware with the next change to that register.
+//
+void ShadowStore(EShadowRegister Reg, uint32_t Value);
+
+
+//
+// uint32_t ShadowUpdateBits(EShadowRegister Reg, uint32_t Mask, uint32_t Bits, bool MarkDirty)
+// atomically replace the bits selected by Mask with Bits (compare and swap)
+// marked dirty if MarkDirty is set
+// returns the new register value
+//
+uint32_t ShadowUpdateBits(EShadowRegister Reg, uint32_t Mask, uint32_t Bits, bool MarkDirty);
+
+
+//
+// field access: set or get a field value, right justified
+//
+void ShadowSetField(const struct RegField* Field, uint32_t Value);
+uint32_t ShadowGetField(const struct RegField* Field);
+
+
+//
+// void ShadowForceWrite(EShadowRegister Reg)
+// mark a register dirty so the next flush writes it whether or not it has changed
+//
+void ShadowForceWrite(EShadowRegister Reg);
+
+
+//
+// unsigned int ShadowFlush(void)
+// write all dirty registers to hardware, using batched register writes
+// registers that are dirty but still hold the value last written are skipped,
+// unless forced by ShadowForceWrite()
+// returns the number of registers written
+//
+unsigned int ShadowFlush(void);
+
+
+//
+// void ShadowSync(void)
+// called by setters after updating the shadow: flushes now, unless the
+// calling thread is within a ShadowBeginUpdate() / ShadowEndUpdate() block
+//
+void ShadowSync(void);
+
+
+//
+// coalesce the register writes of a group of setters into one flush
+// ShadowEndUpdate() flushes when the outermost block ends
+// blocks nest, and are per thread
+//
+void ShadowBeginUpdate(void);
+void ShadowEndUpdate(void);
+
+
+#endif
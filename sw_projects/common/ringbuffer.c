@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ringbuffer.c:
+// mirrored ring buffer for DMA and sample data
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                                 // for memfd_create()
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../common/ringbuffer.h"
+
+
+//
+// create a ring buffer of (at least) Size bytes, initially empty
+// a memory file provides the pages; an address range of twice the size is reserved,
+// then the file is mapped into both halves of it.
+// returns true if successful
+//
+bool RingBufferCreate(struct RingBuffer* Ring, uint32_t Size)
+{
+    long PageSize;
+    int fd;
+    unsigned char* Addr;
+    bool Result = false;
+
+    memset(Ring, 0, sizeof(struct RingBuffer));
+    PageSize = sysconf(_SC_PAGESIZE);
+    Size = (Size + PageSize - 1) & ~(PageSize - 1);
+
+    fd = memfd_create("saturn_ring", 0);
+    if(fd < 0)
+    {
+        perror("ring buffer memfd_create");
+        return false;
+    }
+    if(ftruncate(fd, Size) != 0)
+        perror("ring buffer ftruncate");
+    else
+    {
+        Addr = mmap(NULL, 2 * Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(Addr == MAP_FAILED)
+            perror("ring buffer address reserve");
+        else if((mmap(Addr, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | MAP_POPULATE, fd, 0) == MAP_FAILED)
+             || (mmap(Addr + Size, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | MAP_POPULATE, fd, 0) == MAP_FAILED))
+        {
+            perror("ring buffer mmap");
+            munmap(Addr, 2 * Size);
+        }
+        else
+        {
+            Ring->Base = Addr;
+            Ring->Size = Size;
+            Result = true;
+        }
+    }
+    close(fd);                                      // the mappings keep the memory
+    return Result;
+}
+
+
+//
+// release the ring buffer memory
+//
+void RingBufferDestroy(struct RingBuffer* Ring)
+{
+    if(Ring->Base != NULL)
+        munmap(Ring->Base, 2 * Ring->Size);
+    memset(Ring, 0, sizeof(struct RingBuffer));
+}
+
+
+//
+// discard all data
+//
+void RingBufferReset(struct RingBuffer* Ring)
+{
+    Ring->ReadOffset = 0;
+    Ring->WriteOffset = 0;
+    Ring->Fill = 0;
+}
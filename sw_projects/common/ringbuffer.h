@@ -0,0 +1,108 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ringbuffer.h:
+// mirrored ring buffer for DMA and sample data
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __ringbuffer_h
+#define __ringbuffer_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+//
+// mirrored ring buffer
+// the same memory pages are mapped twice, back to back. Any block of up to Size bytes
+// starting inside the 1st mapping is contiguous in the process address space, even if
+// it crosses the end of the ring: the part after the end lands in the mirror, which is
+// the start of the ring. So a DMA can be written straight in at the write pointer, and
+// data read out from the read pointer, without ever copying residue back to the start.
+// Size is rounded up to a whole number of pages; the write pointer stays page aligned
+// provided every commit is a whole number of pages.
+//
+// not thread safe: intended to be written and read from the same thread.
+//
+struct RingBuffer
+{
+    unsigned char* Base;                        // start of 1st mapping; mirror is at Base+Size
+    uint32_t Size;                              // ring size in bytes
+    uint32_t ReadOffset;                        // offset of 1st unread byte
+    uint32_t WriteOffset;                       // offset of 1st free byte
+    uint32_t Fill;                              // bytes written and not yet read
+};
+
+
+//
+// create a ring buffer of (at least) Size bytes, initially empty
+// returns true if successful
+//
+bool RingBufferCreate(struct RingBuffer* Ring, uint32_t Size);
+
+
+//
+// release the ring buffer memory
+//
+void RingBufferDestroy(struct RingBuffer* Ring);
+
+
+//
+// discard all data
+//
+void RingBufferReset(struct RingBuffer* Ring);
+
+
+//
+// pointers to the 1st unread byte and 1st free byte
+// Fill bytes are readable contiguously from the read pointer,
+// and Size-Fill bytes writable contiguously from the write pointer
+//
+static inline unsigned char* RingBufferReadPtr(struct RingBuffer* Ring)
+{
+    return Ring->Base + Ring->ReadOffset;
+}
+
+static inline unsigned char* RingBufferWritePtr(struct RingBuffer* Ring)
+{
+    return Ring->Base + Ring->WriteOffset;
+}
+
+static inline uint32_t RingBufferSpace(struct RingBuffer* Ring)
+{
+    return Ring->Size - Ring->Fill;
+}
+
+
+//
+// add Bytes written at the write pointer to the ring
+//
+static inline void RingBufferCommit(struct RingBuffer* Ring, uint32_t Bytes)
+{
+    Ring->WriteOffset += Bytes;
+    if(Ring->WriteOffset >= Ring->Size)
+        Ring->WriteOffset -= Ring->Size;
+    Ring->Fill += Bytes;
+}
+
+
+//
+// remove Bytes read from the read pointer
+//
+static inline void RingBufferConsume(struct RingBuffer* Ring, uint32_t Bytes)
+{
+    Ring->ReadOffset += Bytes;
+    if(Ring->ReadOffset >= Ring->Size)
+        Ring->ReadOffset -= Ring->Size;
+    Ring->Fill -= Bytes;
+}
+
+
+#endif
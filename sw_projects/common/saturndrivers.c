@@ -19,10 +19,14 @@
 #include "../common/saturnregisters.h"
 #include "../common/hwaccess.h"                   // low level access
 #include <semaphore.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 
 sem_t DDCResetFIFOMutex;
 
 bool GFIFOSizesInitialised = false;
+uint32_t GFIFOMonitorConfig[VNUMDMAFIFO];				// last value written to each config register
 
 
 
@@ -36,45 +40,52 @@ bool GFIFOSizesInitialised = false;
 //
 void SetupFIFOMonitorChannel(EDMAStreamSelect Channel, bool EnableInterrupt)
 {
-	uint32_t Address;							// register address
-	uint32_t Data;								// register content
-
 	if (!GFIFOSizesInitialised)
 	{
 			InitialiseFIFOSizes();				// load FIFO size table, if not already done
 			GFIFOSizesInitialised = true;
 	}
+	GFIFOMonitorConfig[(int)Channel] = 0xFFFFFFFF;				// force a write
+	SetFIFOMonitorThreshold(Channel, DMAFIFODepths[(int)Channel], EnableInterrupt);
+}
+
+
+
+//
+// void SetFIFOMonitorThreshold(EDMAStreamSelect Channel, uint32_t Threshold, bool EnableInterrupt);
+//
+// set the FIFO depth at which a channel reports "over threshold".
+// the register is only written if the setting has changed.
+//
+void SetFIFOMonitorThreshold(EDMAStreamSelect Channel, uint32_t Threshold, bool EnableInterrupt)
+{
+	uint32_t Address;							// register address
+	uint32_t Data;								// register content
+
 	Address = VADDRFIFOMONBASE + 4 * Channel + 0x10;			// config register address
-	Data = DMAFIFODepths[(int)Channel];							// memory depth
+	if (Threshold > DMAFIFODepths[(int)Channel])
+		Threshold = DMAFIFODepths[(int)Channel];
+	Data = Threshold & 0xFFFF;									// threshold depth
 	if (EnableInterrupt)
 		Data += 0x80000000;						// bit 31
-	RegisterWrite(Address, Data);
+	if (Data != GFIFOMonitorConfig[(int)Channel])
+	{
+		RegisterWrite(Address, Data);
+		GFIFOMonitorConfig[(int)Channel] = Data;
+	}
 }
 
 
 
 //
-// uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool* OverThreshold, bool* Underflowed,  unsigned int* Current);
+// decode a FIFO monitor status register value: see ReadFIFOMonitorChannel() below
 //
-// Read number of locations in a FIFO
-// for a read FIFO: returns the number of occupied locations available to read
-// for a write FIFO: returns the number of free locations available to write
-//   Channel:			IP core channel number (enum)
-//   Overflowed:		true if an overflow has occurred. Reading clears the overflow bit.
-//   OverThreshold:		true if overflow occurred  measures by threshold. Cleared by read.
-//   Underflowed:       true if underflow has occurred. Cleared by read.
-//   Current:           number of locations occupied (in either FIFO type)
-//
-uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool* OverThreshold, bool* Underflowed,  unsigned int* Current)
+static uint32_t DecodeFIFOMonitorStatus(EDMAStreamSelect Channel, uint32_t Data, bool* Overflowed, bool* OverThreshold, bool* Underflowed,  unsigned int* Current)
 {
-	uint32_t Address;							// register address
-	uint32_t Data = 0;							// register content
 	bool Overflow = false;
 	bool OverThresh = false;
 	bool Underflow = false;
 
-	Address = VADDRFIFOMONBASE + 4 * (uint32_t)Channel;			// status register address
-	Data = RegisterRead(Address);
 	if (Data & 0x80000000)										// if top bit set, declare overflow
 		Overflow = true;
 	if (Data & 0x40000000)										// if bit 30 set, declare over threshold
@@ -93,6 +104,95 @@ uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool
 
 
 
+//
+// uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool* OverThreshold, bool* Underflowed,  unsigned int* Current);
+//
+// Read number of locations in a FIFO
+// for a read FIFO: returns the number of occupied locations available to read
+// for a write FIFO: returns the number of free locations available to write
+//   Channel:			IP core channel number (enum)
+//   Overflowed:		true if an overflow has occurred. Reading clears the overflow bit.
+//   OverThreshold:		true if overflow occurred  measures by threshold. Cleared by read.
+//   Underflowed:       true if underflow has occurred. Cleared by read.
+//   Current:           number of locations occupied (in either FIFO type)
+//
+uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool* OverThreshold, bool* Underflowed,  unsigned int* Current)
+{
+	uint32_t Address;							// register address
+
+	Address = VADDRFIFOMONBASE + 4 * (uint32_t)Channel;			// status register address
+	return DecodeFIFOMonitorStatus(Channel, RegisterRead(Address), Overflowed, OverThreshold, Underflowed, Current);
+}
+
+
+
+//
+// void ReadFIFOMonitorChannels(uint32_t Count, EDMAStreamSelect* Channels, bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current, uint32_t* Result)
+//
+// as ReadFIFOMonitorChannel() for several channels, with all the status registers read in one driver call.
+// each parameter is an array with one entry per channel; Result[] gets each channel's return value
+//
+void ReadFIFOMonitorChannels(uint32_t Count, EDMAStreamSelect* Channels, bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current, uint32_t* Result)
+{
+	struct RegisterOp Ops[VNUMDMAFIFO];
+	uint32_t Cntr;
+
+	if (Count > VNUMDMAFIFO)
+		Count = VNUMDMAFIFO;
+	for (Cntr = 0; Cntr < Count; Cntr++)
+	{
+		Ops[Cntr].Address = VADDRFIFOMONBASE + 4 * (uint32_t)Channels[Cntr];
+		Ops[Cntr].Write = 0;
+	}
+	RegisterBatch(Ops, Count);
+	for (Cntr = 0; Cntr < Count; Cntr++)
+		Result[Cntr] = DecodeFIFOMonitorStatus(Channels[Cntr], Ops[Cntr].Value, &Overflowed[Cntr], &OverThreshold[Cntr], &Underflowed[Cntr], &Current[Cntr]);
+}
+
+
+
+
+
+//
+// int OpenFIFOMonitorEvents(void)
+// open the XDMA event device for the FIFO monitor interrupt
+// returns the file device, or -1 if not available (then FIFO depth must be polled)
+// the driver enables the user interrupt while the device is open.
+//
+int OpenFIFOMonitorEvents(void)
+{
+	return open(VFIFOEVENTDEVICE, O_RDONLY);
+}
+
+
+
+//
+// int WaitFIFOMonitorEvent(int EventFd, uint32_t TimeoutMs)
+// block until the FIFO monitor raises an interrupt, or timeout
+// returns 1 if an interrupt event arrived, 0 if timed out, -1 if error
+// the event is consumed by reading it; the interrupt source itself is
+// cleared by the next ReadFIFOMonitorChannel()
+//
+int WaitFIFOMonitorEvent(int EventFd, uint32_t TimeoutMs)
+{
+	struct pollfd PollFd;
+	uint32_t Events;
+	int Result;
+
+	PollFd.fd = EventFd;
+	PollFd.events = POLLIN;
+	PollFd.revents = 0;
+	Result = poll(&PollFd, 1, (int)TimeoutMs);
+	if (Result > 0)
+	{
+		if (read(EventFd, &Events, sizeof(Events)) != sizeof(Events))
+			Result = -1;
+		else
+			Result = 1;
+	}
+	return Result;
+}
+
 
 
 //
@@ -33,6 +33,16 @@ void SetupFIFOMonitorChannel(EDMAStreamSelect Channel, bool EnableInterrupt);
 
 
 
+//
+// void SetFIFOMonitorThreshold(EDMAStreamSelect Channel, uint32_t Threshold, bool EnableInterrupt);
+//
+// set the depth (64 bit words) at which a channel reports "over threshold".
+// the FPGA interrupt is raised by over threshold, overflow or underflow.
+//
+void SetFIFOMonitorThreshold(EDMAStreamSelect Channel, uint32_t Threshold, bool EnableInterrupt);
+
+
+
 //
 // uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool* OverThreshold, bool* Underflowed,  unsigned int* Current);
 //
@@ -48,6 +58,31 @@ void SetupFIFOMonitorChannel(EDMAStreamSelect Channel, bool EnableInterrupt);
 uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current);
 
 
+//
+// void ReadFIFOMonitorChannels(uint32_t Count, EDMAStreamSelect* Channels, bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current, uint32_t* Result)
+//
+// as ReadFIFOMonitorChannel() for several channels, with all the status registers read in one driver call.
+// each parameter is an array with one entry per channel; Result[] gets each channel's return value
+//
+void ReadFIFOMonitorChannels(uint32_t Count, EDMAStreamSelect* Channels, bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current, uint32_t* Result);
+
+
+//
+// int OpenFIFOMonitorEvents(void)
+// open the XDMA event device for the FIFO monitor interrupt
+// returns the file device, or -1 if not available (then FIFO depth must be polled)
+//
+int OpenFIFOMonitorEvents(void);
+
+
+//
+// int WaitFIFOMonitorEvent(int EventFd, uint32_t TimeoutMs)
+// block until the FIFO monitor raises an interrupt, or timeout
+// returns 1 if an interrupt event arrived, 0 if timed out, -1 if error
+//
+int WaitFIFOMonitorEvent(int EventFd, uint32_t TimeoutMs);
+
+
 //
 // reset a stream FIFO
 // clears the FIFOs directly read ori written by the FPGA
@@ -17,26 +17,14 @@
 #include "../common/saturnregisters.h"
 #include "../common/hwaccess.h"                   // low level access
 #include "../common/codecwrite.h"
+#include "../common/regshadow.h"
+#include "../common/capabilities.h"
 #include <stdlib.h>                     // for function min()
 #include <math.h>
 #include <unistd.h>
-#include <semaphore.h>
 #include "version.h"
 #include <stdio.h>
 
-typedef enum
-{
-    e23b,                               // TLV320AIC23B (now obsolete)
-    e3204                               // TLV320AIC3204 (suitable replacement)
-} ECodecType;
-
-//
-// semaphores to protect registers that are accessed from several threads
-//
-sem_t DDCInSelMutex;
-sem_t RFGPIOMutex;
-
-
 //
 // ROMs for DAC Current Setting and 0.5dB step digital attenuator
 //
@@ -45,19 +33,13 @@ unsigned int DACStepAttenROM[256];                  // provides most atten setti
 
 
 //
-// local copies of values written to registers
+// local copies of settings. Values written to the FPGA control registers
+// are held in the register shadow (regshadow.c)
 //
 #define VMAXP1DDCS 7                                // max number of DDCs used for P1
 #define VSAMPLERATE 122880000                       // sample rate in Hz
 
-uint32_t DDCDeltaPhase[VNUMDDC];                    // DDC frequency settings
-uint32_t DUCDeltaPhase;                             // DUC frequency setting
-uint32_t TestSourceDeltaPhase;                      // test source DDS delta phase
 uint32_t GStatusRegister;                           // most recent status register setting
-uint32_t GPIORegValue;                              // value stored into GPIO
-uint32_t TXConfigRegValue;                          // value written into TX config register
-uint32_t DDCInSelReg;                               // value written into DDC config register
-uint32_t DDCRateReg;                                // value written into DDC rate register
 bool GADCOverride;                                  // true if ADCs are to be overridden & use test source instead
 bool GByteSwapEnabled;                              // true if byte swapping enabled for sample readout 
 bool GPTTEnabled;                                   // true if PTT is enabled
@@ -72,12 +54,7 @@ bool GEnableApolloFilter;                           // Apollo filter bit - NOT U
 bool GEnableApolloATU;                              // Apollo ATU bit - NOT USED
 bool GStartApolloAutoTune;                          // Start Apollo tune bit - NOT USED
 bool GPPSEnabled;                                   // NOT CURRENTLY USED - trie if PPS generation enabled
-uint32_t GTXDACCtrl;                                // TX DAC current setting & atten
-uint32_t GRXADCCtrl;                                // RX1 & 2 attenuations
 bool GAlexRXOut;                                    // P1 RX output bit (NOT USED)
-uint32_t GAlexTXFiltRegister;                       // 16 bit used of 32 
-uint32_t GAlexTXAntRegister;                        // 16 bit used of 32 
-uint32_t GAlexRXRegister;                           // 32 bit RX register 
 bool GRX2GroundDuringTX;                            // true if RX2 grounded while in TX
 uint32_t GAlexCoarseAttenuatorBits;                 // Alex coarse atten NOT USED  
 bool GAlexManualFilterSelect;                       // true if manual (remote CPU) filter setting
@@ -88,18 +65,12 @@ unsigned int GCWKeyerMode;                          // Keyer Mode. True if mode
 unsigned int GCWKeyerWeight;                        // Keyer Weight. Not yet used
 bool GCWKeyerSpacing;                               // Keyer spacing
 bool GCWIambicKeyerEnabled;                         // true if iambic keyer is enabled
-uint32_t GIambicConfigReg;                          // copy of iambic comfig register
-uint32_t GCWKeyerSetup;                             // keyer control register
 uint32_t GClassEPWMMin;                             // min class E PWM. NOT USED at present.
 uint32_t GClassEPWMMax;                             // max class E PWM. NOT USED at present.
-uint32_t GCodecConfigReg;                           // codec configuration
 bool GSidetoneEnabled;                              // true if sidetone is enabled
 unsigned int GSidetoneVolume;                       // assigned sidetone volume (8 bit signed)
 bool GWidebandADC1;                                 // true if wideband on ADC1. For P2 - not used yet.
 bool GWidebandADC2;                                 // true if wideband on ADC2. For P2 - not used yet.
-uint32_t GWidebandSampleCount;                      // sample count (in 64 bit words) for wideband collection
-uint32_t GWidebandUpdateRate;                       // update rate in clock ticks
-uint32_t GWidebandControl;                          // Wideband control register
 unsigned int GAlexEnabledBits;                      // P2. True if Alex1-8 enabled. NOT USED YET.
 bool GPAEnabled;                                    // P2. True if PA enabled. NOT USED YET.
 unsigned int GTXDACCount;                           // P2. #TX DACs. NOT USED YET.
@@ -122,8 +93,7 @@ bool GTXDUCMuxActive;                               // true if I/Q mux is enable
 bool GEEREnabled;                                   // P2. true if EER is enabled
 ETXModulationSource GTXModulationSource;            // values added to register
 bool GTXProtocolP2;                                 // true if P2
-uint32_t TXModulationTestReg;                       // modulation test DDS
-bool GEnableTimeStamping;                           // true if timestamps to be added to data. NOT IMPLEMENTED YET
+bool GEnableTimeStamping;                           // true if timestamps to be referenced to system clock
 bool GEnableVITA49;                                 // true if to enable VITA49 formatting. NOT SUPPORTED YET
 unsigned int GCWKeyerRampms = 0;                    // ramp length for keyer, in ms
 bool GCWKeyerRamp_IsP2 = false;                     // true if ramp initialised for protocol 2
@@ -141,11 +111,6 @@ unsigned int GCodecLineGain;                        // value written in Codec le
 unsigned int GCodecAnaloguePath;                    // value written in Codec analogue path register
 unsigned int GCodec2PGA;                            // PGA gain for mic or line
 
-//
-// Saturn PCB Version, needed for codec ID
-// (PCB version 3 onwards will have a TLV320AIC3204)
-uint16_t SaturnPCBVersion;
-ECodecType InstalledCodec;                          // Codec type on the Saturn board
 bool CodecLineInput;                                // true if line input is selected
 
 //
@@ -213,14 +178,6 @@ uint32_t DDCRegisters[VNUMDDC] =
 
 
 
-//
-// ALEX SPI registers
-//
-#define VOFFSETALEXTXFILTREG 0                          // offset addr in IP core: TX filt, RX ant
-#define VOFFSETALEXRXREG 4                              // offset addr in IP core
-#define VOFFSETALEXTXANTREG 8                           // offset addr in IP core: TX filt, TX ant
-
-
 //
 // bit addresses in status and GPIO registers
 //
@@ -302,6 +259,40 @@ uint32_t DDCRegisters[VNUMDDC] =
 #define VTXCONFIGHPFENABLE 27
 
 
+//
+// DDC input select register defines
+//
+#define VDDCINSELENABLEBIT 30                           // DDC enable bit
+
+
+//
+// field descriptors for the shadowed registers
+//
+static const struct RegField FieldByteSwap =        {eShadowRFGPIO, VDATAENDIAN, 1};
+static const struct RegField FieldMOX =             {eShadowRFGPIO, VMOXBIT, 1};
+static const struct RegField FieldTXEnable =        {eShadowRFGPIO, VTXENABLEBIT, 1};
+static const struct RegField FieldATUTune =         {eShadowRFGPIO, VATUTUNEBIT, 1};
+static const struct RegField FieldOpenCollector =   {eShadowRFGPIO, VOPENCOLLECTORBITS, 7};
+static const struct RegField FieldBalancedMic =     {eShadowRFGPIO, VBALANCEDMICSELECT, 1};
+static const struct RegField FieldSpkrMute =        {eShadowRFGPIO, VSPKRMUTEBIT, 1};
+static const struct RegField FieldTXRelayDisable =  {eShadowRFGPIO, VTXRELAYDISABLEBIT, 1};
+static const struct RegField FieldKeyerEnable =     {eShadowKeyerConfig, VCWKEYERENABLE, 1};
+static const struct RegField FieldKeyerDelay =      {eShadowKeyerConfig, VCWKEYERDELAY, 8};
+static const struct RegField FieldKeyerHang =       {eShadowKeyerConfig, VCWKEYERHANG, 10};
+static const struct RegField FieldKeyerRamp =       {eShadowKeyerConfig, VCWKEYERRAMP, 13};
+static const struct RegField FieldSidetoneFreq =    {eShadowCodecConfig, 0, 16};
+static const struct RegField FieldSidetoneVolume =  {eShadowCodecConfig, 24, 8};
+static const struct RegField FieldTXModSource =     {eShadowTXConfig, VTXCONFIGDATASOURCEBIT, 2};
+static const struct RegField FieldTXSampleGate =    {eShadowTXConfig, VTXCONFIGSAMPLEGATINGBIT, 1};
+static const struct RegField FieldTXProtocol =      {eShadowTXConfig, VTXCONFIGPROTOCOLBIT, 1};
+static const struct RegField FieldTXScale =         {eShadowTXConfig, VTXCONFIGSCALEBIT, 18};
+static const struct RegField FieldTXHPFEnable =     {eShadowTXConfig, VTXCONFIGHPFENABLE, 1};
+static const struct RegField FieldTXWatchdog =      {eShadowTXConfig, VTXCONFIGWATCHDOGOVERRIDE, 1};
+static const struct RegField FieldTXIQDeinterleave = {eShadowTXConfig, VTXCONFIGIQDEINTERLEAVEBIT, 1};
+static const struct RegField FieldTXDUCMuxEnable =  {eShadowTXConfig, VTXCONFIGIQSTREAMENABLED, 1};
+static const struct RegField FieldDDCEnable =       {eShadowDDCInSel, VDDCINSELENABLEBIT, 1};
+
+
 
 //
 // InitialiseFIFOSizes(void)
@@ -309,25 +300,11 @@ uint32_t DDCRegisters[VNUMDDC] =
 //
 void InitialiseFIFOSizes(void)
 {
-	ESoftwareID ID;
-	unsigned int Version = 0;
-    Version = GetFirmwareVersion(&ID);
-    if((Version >= 10) && (Version <= 12))
-    {
-        printf("loading new FIFO sizes for updated firmware <= 12\n");
-        DMAFIFODepths[0] = 16384;       //  eRXDDCDMA,		selects RX
-        DMAFIFODepths[1] = 2048;        //  eTXDUCDMA,		selects TX
-        DMAFIFODepths[2] = 256;         //  eMicCodecDMA,	selects mic samples
-        DMAFIFODepths[3] = 1024;        //  eSpkCodecDMA	selects speaker samples
-    }
-    else if(Version >= 13)
-    {
-        printf("loading new FIFO sizes for updated firmware V13+\n");
-        DMAFIFODepths[0] = 16384;       //  eRXDDCDMA,		selects RX
-        DMAFIFODepths[1] = 4096;        //  eTXDUCDMA,		selects TX
-        DMAFIFODepths[2] = 256;         //  eMicCodecDMA,	selects mic samples
-        DMAFIFODepths[3] = 1024;        //  eSpkCodecDMA	selects speaker samples
-    }
+    const struct SaturnCapabilities* Caps = GetCapabilities();
+    unsigned int Cntr;
+
+    for(Cntr = 0; Cntr < VNUMDMAFIFO; Cntr++)
+        DMAFIFODepths[Cntr] = Caps->FIFODepths[Cntr];
 }
 
 
@@ -371,19 +348,9 @@ void InitialiseDACAttenROMs(void)
 //
 void SetByteSwapping(bool IsSwapped)
 {
-    uint32_t Register;
-
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    GByteSwapEnabled = IsSwapped;
-    if(IsSwapped)
-        Register |= (1<<VDATAENDIAN);               // set bit for swapped to network order
-    else
-        Register &= ~(1<<VDATAENDIAN);              // clear bit for raspberry pi local order
-
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protection
+    GByteSwapEnabled = IsSwapped;                   // bit set for swapped to network order
+    ShadowSetField(&FieldByteSwap, IsSwapped);      // clear for raspberry pi local order
+    ShadowSync();
 }
 
 
@@ -393,18 +360,8 @@ void SetByteSwapping(bool IsSwapped)
 //
 void ActivateCWKeyer(bool Keyer)
 {
-    uint32_t Register;
-    Register = GCWKeyerSetup;                           // get current settings
-    if(Keyer)
-        Register |= (1<<VCWKEYERENABLE);
-    else
-        Register &= ~(1<<VCWKEYERENABLE);
-    if(Register != GCWKeyerSetup)                       // write back if different
-    {
-        GCWKeyerSetup = Register;                       // store it back
-        RegisterWrite(VADDRKEYERCONFIGREG, Register);   // and write to it
-    }
-
+    ShadowSetField(&FieldKeyerEnable, Keyer);
+    ShadowSync();                                   // only written if changed
 }
 
 
@@ -417,26 +374,17 @@ void ActivateCWKeyer(bool Keyer)
 //
 void SetMOX(bool Mox)
 {
-    uint32_t Register;
-
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
     MOXAsserted = Mox;                              // set variable
-    if (Mox)
-        Register |= (1 << VMOXBIT);
-    else
-        Register &= ~(1 << VMOXBIT);
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
+    ShadowSetField(&FieldMOX, Mox);
 //
 // now set CW keyer if required
+// the GPIO register is flushed ahead of the keyer register
 //
     if (Mox)
         ActivateCWKeyer(GCWEnabled);
     else            // disable keyer unless CW & breakin
         ActivateCWKeyer(GCWEnabled && GBreakinEnabled);
-
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowSync();
 }
 
 
@@ -447,17 +395,8 @@ void SetMOX(bool Mox)
 //
 void SetTXEnable(bool Enabled)
 {
-    uint32_t Register;
-
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    if (Enabled)
-        Register |= (1 << VTXENABLEBIT);
-    else
-        Register &= ~(1 << VTXENABLEBIT);
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowSetField(&FieldTXEnable, Enabled);
+    ShadowSync();
 }
 
 
@@ -470,14 +409,8 @@ void SetTXEnable(bool Enabled)
 //
 void SetTXWatchdogOverride(bool Enabled)
 {
-    uint32_t Register;
-    Register = TXConfigRegValue;                    // get current register value
-    if (Enabled)
-        Register |= (1 << VTXCONFIGWATCHDOGOVERRIDE);
-    else
-        Register &= ~(1 << VTXCONFIGWATCHDOGOVERRIDE);
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);      // and write to it
+    ShadowSetField(&FieldTXWatchdog, Enabled);
+    ShadowSync();
 }
 
 
@@ -488,17 +421,8 @@ void SetTXWatchdogOverride(bool Enabled)
 //
 void SetATUTune(bool TuneEnabled)
 {
-    uint32_t Register;
-
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    if (TuneEnabled)
-        Register |= (1 << VATUTUNEBIT);
-    else
-        Register &= ~(1 << VATUTUNEBIT);
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowSetField(&FieldATUTune, TuneEnabled);
+    ShadowSync();
 }
 
 
@@ -527,11 +451,7 @@ void SetP1SampleRate(ESampleRate Rate, unsigned int DDCCount)
         RegisterValue |= RateBits;                      // add in rate bits for this DDC
         RateBits = RateBits << 3;                       // get ready for next DDC
     }
-    if (RegisterValue != DDCRateReg)                     // write back if changed
-    {
-        DDCRateReg = RegisterValue;                     // write back
-//        RegisterWrite(VADDRDDCRATES, RegisterValue);        // and write to h/w register
-    }
+    ShadowStore(eShadowDDCRates, RegisterValue);        // not written to h/w register
 }
 
 
@@ -545,7 +465,7 @@ void EnableInterleavedDDCLODebug(bool Enabled)
 {
     if(Enabled)
     {
-        DDCRateReg |= (1<<30);                      // set bit 30 in debug mode
+        ShadowUpdateBits(eShadowDDCRates, (1<<30), (1<<30), false);     // set bit 30 in debug mode
         WriteP2DDCRateRegister();
     }
 }
@@ -555,12 +475,11 @@ void EnableInterleavedDDCLODebug(bool Enabled)
 // SetP2SampleRate(unsigned int DDC, bool Enabled, unsigned int SampleRate, bool InterleaveWithNext)
 // sets the sample rate for a single DDC (used in protocol 2)
 // allowed rates are 48KHz to 1536KHz.
-// This sets the DDCRateReg variable and does NOT write to hardware
+// This sets the DDC rate register shadow and does NOT write to hardware
 // The WriteP2DDCRateRegister() call must be made after setting values for all DDCs
 //
 void SetP2SampleRate(unsigned int DDC, bool Enabled, unsigned int SampleRate, bool InterleaveWithNext)
 {
-    uint32_t RegisterValue;
     uint32_t Mask;
     ESampleRate Rate;
 
@@ -595,12 +514,7 @@ void SetP2SampleRate(unsigned int DDC, bool Enabled, unsigned int SampleRate, bo
         }
     }
 
-    RegisterValue = DDCRateReg;                     // get current register setting
-    RegisterValue &= ~Mask;                         // strip current bits
-    Mask = (uint32_t)Rate;                          // new bits
-    Mask = Mask << (DDC * 3);                       // get new bits to right bit position
-    RegisterValue |= Mask;
-    DDCRateReg = RegisterValue;                     // don't save to hardware
+    ShadowUpdateBits(eShadowDDCRates, Mask, (uint32_t)Rate << (DDC * 3), false);   // don't save to hardware
 }
 
 
@@ -616,9 +530,10 @@ bool WriteP2DDCRateRegister(void)
     uint32_t CurrentValue;                          // current register setting
     bool Result = false;                            // return value
     CurrentValue = RegisterRead(VADDRDDCRATES);
-    if (CurrentValue != DDCRateReg)
+    if (CurrentValue != ShadowRead(eShadowDDCRates))
         Result = true;
-    RegisterWrite(VADDRDDCRATES, DDCRateReg);        // and write to hardware register
+    ShadowForceWrite(eShadowDDCRates);               // and write to hardware register
+    ShadowSync();
     return Result;
 }
 
@@ -653,17 +568,8 @@ void SetClassEPA(bool IsClassE)
 //
 void SetOpenCollectorOutputs(unsigned int bits)
 {
-    uint32_t Register;                              // FPGA register content
-    uint32_t BitMask;                               // bitmask for 7 OC bits
-
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    BitMask = (0b1111111) << VOPENCOLLECTORBITS;
-    Register = Register & ~BitMask;                 // strip old bits, add new
-    Register |= (bits << VOPENCOLLECTORBITS);       // OC bits are in bits (6:0)
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowSetField(&FieldOpenCollector, bits);      // OC bits are in bits (6:0)
+    ShadowSync();
 }
 
 
@@ -684,7 +590,7 @@ void SetADCCount(unsigned int ADCCount)
 //
 void SetADCOptions(EADCSelect ADC, bool PGA, bool Dither, bool Random)
 {
-    uint32_t Register;                              // FPGA register content
+    uint32_t Register = 0;                          // new register bits
     uint32_t RandBit = VADC1RANDBIT;                // bit number for Rand
     uint32_t PGABit = VADC1PGABIT;                  // bit number for Dither
     uint32_t DitherBit = VADC1DITHERBIT;            // bit number for Dither
@@ -695,12 +601,6 @@ void SetADCOptions(EADCSelect ADC, bool PGA, bool Dither, bool Random)
         PGABit += 3;
         DitherBit += 3;
     }
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    Register &= ~(1 << RandBit);                    // strip old bits
-    Register &= ~(1 << PGABit);
-    Register &= ~(1 << DitherBit);
-
     if(PGA)                                         // add new bits where set
         Register |= (1 << PGABit);
     if(Dither)
@@ -708,9 +608,8 @@ void SetADCOptions(EADCSelect ADC, bool PGA, bool Dither, bool Random)
     if(Random)
         Register |= (1 << RandBit);
 
-    GPIORegValue = Register;                    // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);  // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowUpdateBits(eShadowRFGPIO, (1 << RandBit) | (1 << PGABit) | (1 << DitherBit), Register, true);
+    ShadowSync();
 }
 
 #define VTWOEXP32 4294967296.0              // 2^32
@@ -727,7 +626,6 @@ void SetADCOptions(EADCSelect ADC, bool PGA, bool Dither, bool Random)
 void SetDDCFrequency(uint32_t DDC, uint32_t Value, bool IsDeltaPhase)
 {
     uint32_t DeltaPhase;                    // calculated deltaphase value
-    uint32_t RegAddress;
     double fDeltaPhase;
 
     if(DDC >= VNUMDDC)                      // limit the DDC count to actual regs!
@@ -740,12 +638,8 @@ void SetDDCFrequency(uint32_t DDC, uint32_t Value, bool IsDeltaPhase)
     else
         DeltaPhase = (uint32_t)Value;
 
-    if(DDCDeltaPhase[DDC] != DeltaPhase)    // write back if changed
-    {
-        DDCDeltaPhase[DDC] = DeltaPhase;        // store this delta phase
-        RegAddress =DDCRegisters[DDC];          // get DDC reg address, 
-        RegisterWrite(RegAddress, DeltaPhase);  // and write to it
-    }
+    ShadowWrite((EShadowRegister)(eShadowDDC0Freq + DDC), DeltaPhase);    // store this delta phase
+    ShadowSync();                           // and write to it if changed
 }
 
 
@@ -770,11 +664,8 @@ void SetTestDDSFrequency(uint32_t Value, bool IsDeltaPhase)
     else
         DeltaPhase = (uint32_t)Value;
 
-    if(TestSourceDeltaPhase != DeltaPhase)    // write back if changed
-    {
-        TestSourceDeltaPhase = DeltaPhase;        // store this delta phase
-        RegisterWrite(VADDRRXTESTDDSREG, DeltaPhase);  // and write to it
-    }
+    ShadowWrite(eShadowTestDDSFreq, DeltaPhase);   // store this delta phase
+    ShadowSync();                           // and write to it if changed
 }
 
 
@@ -791,7 +682,6 @@ void SetDUCFrequency(unsigned int Value, bool IsDeltaPhase)		// only accepts DUC
     uint32_t DeltaPhase;                    // calculated deltaphase value
     double fDeltaPhase;
     bool NeedsHPF = false;
-    uint32_t Register;
 
     if(!IsDeltaPhase)                       // ieif protocol 1
     {
@@ -801,26 +691,18 @@ void SetDUCFrequency(unsigned int Value, bool IsDeltaPhase)		// only accepts DUC
     else
         DeltaPhase = (uint32_t)Value;
 
-    DUCDeltaPhase = DeltaPhase;             // store this delta phase
-    RegisterWrite(VADDRTXDUCREG, DeltaPhase);  // and write to it
+    ShadowWrite(eShadowDUCFreq, DeltaPhase);    // store this delta phase
 
 //
 // now enable high pass filter if above 49MHz, for V3+ PCBs
 //    
-    if(SaturnPCBVersion >= 3)
+    if(GetCapabilities()->HasTXHighPassFilter)
     {
-    if (DeltaPhase > DELTAPHIHPFCUTIN)
-        NeedsHPF = true;
-    Register = TXConfigRegValue;                                // get current settings
-    Register &= ~(1<<VTXCONFIGHPFENABLE);                       // remove old HPF bit
-    if(NeedsHPF)
-        Register |= (1 << VTXCONFIGHPFENABLE);                  // add new bit if HPF to be enabled
-    TXConfigRegValue = Register;                                // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);                  // and write to it
-
+        if (DeltaPhase > DELTAPHIHPFCUTIN)
+            NeedsHPF = true;
+        ShadowSetField(&FieldTXHPFEnable, NeedsHPF);           // set HPF bit if HPF to be enabled
     }
-
-    
+    ShadowSync();                                               // and write to them
 }
 
 
@@ -895,7 +777,7 @@ void SetAlexRXAnt(unsigned int Bits)
 {
     uint32_t Register;                                  // modified register
 
-    Register = GAlexRXRegister;                         // copy original register
+    Register = ShadowRead(eShadowAlexRX);               // copy original register
     Register &= 0xFFFFB4FF;                             // turn off all affected bits
 
     switch(Bits)
@@ -914,11 +796,7 @@ void SetAlexRXAnt(unsigned int Bits)
             Register |= 00004100;                       // turn on master in & transverter bits
             break;
     }
-    if(Register != GAlexRXRegister)                     // write back if changed
-    {
-        GAlexRXRegister = Register;
-//        RegisterWrite(VADDRALEXSPIREG+VOFFSETALEXRXREG, Register);  // and write to it
-    }
+    ShadowStore(eShadowAlexRX, Register);               // not written to hardware
 }
 
 
@@ -944,7 +822,7 @@ void SetAlexTXAnt(unsigned int Bits)
 {
     uint32_t Register;                                  // modified register
 
-    Register = GAlexTXAntRegister;                         // copy original register
+    Register = ShadowRead(eShadowAlexTXAnt);            // copy original register
     Register &= 0xFCFF;                                 // turn off all affected bits
 
     switch(Bits)
@@ -963,11 +841,7 @@ void SetAlexTXAnt(unsigned int Bits)
             Register |=0x0400;                          // turn on ANT3
             break;
     }
-    if(Register != GAlexTXAntRegister)                     // write back if changed
-    {
-        GAlexTXAntRegister = Register;
-//        RegisterWrite(VADDRALEXSPIREG+VOFFSETALEXTXREG, Register);  // and write to it
-    }
+    ShadowStore(eShadowAlexTXAnt, Register);            // not written to hardware
 }
 
 
@@ -996,7 +870,7 @@ void SetAlexRXFilters(bool IsRX1, unsigned int Bits)
     uint32_t Register;                                          // modified register
     if(GAlexManualFilterSelect)
     {
-        Register = GAlexRXRegister;                             // copy original register
+        Register = ShadowRead(eShadowAlexRX);                   // copy original register
         if(IsRX1)
         {
             Register &= 0xFFFFEF81;                             // turn off all affected bits
@@ -1015,11 +889,7 @@ void SetAlexRXFilters(bool IsRX1, unsigned int Bits)
             Register |= (Bits & 0x80)<<21;                      // bit 7 moved up
         }
 
-        if(Register != GAlexRXRegister)                     // write back if changed
-        {
-            GAlexRXRegister = Register;
-    //        RegisterWrite(VADDRALEXSPIREG+VOFFSETALEXRXREG, Register);  // and write to it
-        }
+        ShadowStore(eShadowAlexRX, Register);                   // not written to hardware
     }
 }
 
@@ -1044,27 +914,17 @@ void SetAlexTXFilters(unsigned int Bits)
     uint32_t Register;                                          // modified register
     if(GAlexManualFilterSelect)
     {
-        Register = GAlexTXFiltRegister;                         // copy original register
+        Register = ShadowRead(eShadowAlexTXFilt);               // copy original register
         Register &= 0x1F0F;                                 // turn off all affected bits
         Register |= (Bits & 0x0F)<<4;                       // bits 3-0, moved up
         Register |= (Bits & 0x1C)<<9;                      // bits 6-4, moved up
+        ShadowStore(eShadowAlexTXFilt, Register);               // not written to hardware
 
-        if(Register != GAlexTXFiltRegister)                     // write back if changed
-        {
-            GAlexTXFiltRegister = Register;
-    //        RegisterWrite(VADDRALEXSPIREG+VOFFSETALEXTXREG, Register);  // and write to it
-        }
-
-        Register = GAlexTXAntRegister;                         // copy original register
+        Register = ShadowRead(eShadowAlexTXAnt);                // copy original register
         Register &= 0x1F0F;                                 // turn off all affected bits
         Register |= (Bits & 0x0F)<<4;                       // bits 3-0, moved up
         Register |= (Bits & 0x1C)<<9;                      // bits 6-4, moved up
-
-        if(Register != GAlexTXAntRegister)                     // write back if changed
-        {
-            GAlexTXAntRegister = Register;
-    //        RegisterWrite(VADDRALEXSPIREG+VOFFSETALEXTXREG, Register);  // and write to it
-        }
+        ShadowStore(eShadowAlexTXAnt, Register);                // not written to hardware
     }
 }
 
@@ -1089,25 +949,13 @@ void EnableAlexManualFilterSelect(bool IsManual)
 //
 void AlexManualRXFilters(unsigned int Bits, int RX)
 {
-    uint32_t Register;                                          // modified register
     if(GAlexManualFilterSelect)
     {
-        Register = GAlexRXRegister;                             // copy original register
         if(RX != 2)
-        {
-            Register &= 0xFFFF0000;                             // turn off all affected bits
-            Register |= Bits;                                   // add back all new bits
-        }
+            ShadowUpdateBits(eShadowAlexRX, 0x0000FFFF, Bits, true);         // RX1 bits
         else
-        {
-            Register &= 0x0000FFFF;                             // turn off all affected bits
-            Register |= (Bits<<16);                             // add back all new bits
-        }
-        if(Register != GAlexRXRegister)                     // write back if changed
-        {
-            GAlexRXRegister = Register;
-            RegisterWrite(VADDRALEXSPIREG+VOFFSETALEXRXREG, Register);  // and write to it
-        }
+            ShadowUpdateBits(eShadowAlexRX, 0xFFFF0000, (Bits<<16), true);  // RX2 bits
+        ShadowSync();                                           // write back if changed
     }
 }
 
@@ -1132,20 +980,13 @@ void DisableAlexTRRelay(bool IsDisabled)
 //
 void AlexManualTXFilters(unsigned int Bits, bool HasTXAntExplicitly)
 {
-    uint32_t Register;                                  // modified register
     if(GAlexManualFilterSelect)
     {
-        Register = Bits;                         // new setting
-        if(HasTXAntExplicitly && (Register != GAlexTXAntRegister))
-        {
-            GAlexTXAntRegister = Register;
-            RegisterWrite(VADDRALEXSPIREG+VOFFSETALEXTXANTREG, Register);  // and write to it
-        }
-        else if(!HasTXAntExplicitly &&(Register != GAlexTXFiltRegister))                     // write back if changed
-        {
-            GAlexTXFiltRegister = Register;
-            RegisterWrite(VADDRALEXSPIREG+VOFFSETALEXTXFILTREG, Register);  // and write to it
-        }
+        if(HasTXAntExplicitly)
+            ShadowWrite(eShadowAlexTXAnt, Bits);
+        else
+            ShadowWrite(eShadowAlexTXFilt, Bits);
+        ShadowSync();                                   // write back if changed
     }
 }
 
@@ -1212,8 +1053,8 @@ void SetTXDriveLevel(unsigned int Level)
     RegisterValue |= (DACDrive << 8);               // set drive level when TX
     RegisterValue |= (AttenDrive << 16);            // set step atten when RX
     RegisterValue |= (AttenDrive << 24);            // set step atten when TX
-    GTXDACCtrl = RegisterValue;
-    RegisterWrite(VADDRDACCTRLREG, RegisterValue);  // and write to it
+    ShadowWrite(eShadowDACCtrl, RegisterValue);
+    ShadowSync();                                   // and write to it if changed
 }
 
 
@@ -1229,7 +1070,7 @@ void SetMicBoost(bool EnableBoost)
     unsigned int Register;
     unsigned int RequiredGain;                              // for CODEC2
 
-    if(InstalledCodec == e23b)
+    if(GetCapabilities()->CodecType == e23b)
     {
         Register = GCodecAnaloguePath;                      // get current setting
 
@@ -1276,7 +1117,7 @@ void SetMicLineInput(bool IsLineIn)
     static unsigned int GCodec2MicPGARouting;                  // codec PGA input selections
 
     CodecLineInput = IsLineIn;                              // store selected setting
-    if(InstalledCodec == e23b)
+    if(GetCapabilities()->CodecType == e23b)
     {
         Register = GCodecAnaloguePath;                      // get current setting
 
@@ -1315,34 +1156,26 @@ void SetMicLineInput(bool IsLineIn)
 //
 void SetOrionMicOptions(bool MicRing, bool EnableBias, bool EnablePTT)
 {
-    uint32_t Register;                              // FPGA register content
-
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    Register &= ~(1 << VMICBIASENABLEBIT);          // strip old bits
-    Register &= ~(1 << VMICPTTSELECTBIT);           // strip old bits
-    Register &= ~(1 << VMICSIGNALSELECTBIT);
-    Register &= ~(1 << VMICBIASSELECTBIT);
+    uint32_t Register = 0;                          // new register bits
+    uint32_t Mask;
 
+    Mask = (1 << VMICBIASENABLEBIT) | (1 << VMICPTTSELECTBIT)
+         | (1 << VMICSIGNALSELECTBIT) | (1 << VMICBIASSELECTBIT);
     if(!MicRing)                                      // add new bits where set
     {
-        Register &= ~(1 << VMICSIGNALSELECTBIT);    // mic on tip
-        Register |= (1 << VMICBIASSELECTBIT);       // and hence mic bias on tip
-        Register &= ~(1 << VMICPTTSELECTBIT);       // PTT on ring
+        Register |= (1 << VMICBIASSELECTBIT);       // mic on tip, and hence mic bias on tip; PTT on ring
     }
     else
     {
         Register |= (1 << VMICSIGNALSELECTBIT);     // mic on ring
-        Register &= ~(1 << VMICBIASSELECTBIT);      // bias on ring
-        Register |= (1 << VMICPTTSELECTBIT);        // PTT on tip
+        Register |= (1 << VMICPTTSELECTBIT);        // PTT on tip; bias on ring
     }
     if(EnableBias)
         Register |= (1 << VMICBIASENABLEBIT);
     GPTTEnabled = !EnablePTT;                       // used when PTT read back - just store opposite state
 
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);      // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowUpdateBits(eShadowRFGPIO, Mask, Register, true);
+    ShadowSync();
 }
 
 
@@ -1353,17 +1186,8 @@ void SetOrionMicOptions(bool MicRing, bool EnableBias, bool EnablePTT)
 //
 void SetBalancedMicInput(bool Balanced)
 {
-    uint32_t Register;                              // FPGA register content
-
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    Register &= ~(1 << VBALANCEDMICSELECT);         // strip old bit
-    if(Balanced)
-        Register |= (1 << VBALANCEDMICSELECT);      // set new bit
-    
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);      // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowSetField(&FieldBalancedMic, Balanced);
+    ShadowSync();
 }
 
 
@@ -1379,7 +1203,7 @@ void SetCodecLineInGain(unsigned int Gain)
     unsigned int Register;
     unsigned int RequiredGain;                              // for TLV320AIC3204 codec
 
-    if(InstalledCodec == e23b)
+    if(GetCapabilities()->CodecType == e23b)
     {
         Register = GCodecLineGain;                          // get current setting
 
@@ -1426,43 +1250,24 @@ void EnablePureSignal(bool Enabled)
 //
 void SetADCAttenuator(EADCSelect ADC, unsigned int Atten, bool RXAtten, bool TXAtten)
 {
-    uint32_t Register;                              // local copy
-    uint32_t TXMask;
-    uint32_t RXMask;
+    uint32_t Register = 0;                          // new bits
+    uint32_t Mask = 0;                              // bits to change
+    uint32_t Shift = 0;                             // bit offset for ADC1
 
-    Register = GRXADCCtrl;                          // get existing settings
-    TXMask = 0b0000001111100000;                    // mask bits for TX, ADC1
-    RXMask = 0b0000000000011111;                    // mask bits for RX, ADC1
-    if(ADC == eADC1)
+    if(ADC != eADC1)
+        Shift = 10;                                 // move to ADC2 bit positions
+    if(RXAtten)
     {
-        if(RXAtten)
-        {
-            Register &= ~RXMask;
-            Register |= (Atten & 0X1F);             // add in new bits for ADC1, RX
-        }
-        if(TXAtten)
-        {
-            Register &= ~TXMask;
-            Register |= (Atten & 0X1F)<<5;          // add in new bits for ADC1, TX
-        }
+        Mask |= 0x1F << Shift;
+        Register |= (Atten & 0X1F) << Shift;        // add in new bits for RX
     }
-    else
+    if(TXAtten)
     {
-        TXMask = TXMask << 10;                      // move to ADC2 bit positions
-        RXMask = RXMask << 10;                      // move to ADC2 bit positions
-        if(RXAtten)
-        {
-            Register &= ~RXMask;
-            Register |= (Atten & 0X1F) << 10;       // add in new bits for ADC2, RX
-        }
-        if(TXAtten)
-        {
-            Register &= ~TXMask;
-            Register |= (Atten & 0X1F)<<15;         // add in new bits for ADC2, TX
-        }
+        Mask |= 0x1F << (Shift + 5);
+        Register |= (Atten & 0X1F) << (Shift + 5);  // add in new bits for TX
     }
-        GRXADCCtrl = Register; 
-        RegisterWrite(VADDRADCCTRLREG, Register);      // and write to it
+    ShadowUpdateBits(eShadowADCCtrl, Mask, Register, true);
+    ShadowSync();                                   // and write to it if changed
 }
 
 
@@ -1480,9 +1285,7 @@ void SetADCAttenuator(EADCSelect ADC, unsigned int Atten, bool RXAtten, bool TXA
 void SetCWIambicKeyer(uint8_t Speed, uint8_t Weight, bool ReverseKeys, bool Mode, 
                       bool StrictSpacing, bool IambicEnabled, bool Breakin)
 {
-    uint32_t Register;
-    Register =GIambicConfigReg;                     // copy of H/W register
-    Register &= ~VIAMBICBITS;                       // strip off old iambic bits
+    uint32_t Register = 0;
 
     GCWKeyerSpeed = Speed;                          // just save it for now
     GCWKeyerWeight = Weight;                        // just save it for now
@@ -1504,11 +1307,8 @@ void SetCWIambicKeyer(uint8_t Speed, uint8_t Weight, bool ReverseKeys, bool Mode
     if(Breakin)
         Register |= (1<<VCWBREAKIN);             // set bit if enabled
     
-    if (Register != GIambicConfigReg)               // save if changed
-    {
-        GIambicConfigReg = Register;
-        RegisterWrite(VADDRIAMBICCONFIG, Register);
-    }
+    ShadowUpdateBits(eShadowIambicConfig, VIAMBICBITS | (1<<VCWBREAKIN), Register, true);
+    ShadowSync();                                   // save if changed
 }
 
 
@@ -1518,9 +1318,7 @@ void SetCWIambicKeyer(uint8_t Speed, uint8_t Weight, bool ReverseKeys, bool Mode
 //
 void SetCWXBits(bool CWXEnabled, bool CWXDash, bool CWXDot)
 {
-    uint32_t Register;
-    Register =GIambicConfigReg;                     // copy of H/W register
-    Register &= ~VIAMBICCWXBITS;                    // strip off old CWX bits
+    uint32_t Register = 0;
     GCWXMode =CWXEnabled;                           // computer generated CWX mode
     GCWXDot = CWXDot;                               // computer generated CW Dot.
     GCWXDash = CWXDash;                             // computer generated CW Dash.
@@ -1531,11 +1329,8 @@ void SetCWXBits(bool CWXEnabled, bool CWXDash, bool CWXDot)
     if(GCWXDash)
         Register |= (1<<VIAMBICCWXDASH);            // set bit if enabled
     
-    if (Register != GIambicConfigReg)               // save if changed
-    {
-        GIambicConfigReg = Register;
-        RegisterWrite(VADDRIAMBICCONFIG, Register);
-    }
+    ShadowUpdateBits(eShadowIambicConfig, VIAMBICCWXBITS, Register, true);
+    ShadowSync();                                   // save if changed
 }
 
 
@@ -1548,7 +1343,6 @@ void SetCWXBits(bool CWXEnabled, bool CWXDash, bool CWXDot)
 //
 void SetDDCADC(int DDC, EADCSelect ADC)
 {
-    uint32_t RegisterValue;
     uint32_t ADCSetting;
     uint32_t Mask;
 
@@ -1558,14 +1352,8 @@ void SetDDCADC(int DDC, EADCSelect ADC)
     ADCSetting = ((uint32_t)ADC & 0x3) << (DDC*2);  // 2 bits with ADC setting
     Mask = 0x3 << (DDC*2);                         // 0,2,4,6,8,10,12,14,16,18bit positions
 
-    sem_wait(&DDCInSelMutex);                       // get protected access
-    RegisterValue = DDCInSelReg;                    // get current register setting
-    RegisterValue &= ~Mask;                         // strip ADC bits
-    RegisterValue |= ADCSetting;
-
-    DDCInSelReg = RegisterValue;                    // write back
-    RegisterWrite(VADDRDDCINSEL, RegisterValue);    // and write to it
-    sem_post(&DDCInSelMutex);
+    ShadowUpdateBits(eShadowDDCInSel, Mask, ADCSetting, true);
+    ShadowSync();                                   // and write to it
 }
 
 
@@ -1576,21 +1364,8 @@ void SetDDCADC(int DDC, EADCSelect ADC)
 //
 void SetRXDDCEnabled(bool IsEnabled)
 {
-    uint32_t Address;									// register address
-    uint32_t Data;										// register content
-
-    Address = VADDRDDCINSEL;							// DDC config register address
-
-    sem_wait(&DDCInSelMutex);                           // get protected access
-    Data = DDCInSelReg;                                 // get current register setting
-    if (IsEnabled)
-        Data |= (1 << 30);								// set new bit
-    else
-        Data &= ~(1 << 30);								// clear new bit
-
-    DDCInSelReg = Data;          // write back
-    RegisterWrite(Address, Data);					// write back
-    sem_post(&DDCInSelMutex);
+    ShadowSetField(&FieldDDCEnable, IsEnabled);
+    ShadowSync();
 }
 
 
@@ -1627,14 +1402,12 @@ void InitialiseCWKeyerRamp(bool Protocol2, uint32_t Length_us)
     uint32_t RampLength;                    // integer length in WORDS not bytes!
     uint32_t Cntr;
     uint32_t Sample;                        // ramp sample value
-    uint32_t Register;
-	ESoftwareID ID;
-	unsigned int FPGAVersion = 0;
+    bool WordAddressed;                     // true if FPGA uses word address for ramp length
     unsigned int MaxDuration;               // max ramp duration in microseconds
     double x, x2, x4, x6, x8, x10, rampsample;
 
-    FPGAVersion = GetFirmwareVersion(&ID);
-    if(FPGAVersion >= 14)
+    WordAddressed = GetCapabilities()->HasWordAddressedKeyerRAM;
+    if(WordAddressed)
         MaxDuration = VMAXCWRAMPDURATIONV14PLUS;        // get version dependent max length
     else
         MaxDuration = VMAXCWRAMPDURATION;
@@ -1680,15 +1453,11 @@ void InitialiseCWKeyerRamp(bool Protocol2, uint32_t Length_us)
     //
     // finally write the ramp length
     // in FPGA V14 onwards this is a word address
-        Register = GCWKeyerSetup;                    // get current settings
-        Register &= 0x8003FFFF;                      // strip out ramp bits
-        if(FPGAVersion >= 14)
-            Register |= (RampLength << VCWKEYERRAMP);        // word end address
+        if(WordAddressed)
+            ShadowSetField(&FieldKeyerRamp, RampLength);            // word end address
         else
-            Register |= ((RampLength << 2) << VCWKEYERRAMP);        // byte end address
-
-        GCWKeyerSetup = Register;                    // store it back
-        RegisterWrite(VADDRKEYERCONFIGREG, Register);  // and write to it
+            ShadowSetField(&FieldKeyerRamp, RampLength << 2);       // byte end address
+        ShadowSync();                                // and write to it
     }
 }
 
@@ -1726,16 +1495,14 @@ void EnableCW (bool Enabled, bool Breakin)
 //
 void SetCWSidetoneEnabled(bool Enabled)
 {
-    uint32_t Register;
     if(GSidetoneEnabled != Enabled)                     // only act if bit changed
     {
         GSidetoneEnabled = Enabled;
-        Register = GCodecConfigReg;                     // get current settings
-        Register &= 0x0000FFFF;                         // remove old volume bits
         if(Enabled)
-            Register |= (GSidetoneVolume & 0xFF) << 24; // add back new bits; resize to 16 bits
-        GCodecConfigReg = Register;                     // store it back
-        RegisterWrite(VADDRCODECCONFIGREG, Register);   // and write to it
+            ShadowSetField(&FieldSidetoneVolume, GSidetoneVolume & 0xFF);
+        else
+            ShadowSetField(&FieldSidetoneVolume, 0);    // disabled: volume zero
+        ShadowSync();
     }
 }
 
@@ -1747,17 +1514,14 @@ void SetCWSidetoneEnabled(bool Enabled)
 //
 void SetCWSidetoneVol(uint8_t Volume)
 {
-    uint32_t Register;
-
     if(GSidetoneVolume != Volume)                       // only act if value changed
     {
         GSidetoneVolume = Volume;                       // set new value
-        Register = GCodecConfigReg;                     // get current settings
-        Register &= 0x0000FFFF;                         // remove old volume bits
         if(GSidetoneEnabled)
-            Register |= (GSidetoneVolume & 0xFF) << 24; // add back new bits; resize to 16 bits
-        GCodecConfigReg = Register;                     // store it back
-        RegisterWrite(VADDRCODECCONFIGREG, Register);   // and write to it
+        {
+            ShadowSetField(&FieldSidetoneVolume, GSidetoneVolume & 0xFF);
+            ShadowSync();
+        }
     }
 }
 
@@ -1768,16 +1532,8 @@ void SetCWSidetoneVol(uint8_t Volume)
 //
 void SetCWPTTDelay(unsigned int Delay)
 {
-    uint32_t Register;
-
-    Register = GCWKeyerSetup;                           // get current settings
-    Register &= 0xFFFFFF00;                             // remove old bits
-    Register |= (Delay &0xFF);                          // add back new bits
-    if(Register != GCWKeyerSetup)                       // write back if different
-    {
-        GCWKeyerSetup = Register;                       // store it back
-        RegisterWrite(VADDRKEYERCONFIGREG, Register);   // and write to it
-    }
+    ShadowSetField(&FieldKeyerDelay, Delay & 0xFF);
+    ShadowSync();                                       // write back if different
 }
 
 
@@ -1788,16 +1544,8 @@ void SetCWPTTDelay(unsigned int Delay)
 //
 void SetCWHangTime(unsigned int HangTime)
 {
-    uint32_t Register;
-
-    Register = GCWKeyerSetup;                           // get current settings
-    Register &= 0xFFFC00FF;                             // remove old bits
-    Register |= (HangTime &0x3FF) << VCWKEYERHANG;      // add back new bits
-    if(Register != GCWKeyerSetup)                       // write back if different
-    {
-        GCWKeyerSetup = Register;                       // store it back
-        RegisterWrite(VADDRKEYERCONFIGREG, Register);   // and write to it
-    }
+    ShadowSetField(&FieldKeyerHang, HangTime & 0x3FF);
+    ShadowSync();                                       // write back if different
 }
 
 #define VCODECSAMPLERATE 48000                      // I2S rate
@@ -1809,22 +1557,14 @@ void SetCWHangTime(unsigned int HangTime)
 //
 void SetCWSidetoneFrequency(unsigned int Frequency)
 {
-    uint32_t Register;
     uint32_t DeltaPhase;                                // DDS delta phase value
     double fDeltaPhase;                                 // delta phase as a float
 
     fDeltaPhase = 65536.0 * (double)Frequency / (double) VCODECSAMPLERATE;
     DeltaPhase = ((uint32_t)fDeltaPhase) & 0xFFFF;
 
-    Register = GCodecConfigReg;                         // get current settings
-    Register &= 0xFFFF0000;                             // remove old bits
-    Register |= DeltaPhase;                             // add back new bits
-
-    if(Register != GCodecConfigReg)                     // write back if different
-    {
-        GCodecConfigReg = Register;                     // store it back
-        RegisterWrite(VADDRCODECCONFIGREG, Register);   // and write to it
-    }
+    ShadowSetField(&FieldSidetoneFreq, DeltaPhase);
+    ShadowSync();                                       // write back if different
 }
 
 
@@ -1854,29 +1594,13 @@ void SetMaxPWMWidth(unsigned int Width)
 //
 void SetXvtrEnable(bool Enabled)
 {
-    uint32_t Register;
+    uint32_t Bit = (1<<VXVTRENABLEBIT);
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    if(Enabled)
-        Register |= (1<<VXVTRENABLEBIT);
-    else
-    Register &= ~(1<<VXVTRENABLEBIT);
-    GPIORegValue = Register;                    // store it back
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowUpdateBits(eShadowRFGPIO, Bit, Enabled ? Bit : 0, false);     // written with next GPIO change
 }
 
 
 
-unsigned int GWidebandSampleCount;                  // P2 - not used yet
-unsigned int GWidebandUpdateRate;                   // update rate in ms. P2 - not used yet. 
-unsigned int GWidebandControl;                      // P2 - wideband control register
-#define VADDRWIDEBANDCONTROLREG 0xD000
-#define VADDRWIDEBANDPERIODREG 0xD004
-#define VADDRWIDEBANDDEPTHREG 0xD008
-#define VADDRWIDEBANDSTATUSREG 0xD00C
-
-
 //
 // SetWidebandEnable(bool ADC0, bool ADC1, bool DataCollected)
 // enables wideband sample collection from an ADC.
@@ -1902,13 +1626,8 @@ void SetWidebandEnable(bool ADC0, bool ADC1, bool DataCollected)
 //
 void SetWidebandSampleCount(unsigned int Samples)
 {
-    uint32_t Register;
-    Register = Samples - 1;
-    if(Register != GWidebandSampleCount)                     // write back if different
-    {
-        GWidebandSampleCount = Register;                     // store it back
-        RegisterWrite(VADDRWIDEBANDDEPTHREG, Register);   // and write to it
-    }
+    ShadowWrite(eShadowWidebandDepth, Samples - 1);
+    ShadowSync();                                       // write back if different
 }
 
 
@@ -1919,13 +1638,8 @@ void SetWidebandSampleCount(unsigned int Samples)
 //
 void SetWidebandUpdateRate(unsigned int Period_ms)
 {
-    uint32_t Register;
-    Register = Period_ms * 122880;                          // convert to ticks
-    if(Register != GWidebandUpdateRate)                     // write back if different
-    {
-        GWidebandUpdateRate = Register;                     // store it back
-        RegisterWrite(VADDRWIDEBANDPERIODREG, Register);    // and write to it
-    }
+    ShadowWrite(eShadowWidebandPeriod, Period_ms * 122880);     // convert to ticks
+    ShadowSync();                                       // write back if different
 }
 
 
@@ -1956,7 +1670,7 @@ uint32_t GetWidebandStatus(bool *ADC0Data, bool *ADC1Data)
 //
 void EnableTimeStamp(bool Enabled)
 {
-    GEnableTimeStamping = Enabled;                          // P2. true if enabled. NOT SUPPORTED YET
+    GEnableTimeStamping = Enabled;                          // P2. true if enabled. applied at next DDC start
 }
 
 
@@ -1986,18 +1700,9 @@ void SetAlexEnabled(unsigned int Alex)
 //
 void SetPAEnabled(bool Enabled)
 {
-    uint32_t Register;
-
     GPAEnabled = Enabled;                           // just save for now
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    if(!Enabled)
-        Register |= (1<<VTXRELAYDISABLEBIT);
-    else
-        Register &= ~(1<<VTXRELAYDISABLEBIT);
-    GPIORegValue = Register;                    // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);  // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowSetField(&FieldTXRelayDisable, !Enabled);
+    ShadowSync();
 }
 
 
@@ -2050,19 +1755,9 @@ void SetDUCPhaseShift(unsigned int Value)
 //
 void SetSpkrMute(bool IsMuted)
 {
-    uint32_t Register;
-
     GSpeakerMuted = IsMuted;                        // just save for now.
-
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    if(IsMuted)
-        Register |= (1<<VSPKRMUTEBIT);
-    else
-        Register &= ~(1<<VSPKRMUTEBIT);
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    ShadowSetField(&FieldSpkrMute, IsMuted);
+    ShadowSync();
 }
 
 
@@ -2195,20 +1890,23 @@ unsigned int GetP2PTTKeyInputs(void)
 unsigned int GetADCOverflow(uint16_t* ADC1Max, uint16_t* ADC2Max)
 {
     unsigned int Result = 0;
+    struct RegisterOp Ops[3] =
+    {
+        {.Address = VADDRADCOVERFLOWBASE},
+        {.Address = VADDRADCOVERFLOWBASE+4},
+        {.Address = VADDRADCOVERFLOWBASE+8}
+    };
 
-  	ESoftwareID ID;
-	unsigned int Version = 0;
-    Version = GetFirmwareVersion(&ID);
-
-
-    Result = RegisterRead(VADDRADCOVERFLOWBASE);
-    if(Version >= 27)                       // for FPGAs with code, read the ADC1 & 2 max amplitude
+    if(GetCapabilities()->HasADCPeakRegisters)      // for FPGAs with code, read the ADC1 & 2 max amplitude
     {
-        *ADC1Max = RegisterRead(VADDRADCOVERFLOWBASE+4);
-        *ADC2Max = RegisterRead(VADDRADCOVERFLOWBASE+8);
+        RegisterBatch(Ops, 3);                      // read overflow bits and both peaks together
+        Result = Ops[0].Value;
+        *ADC1Max = Ops[1].Value;
+        *ADC2Max = Ops[2].Value;
     }
     else
     {
+        Result = RegisterRead(VADDRADCOVERFLOWBASE);
         *ADC1Max = 0;
         *ADC2Max = 0;
     }
@@ -2247,6 +1945,27 @@ unsigned int GetAnalogueIn(unsigned int AnalogueSelect)
 }
 
 
+//
+// void GetAnalogueInputs(unsigned int* Values)
+// return all 6 ADC values from the RF board analogue values, read together
+// Values[0]=AIN1 .... Values[5]=AIN6
+//
+void GetAnalogueInputs(unsigned int* Values)
+{
+    struct RegisterOp Ops[VNUMANALOGUEIN];
+    unsigned int Input;
+
+    for (Input = 0; Input < VNUMANALOGUEIN; Input++)
+    {
+        Ops[Input].Address = VADDRALEXADCBASE + 4*Input;
+        Ops[Input].Write = 0;
+    }
+    RegisterBatch(Ops, VNUMANALOGUEIN);
+    for (Input = 0; Input < VNUMANALOGUEIN; Input++)
+        Values[Input] = Ops[Input].Value;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////
 // internal App register settings
 // these are things not accessible from external SDR applications, including debug
@@ -2475,19 +2194,14 @@ void InitialiseTLV320AIC3204(void)
 
 
 //
-// CodecInitialise(uint16_t PCBVersion)
+// CodecInitialise(void)
 // initialise the CODEC, with the register values that don't normally change
 // these are the values used by existing HPSDR FPGA firmware
+// the codec type is found from the PCB version
 //
-void CodecInitialise(uint16_t PCBVersion)
+void CodecInitialise(void)
 {
-    SaturnPCBVersion = PCBVersion;
-    if (PCBVersion >= 3)
-        InstalledCodec = e3204;
-    else
-        InstalledCodec = e23b;
-
-    if(InstalledCodec == e23b)                          // earlier CODEC used on ann HPSDR boards
+    if(GetCapabilities()->CodecType == e23b)                          // earlier CODEC used on ann HPSDR boards
     {
         printf("Initialising TLV320AIC23B codec\n");
         GCodecLineGain = 0;                                 // Codec left line in gain register
@@ -2525,14 +2239,9 @@ void CodecInitialise(uint16_t PCBVersion)
 // 
 void SetTXAmplitudeScaling (unsigned int Amplitude)
 {
-    uint32_t Register;
-
     GTXAmplScaleFactor = Amplitude;                             // save value
-    Register = TXConfigRegValue;                                // get current settings
-    Register &= 0xFFC0000F;                                     // remove old bits
-    Register |= ((Amplitude & 0x3FFFF) << VTXCONFIGSCALEBIT);   // add new bits
-    TXConfigRegValue = Register;                                // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);                  // and write to it
+    ShadowSetField(&FieldTXScale, Amplitude & 0x3FFFF);
+    ShadowSync();
 }
 
 
@@ -2543,14 +2252,9 @@ void SetTXAmplitudeScaling (unsigned int Amplitude)
 // true for P2
 void SetTXProtocol (bool Protocol)
 {
-    uint32_t Register;
-
     GTXProtocolP2 = Protocol;                           // save value
-    Register = TXConfigRegValue;                        // get current settings
-    Register &= 0xFFFFFF7;                              // remove old bit
-    Register |= ((((unsigned int)Protocol)&1) << VTXCONFIGPROTOCOLBIT);            // add new bit
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);  // and write to it
+    ShadowSetField(&FieldTXProtocol, Protocol);
+    ShadowSync();
 }
 
 
@@ -2564,8 +2268,9 @@ void ResetDUCMux(void)
     uint32_t Register;
     uint32_t BitMask;
 
-    BitMask = (1 << 29);
-    Register = TXConfigRegValue;                        // get current settings
+    BitMask = (1 << VTXCONFIGMUXRESETBIT);
+    ShadowFlush();                                      // pending TX config changes first
+    Register = ShadowRead(eShadowTXConfig);             // get current settings
     Register |= BitMask;                                // set reset bit
     RegisterWrite(VADDRTXCONFIGREG, Register);          // and write to it
     Register &= ~BitMask;                               // remove old bit
@@ -2581,18 +2286,9 @@ void ResetDUCMux(void)
 //
 void SetTXOutputGate(bool AlwaysOn)
 {
-    uint32_t Register;
-    uint32_t BitMask;
-
     GTXAlwaysEnabled = AlwaysOn;
-    BitMask = (1 << 2);
-    Register = TXConfigRegValue;                        // get current settings
-    if (AlwaysOn)
-        Register |= BitMask;                            // set bit if true
-        else
-        Register &= ~BitMask;                           // clear bit if false
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);  // and write to it
+    ShadowSetField(&FieldTXSampleGate, AlwaysOn);      // set bit if true
+    ShadowSync();
 }
 
 
@@ -2606,18 +2302,9 @@ void SetTXOutputGate(bool AlwaysOn)
 //
 void SetTXIQDeinterleaved(bool Interleaved)
 {
-    uint32_t Register;
-    uint32_t BitMask;
-
     GTXIQInterleaved = Interleaved;
-    BitMask = (1 << 30);
-    Register = TXConfigRegValue;                        // get current settings
-    if (Interleaved)
-        Register |= BitMask;                            // set bit if true
-    else
-        Register &= ~BitMask;                           // clear bit if false
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);    // and write to it
+    ShadowSetField(&FieldTXIQDeinterleave, Interleaved);   // set bit if true
+    ShadowSync();
 }
 
 
@@ -2628,18 +2315,9 @@ void SetTXIQDeinterleaved(bool Interleaved)
 //
 void EnableDUCMux(bool Enabled)
 {
-    uint32_t Register;
-    uint32_t BitMask;
-
     GTXDUCMuxActive = Enabled;
-    BitMask = (1 << 31);
-    Register = TXConfigRegValue;                        // get current settings
-    if (Enabled)
-        Register |= BitMask;                            // set bit if true
-    else
-        Register &= ~BitMask;                           // clear bit if false
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);    // and write to it
+    ShadowSetField(&FieldTXDUCMuxEnable, Enabled);     // set bit if true
+    ShadowSync();
 }
 
 
@@ -2651,14 +2329,8 @@ void EnableDUCMux(bool Enabled)
 // 
 void SetTXModulationTestSourceFrequency (unsigned int Freq)
 {
-    uint32_t Register;
-
-    Register = Freq;                        // get current settings
-    if(Register != TXModulationTestReg)                    // write back if different
-    {
-        TXModulationTestReg = Register;                    // store it back
-        RegisterWrite(VADDRTXMODTESTREG, Register);  // and write to it
-    }
+    ShadowWrite(eShadowTXModTestFreq, Freq);
+    ShadowSync();                                       // write back if different
 }
 
 
@@ -2669,14 +2341,9 @@ void SetTXModulationTestSourceFrequency (unsigned int Freq)
 //
 void SetTXModulationSource(ETXModulationSource Source)
 {
-    uint32_t Register;
-
     GTXModulationSource = Source;                       // save value
-    Register = TXConfigRegValue;                        // get current settings
-    Register &= 0xFFFFFFFC;                             // remove old bits
-    Register |= ((unsigned int)Source);                 // add new bits
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);  // and write to it
+    ShadowSetField(&FieldTXModSource, (uint32_t)Source);
+    ShadowSync();
 }
 
 
@@ -2730,9 +2397,6 @@ void SetDDCSampleSize(__attribute__((unused)) unsigned int DDC, __attribute__((u
 //
 void UseTestDDSSource(void)
 {
-    sem_wait(&DDCInSelMutex);                           // get protected access
     GADCOverride = true;
-    DDCInSelReg = (DDCInSelReg & 0x40000000) | 0x000AAAAA;      // set all to test
-    sem_post(&DDCInSelMutex);
-
-}
\ No newline at end of file
+    ShadowUpdateBits(eShadowDDCInSel, ~(1 << VDDCINSELENABLEBIT), 0x000AAAAA, false);     // set all to test
+}
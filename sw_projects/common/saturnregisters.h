@@ -80,6 +80,7 @@ typedef enum
 #define VDDCDMADEVICE "/dev/xdma0_c2h_0"
 #define VSPKDMADEVICE "/dev/xdma0_h2c_1"
 #define VDUCDMADEVICE "/dev/xdma0_h2c_0"
+#define VFIFOEVENTDEVICE "/dev/xdma0_events_0"          // user interrupt 0: FIFO monitor
 
 
 //
@@ -116,6 +117,9 @@ typedef enum
 #define VADDRFIFOMONBASE 0x9000
 #define VADDRALEXADCBASE 0xA000
 #define VADDRALEXSPIREG 0x0B000
+#define VOFFSETALEXTXFILTREG 0                  // offset addr in Alex SPI IP core: TX filt, RX ant
+#define VOFFSETALEXRXREG 4                      // offset addr in Alex SPI IP core
+#define VOFFSETALEXTXANTREG 8                   // offset addr in Alex SPI IP core: TX filt, TX ant
 #define VADDRBOARDID1 0xC000
 #define VADDRBOARDID2 0xC004
 #define VADDRCONFIGSPIREG 0x10000
@@ -166,6 +170,7 @@ extern uint32_t DDCConfigRegs[VNUMDDC];
 extern uint32_t DMAFIFODepths[VNUMDMAFIFO];
 
 extern bool GEEREnabled;                                   // P2. true if EER is enabled
+extern bool GEnableTimeStamping;                           // P2. true if PC has enabled RX packet timestamps
 
 
 
@@ -253,7 +258,7 @@ void EnableInterleavedDDCLODebug(bool Enabled);
 // SetP2SampleRate(unsigned int DDC, bool Enabled, unsigned int SampleRate, bool InterleaveWithNext)
 // sets the sample rate for a single DDC (used in protocol 2)
 // allowed rates are 48KHz to 1536KHz.
-// This sets the DDCRateReg variable and does NOT write to hardware
+// This sets the DDC rate register shadow and does NOT write to hardware
 // The WriteP2DDCRateRegister() call must be made after setting values for all DDCs
 //
 void SetP2SampleRate(unsigned int DDC, bool Enabled, unsigned int SampleRate, bool InterleaveWithNext);
@@ -814,6 +819,15 @@ unsigned int GetUserIOBits(void);
 unsigned int GetAnalogueIn(unsigned int AnalogueSelect);
 
 
+//
+// void GetAnalogueInputs(unsigned int* Values)
+// return all 6 ADC values from the RF board analogue values, read together
+// Values[0]=AIN1 .... Values[5]=AIN6
+//
+#define VNUMANALOGUEIN 6
+void GetAnalogueInputs(unsigned int* Values);
+
+
 //////////////////////////////////////////////////////////////////////////////////
 // internal App register settings
 // these are things not accessible from external SDR applications, including debug
@@ -821,11 +835,11 @@ unsigned int GetAnalogueIn(unsigned int AnalogueSelect);
 
 
 //
-// CodecInitialise(uint16_t PCBVersion)
+// CodecInitialise(void)
 // initialise the CODEC, with the register values that don't normally change
-// parameter is the PCB version number, to identify change of CODEC type
+// the CODEC type is identified from the PCB version (see capabilities.h)
 //
-void CodecInitialise(uint16_t PCBVersion);
+void CodecInitialise(void);
 
 
 